@@ -0,0 +1,22 @@
+/* counts the heap allocations of a program: loaded with LD_PRELOAD by countMallocs.sh */
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+
+static atomic_ulong calls, bytes;
+static void* (*real_malloc)(size_t);
+
+void* malloc(size_t n) {
+    if (!real_malloc)
+        real_malloc = (void* (*)(size_t))dlsym(RTLD_NEXT, "malloc");
+    atomic_fetch_add(&calls, 1);
+    atomic_fetch_add(&bytes, n);
+    return real_malloc(n);
+}
+
+__attribute__((destructor)) static void report(void) {
+    fprintf(stderr, "ALLOC calls=%lu bytes=%lu\n", (unsigned long)calls, (unsigned long)bytes);
+}
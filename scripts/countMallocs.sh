@@ -0,0 +1,27 @@
+#!/bin/bash
+#prints the number of malloc calls and the number of bytes they requested for one or several FREEC binaries run on the same config file
+#operator new goes through malloc, so vector copies of the profiles are counted
+#
+#usage: countMallocs.sh config.txt freec [freec2 ...]
+#
+#for example, to compare two revisions:
+#   git worktree add /tmp/before <commit>^ && make -C /tmp/before/src
+#   git worktree add /tmp/after <commit> && make -C /tmp/after/src
+#   scripts/countMallocs.sh config_WGS.txt /tmp/before/src/freec /tmp/after/src/freec
+
+if [ $# -lt 2 ]; then
+	echo "usage: $0 config.txt freec [freec2 ...]"
+	exit 1
+fi
+
+config=$1
+shift
+
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cc -O2 -shared -fPIC -o "$dir/countMallocs.so" "$(dirname "$0")/countMallocs.c" -ldl || exit 1
+
+for freec in "$@"; do
+	echo -n "$freec: "
+	LD_PRELOAD="$dir/countMallocs.so" "$freec" -conf "$config" 2>&1 >/dev/null | grep "^ALLOC"
+done
@@ -20,6 +20,7 @@ http://www.fsf.org/licensing/licenses
 
 
 #include "BAFpileup.h"
+#include "CaptureRegions.h"
 
 using namespace std;
 
@@ -78,39 +79,38 @@ float BAFpileup::calculateFlankLength(std::string const& mateFileName, std::stri
 
        // MateOrientation matesOrientation = getMateOrientation(matesOrientation_str); // will not consider read orientation to increase speed
         char* line_buffer;
-        FILE *stream;
-        char buffer[MAX_BUFFER];
-        bool zgOrbam=0;
 
         int numberOfReadsToCheck=3000000;
         int j = 0;
         int fragmentLength=0;
-        if(mateFileName.substr(mateFileName.size()-3,3).compare("bam")==0 || mateFileName.substr(mateFileName.size()-3,3).compare(".gz")==0) {
-            string command;
-            if (mateFileName.substr(mateFileName.size()-3,3).compare("bam")==0) {
-                if (pathToSambamba != "")     {
-                     command = pathToSambamba + " view -t " + SambambaThreads + " " + mateFileName;
-                }    else    {
-                     command = pathToSamtools_ + " view "+mateFileName;
+        if(mateFileName.substr(mateFileName.size()-3,3).compare("bam")==0) {
+            //BAM records are decoded in-process; "=" in the SAM output means that the mate is on the same reference
+            BamReader bamReader;
+            if (!bamReader.open(mateFileName, true)) {
+                exit(-1);
+            }
+            BamRecord record;
+            while (j<numberOfReadsToCheck && bamReader.next(record)) {
+                if (record.refID >= 0 && record.next_refID == record.refID) {
+                    int frLen=record.tlen;
+                    if(frLen>0 && frLen< 10000) {
+                        fragmentLength+=frLen;
+                        j++;
+                    }
                 }
             }
-            if (mateFileName.substr(mateFileName.size()-3,3).compare(".gz")==0) {
-                          command = "gzip -c -d "+mateFileName;
+        } else {
+            LineReader reader;
+            if (!reader.open(mateFileName, true)) {
+                cerr << "Error: unable to open "+mateFileName+"\n" ;
+                exit(-1);
             }
-            stream =
-            #if defined(_WIN32)
-                _popen(command.c_str(), "r");
-            #else
-                popen(command.c_str(), "r");
-            #endif
-            zgOrbam=1;
-
-            while (((line_buffer = getLine(buffer, MAX_BUFFER, stream, line)) != NULL) && j<numberOfReadsToCheck) {
+            while (j<numberOfReadsToCheck && (line_buffer = reader.nextLine()) != NULL) {
                 if (line_buffer[0] == '@')
                     continue;
 
                 char* strs[32];
-                unsigned int strs_cnt = split((char*)line_buffer, '\t', strs);
+                unsigned int strs_cnt = split(line_buffer, '\t', strs);
 
                 if (strs_cnt > 8 && strs[6][0]=='=') {
                     int frLen=atoi(strs[8]);
@@ -120,67 +120,36 @@ float BAFpileup::calculateFlankLength(std::string const& mateFileName, std::stri
                     }
                 }
             }
-
-        } else {
-            fileMates.open(mateFileName.c_str());
-            while( getline( fileMates, line ) ) {
-                if (line[0] == '@')
-                    continue;
-                vector <string> strs;
-                strs = split(line, '\t');
-                if (strs.size() > 8 && strs[6][0]=='=') {
-                    int frLen=atoi(strs[8].c_str());
-                    if(frLen>0 && frLen< 10000) {
-                        fragmentLength+=frLen;
-                        j++;
-                    }
-                }
-            }
-            fileMates.close();
         }
 
 
         fragmentLength = fragmentLength/j;
         float flanks = fragmentLength/2;
-        if (zgOrbam) {
-            #if defined(_WIN32)
-				_pclose(stream);
-            #else
-                    pclose(stream);
-            #endif
-
-        }
-
         cout << "..will increase flanking regions by "<< flanks << " bp"<<endl;
         return flanks;
 }
 
 void BAFpileup::calculateNewBoundaries(std::string targetBed, int flanks, std::string bedFileWithRegionsOfInterest)
 {
-        std::string const& captureFile = targetBed ;
-        ifstream file (captureFile.c_str());
-
+        CaptureRegions const& capture = CaptureRegions::getInstance(targetBed);
+
         ofstream myfile;
         myfile.open(bedFileWithRegionsOfInterest.c_str());
-
 
-        if (file.is_open())  {
-            std::string line;
-            exons_Count = 0;
-            exons_Counttmp = 0;
-            while (std::getline(file,line)) {
-                vector <string> strs = split(line, '\t');                // Print new capture regions
-                myfile << strs[0] << "\t" << atoi(strs[1].c_str())-flanks <<
-                 "\t" << atoi(strs[2].c_str())+flanks<< "\t" << strs[0]<<":"
-                 <<atoi(strs[1].c_str())-flanks << "-" << atoi(strs[2].c_str())+flanks<< "\t"<<
-                 atoi(strs[2].c_str())- atoi(strs[1].c_str())+2*flanks<< "\t" << "+" << "\n";
-            }
-            myfile.close();
-        } else       {
-                cerr << "Error: Unable to open file "+captureFile+"\n";
-                myfile.close();
-                exit(-1);
+        exons_Count = 0;
+        exons_Counttmp = 0;
+        for (size_t c = 0; c < capture.getChromosomes().size(); c++) {
+            const ChrCaptureRegions* targets = capture.getRegions(capture.getChromosomes()[c]);
+            string const& chr = targets->bedName;
+            for (size_t r = 0; r < targets->starts.size(); r++) {
+                // Print new capture regions
+                myfile << chr << "\t" << targets->starts[r]-flanks <<
+                 "\t" << targets->ends[r]+flanks<< "\t" << chr<<":"
+                 <<targets->starts[r]-flanks << "-" << targets->ends[r]+flanks<< "\t"<<
+                 targets->ends[r]- targets->starts[r]+2*flanks<< "\t" << "+" << "\n";
+            }
         }
+        myfile.close();
 }
 
 void BAFpileup::createBedFileWithChromosomeLengths(std::string bedFileWithRegionsOfInterest, std::string chrLenFileName, bool doesNeedChrPrefix) {
@@ -320,6 +289,256 @@ std::string BAFpileup::createPileUpFile(std::string outputDir, std::string samto
     return minipileup;
 }
 
+void BAFpileup::setRegionsOfInterest(std::string targetBed, int flanks)
+{
+    //same regions as in calculateNewBoundaries(), kept in memory instead of a .bed file for bedtools
+    CaptureRegions const& capture = CaptureRegions::getInstance(targetBed);
+    regionsOfInterest_.clear();
+    for (size_t c = 0; c < capture.getChromosomes().size(); c++) {
+        string const& chr = capture.getChromosomes()[c];
+        const ChrCaptureRegions* targets = capture.getRegions(chr);
+        vector<pair<int,int> >& regions = regionsOfInterest_[chr];
+        for (size_t r = 0; r < targets->starts.size(); r++) {
+            regions.push_back(make_pair(targets->starts[r]-flanks, targets->ends[r]+flanks));
+        }
+    }
+    map<string, vector<pair<int,int> > >::iterator it;
+    for (it = regionsOfInterest_.begin(); it != regionsOfInterest_.end(); it++) {
+        vector<pair<int,int> >& regions = it->second;
+        sort(regions.begin(), regions.end());
+        unsigned int merged = 0;
+        for (unsigned int i = 1; i < regions.size(); i++) {
+            if (regions[i].first <= regions[merged].second) {
+                regions[merged].second = max(regions[merged].second, regions[i].second);
+            } else {
+                regions[++merged] = regions[i];
+            }
+        }
+        regions.resize(merged+1);
+    }
+}
+
+const std::vector<std::pair<int,int> >* BAFpileup::getRegionsOfInterest(std::string const& chr) const
+{
+    map<string, vector<pair<int,int> > >::const_iterator it = regionsOfInterest_.find(chr);
+    if (it == regionsOfInterest_.end())
+        return NULL;
+    return &it->second;
+}
+
+static inline unsigned int unpackUInt32(const unsigned char* buffer)
+{
+    return buffer[0] | (buffer[1] << 8) | (buffer[2] << 16) | ((unsigned int)buffer[3] << 24);
+}
+
+SNPAlleleCounter::SNPAlleleCounter(BAFpileup const& bafpileup, SNPinGenome& snpingenome, std::string const& mateFile, std::vector<std::string> const& refNames, int minimalTotalLetterCountPerPosition, int minimalQualityPerPosition) :
+    bafpileup_(bafpileup), snpingenome_(snpingenome), mateFile_(mateFile), refNames_(refNames),
+    minimalTotalLetterCountPerPosition_(minimalTotalLetterCountPerPosition), minimalQualityPerPosition_(minimalQualityPerPosition),
+    isAssigned_(snpingenome.getSNPChr()->size(), false), currentRef_(NA), index_(NA), numberOfSNPs_(0), firstSNP_(0), previousPos_(0), genotyped_(0)
+{
+    for (unsigned int i = 0; i < refNames.size(); i++) {
+        refIndex_.push_back(snpingenome.findIndex(refNames[i]));
+    }
+}
+
+void SNPAlleleCounter::clearValues(SNPinGenome& snpingenome)
+{
+    //positions without reads stay NA, as positions missing in a pileup file
+    for (int i = 0; i < (int)snpingenome.getSNPChr()->size(); i++) {
+        SNPatChr& snps = snpingenome.SNP_atChr(i);
+        for (int j = 0; j < snps.getSize(); j++) {
+            snps.setValueAt(j,NA);
+            snps.setStatusAt(j,NA);
+        }
+    }
+}
+
+void SNPAlleleCounter::assignCounts()
+{
+    if (index_ == NA)
+        return;
+    for (int j = 0; j < numberOfSNPs_; j++) {
+        if (!inRegion_[j])
+            continue;
+        //with a quality threshold, deletions are removed from the pileup before counting (see SNPinGenome::addInfoFromAPileUp())
+        int totalLetterCount = minimalQualityPerPosition_>0 ? counts_[j].bases : counts_[j].depth;
+        snpingenome_.setAlleleCountsAt(index_, j, totalLetterCount, counts_[j].refCount, counts_[j].altCount, counts_[j].hasIndel, minimalTotalLetterCountPerPosition_);
+    }
+    isAssigned_[index_] = true;
+    genotyped_ += numberOfSNPs_;
+    index_ = NA;
+}
+
+void SNPAlleleCounter::startReference(int refID)
+{
+    currentRef_ = refID;
+    index_ = refIndex_[refID];
+    previousPos_ = 0;
+    firstSNP_ = 0;
+    numberOfSNPs_ = 0;
+    if (index_ == NA || isAssigned_[index_]) {
+        index_ = NA;
+        return;
+    }
+    SNPatChr& snps = snpingenome_.SNP_atChr(index_);
+    numberOfSNPs_ = snps.getSize();
+    SNPAlleleCounts zero = {0, 0, 0, 0, false};
+    counts_.assign(numberOfSNPs_, zero);
+    inRegion_.assign(numberOfSNPs_, 1);
+    if (bafpileup_.hasRegionsOfInterest()) {
+        //SNP positions are 1-based: a SNP is inside [start,end) if start < position <= end
+        const vector<pair<int,int> >* regions = bafpileup_.getRegionsOfInterest(refNames_[refID]);
+        unsigned int r = 0;
+        for (int j = 0; j < numberOfSNPs_; j++) {
+            int position = snps.getPositionAt(j);
+            if (regions)
+                while (r < regions->size() && (*regions)[r].second < position)
+                    r++;
+            inRegion_[j] = regions && r < regions->size() && (*regions)[r].first < position;
+        }
+    }
+}
+
+void SNPAlleleCounter::addRead(BamRecord const& record, std::vector<unsigned char> const& data)
+{
+    static const char bamBases[] = "=ACMGRSVTWYHKDBN";
+
+    if (record.refID != currentRef_) {
+        assignCounts();
+        if (record.refID < 0) { //unplaced reads are at the end of a sorted BAM file
+            currentRef_ = record.refID;
+            return;
+        }
+        if (record.refID < currentRef_ || record.refID >= (int)refIndex_.size()) {
+            cerr << "Error: " << mateFile_ << " should be sorted by coordinates to calculate BAF profiles\n";
+            exit(-1);
+        }
+        startReference(record.refID);
+    }
+    if (record.refID < 0)
+        return;
+    if (record.pos < previousPos_) {
+        cerr << "Error: " << mateFile_ << " should be sorted by coordinates to calculate BAF profiles\n";
+        exit(-1);
+    }
+    previousPos_ = record.pos;
+    if (index_ == NA)
+        return;
+    //default filters of "samtools mpileup -q 1": unmapped, secondary, QC failed and duplicated reads, anomalous read pairs and MAPQ 0
+    if (record.flag & (BAM_FUNMAP | BAM_FSECONDARY | BAM_FQCFAIL | BAM_FDUP))
+        return;
+    if ((record.flag & BAM_FPAIRED) && !(record.flag & BAM_FPROPER_PAIR))
+        return;
+    if (record.mapq < 1)
+        return;
+
+    SNPatChr& snps = snpingenome_.SNP_atChr(index_);
+    while (firstSNP_ < numberOfSNPs_ && snps.getPositionAt(firstSNP_) <= record.pos)
+        firstSNP_++;
+    if (firstSNP_ == numberOfSNPs_)
+        return;
+
+    const unsigned char* cigar = &data[0] + record.l_read_name;
+    const unsigned char* seq = cigar + 4*record.n_cigar_op;
+    const unsigned char* qual = seq + (record.l_seq+1)/2;
+    int refPos = record.pos;
+    int queryPos = 0;
+    int j = firstSNP_;
+    for (int k = 0; k < record.n_cigar_op && j < numberOfSNPs_; k++) {
+        unsigned int op = unpackUInt32(cigar + 4*k);
+        int length = op >> 4;
+        op &= 0xf;
+        switch (op) {
+        case BAM_CMATCH:
+        case BAM_CEQUAL:
+        case BAM_CDIFF: {
+            int end = refPos + length;
+            for (; j < numberOfSNPs_ && snps.getPositionAt(j)-1 < end; j++) {
+                if (!inRegion_[j] || counts_[j].depth >= BAF_MAX_DEPTH)
+                    continue;
+                int offset = snps.getPositionAt(j)-1 - refPos;
+                int qpos = queryPos + offset;
+                if (qpos >= record.l_seq || qual[qpos] < minimalQualityPerPosition_)
+                    continue;
+                counts_[j].depth++;
+                char base = bamBases[(seq[qpos/2] >> ((~qpos & 1) << 2)) & 0xf];
+                if (strchr("=ACGTN", base))
+                    counts_[j].bases++;
+                if (base == '=' || base == snps.getReferenceAt(j))
+                    counts_[j].refCount++;
+                else if (base == toupper(snps.getNucleotideAt(j)))
+                    counts_[j].altCount++;
+                //"+" or "-" after the last aligned base before an insertion or a deletion
+                if (offset == length-1 && k+1 < record.n_cigar_op) {
+                    unsigned int nextOp = unpackUInt32(cigar + 4*(k+1)) & 0xf;
+                    if (nextOp == BAM_CINS || nextOp == BAM_CDEL)
+                        counts_[j].hasIndel = true;
+                }
+            }
+            refPos = end;
+            queryPos += length;
+            break;
+        }
+        case BAM_CDEL:
+        case BAM_CREF_SKIP:
+            for (; j < numberOfSNPs_ && snps.getPositionAt(j)-1 < refPos + length; j++) {
+                if (op == BAM_CDEL && inRegion_[j] && counts_[j].depth < BAF_MAX_DEPTH)
+                    counts_[j].depth++;
+            }
+            refPos += length;
+            break;
+        case BAM_CINS:
+        case BAM_CSOFT_CLIP:
+            queryPos += length;
+            break;
+        default: //hard clipping and padding
+            break;
+        }
+    }
+}
+
+void SNPAlleleCounter::finish()
+{
+    assignCounts();
+}
+
+void BAFpileup::countAlleles(SNPinGenome& snpingenome, std::string const& mateFile, int minimalTotalLetterCountPerPosition, int minimalQualityPerPosition) const
+{
+    cout << "..Counting alleles at SNP positions in "<< mateFile << " to calculate BAF profiles" << std::endl;
+#ifdef PROFILE_TRACE
+    time_t t0 = time(NULL);
+#endif
+    BamReader bamReader;
+    if (!bamReader.open(mateFile, true)) {
+        exit(-1);
+    }
+    vector<string> refNames(bamReader.getNumberOfReferences());
+    for (int i = 0; i < bamReader.getNumberOfReferences(); i++) {
+        refNames[i] = bamReader.getReferenceName(i);
+        processChrName(refNames[i]);
+    }
+    SNPAlleleCounter::clearValues(snpingenome);
+    SNPAlleleCounter counter(*this, snpingenome, mateFile, refNames, minimalTotalLetterCountPerPosition, minimalQualityPerPosition);
+
+    long count = 0;
+    BamRecord record;
+    vector<unsigned char> data;
+    while (bamReader.next(record, data)) {
+        count++;
+        counter.addRead(record, data);
+    }
+    if (bamReader.isError()) {
+        cerr << "Error: FREEC was not able to read "<< mateFile << " until the end\n";
+        exit(-1);
+    }
+    counter.finish();
+    snpingenome.setPileupRead(true);
+    cout << "..processed " << count << " reads and " << counter.getNumberOfGenotypedSNPs() << " SNP positions in " << mateFile << "\n";
+#ifdef PROFILE_TRACE
+    std::cout << "PROFILING [tid=" << pthread_self() << "]: " << mateFile << " genotyped in " << (time(NULL)-t0) << " seconds [countAlleles]\n" << std::flush;
+#endif
+}
+
 /*
 std::vector < std::vector<float> >BAFpileup::computeBAF(GenomeCopyNumber & sampleorcontrol, std::string minipileup, std::string outputDir,  std::string filename)
 {
@@ -452,3 +671,10 @@ std::vector < std::vector<float> >BAFpileup::computeBAF(GenomeCopyNumber & sampl
     return BAF;
 }
 */
+
+void* BAFpileup_countAlleles_wrapper(void *arg)
+{
+  BAFpileupCountAllelesArgWrapper* warg = (BAFpileupCountAllelesArgWrapper*)arg;
+  warg->bafpileup.countAlleles(warg->snpingenome, warg->mateFile, warg->minimalTotalLetterCountPerPosition, warg->minimalQualityPerPosition);
+  return NULL;
+}
@@ -4,7 +4,12 @@
 
 #include <string>
 #include <vector>
+#include <map>
 #include "GenomeCopyNumber.h"
+#include "SNPinGenome.h"
+#include "BamReader.h"
+
+#define BAF_MAX_DEPTH 8000 //same as "samtools mpileup -d 8000"
 
 class BAFpileup
 {
@@ -22,6 +27,11 @@ class BAFpileup
         std::string intersectWithBedtools(std::string makeminipileup, std::string outputDir,  std::string bedFileWithRegionsOfInterest, std::string chrLen);
         void createBedFileWithChromosomeLengths (std::string bedFileWithRegionsOfInterest, std::string chrLenFile, bool doesNeedChrPrefix);
         std::string createPileUpFile(std::string  outputDir, std::string samtools_path, std::string pathToSambamba, std::string SambambaThreads, std::string control_tumor, std::string intersected, std::string fastaFile,int minQualPerPos);
+        void setRegionsOfInterest(std::string targetBed, int flanks); //SNPs outside targeted regions +/- flanks will not be genotyped by countAlleles()
+        void countAlleles(SNPinGenome& snpingenome, std::string const& mateFile, int minimalTotalLetterCountPerPosition, int minimalQualityPerPosition) const; //fills BAF values of snpingenome directly from a sorted BAM file, without samtools and bedtools
+        static bool canCountAlleles(std::string const& mateFile) {return BamReader::isBAM(mateFile);}
+        bool hasRegionsOfInterest() const {return !regionsOfInterest_.empty();}
+        const std::vector<std::pair<int,int> >* getRegionsOfInterest(std::string const& chr) const; //NULL if there is no region on this chromosome
         std::vector < std::vector<float> >computeBAF(GenomeCopyNumber & sampleorcontrol, std::string minipileup, std::string outputDir, std::string filename);
         std::vector <int> coordinates_;
         std::vector <int> ends_;
@@ -51,6 +61,65 @@ class BAFpileup
         std::vector <std::string> strand;
         std::vector <std::string> ref_name;
         std::string pathToBedtools_;
+        std::map<std::string, std::vector<std::pair<int,int> > > regionsOfInterest_; //merged [start,end) BED intervals by chromosome name without "chr"
+};
+
+//allele counts at one SNP position, as they would be seen in a "samtools mpileup" line
+struct SNPAlleleCounts {
+    int depth; //reads covering the position, including deletions
+    int bases; //reads with a base of sufficient quality
+    int refCount;
+    int altCount;
+    bool hasIndel;
+};
+
+//genotypes SNP positions of a SNPinGenome from the reads of a BAM file sorted by coordinates;
+//reads can come from BAFpileup::countAlleles() or from any other pass over the file (GenomeCopyNumber::fillMyHash())
+class SNPAlleleCounter
+{
+    public:
+        SNPAlleleCounter(BAFpileup const& bafpileup, SNPinGenome& snpingenome, std::string const& mateFile, std::vector<std::string> const& refNames, int minimalTotalLetterCountPerPosition, int minimalQualityPerPosition); //refNames: BAM reference names without "chr"
+        void addRead(BamRecord const& record, std::vector<unsigned char> const& data); //record and data as returned by BamReader::next(record, data)
+        void finish(); //assigns BAF values for the last reference
+        long getNumberOfGenotypedSNPs() const {return genotyped_;}
+        static void clearValues(SNPinGenome& snpingenome); //sets all BAF values to NA before counting
+
+    private:
+        void startReference(int refID);
+        void assignCounts();
+
+        BAFpileup const& bafpileup_;
+        SNPinGenome& snpingenome_;
+        std::string mateFile_;
+        std::vector<std::string> refNames_;
+        std::vector<int> refIndex_; //SNPinGenome index of each BAM reference
+        int minimalTotalLetterCountPerPosition_;
+        int minimalQualityPerPosition_;
+        std::vector<bool> isAssigned_;
+        std::vector<SNPAlleleCounts> counts_;
+        std::vector<char> inRegion_;
+        int currentRef_;
+        int index_;
+        int numberOfSNPs_;
+        int firstSNP_; //SNPs before this one cannot be covered by the next reads
+        int previousPos_;
+        long genotyped_;
+};
+
+//
+// Multi Thread Support
+//
+
+struct BAFpileupCountAllelesArgWrapper : public ThreadArg {
+  BAFpileup const& bafpileup;
+  SNPinGenome& snpingenome;
+  std::string mateFile;
+  int minimalTotalLetterCountPerPosition;
+  int minimalQualityPerPosition;
+
+  BAFpileupCountAllelesArgWrapper(BAFpileup const& bafpileup, SNPinGenome& snpingenome, std::string const& mateFile, int minimalTotalLetterCountPerPosition, int minimalQualityPerPosition) : bafpileup(bafpileup), snpingenome(snpingenome), mateFile(mateFile), minimalTotalLetterCountPerPosition(minimalTotalLetterCountPerPosition), minimalQualityPerPosition(minimalQualityPerPosition) { }
 };
 
+extern void* BAFpileup_countAlleles_wrapper(void *arg);
+
 #endif // BAFPILEUP_H
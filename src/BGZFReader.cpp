@@ -0,0 +1,424 @@
+/*************************************************************************
+Copyright (c) 2010-2016, Valentina BOEVA.
+
+>>> SOURCE LICENSE >>>
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation (www.fsf.org); either version 2 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+A copy of the GNU General Public License is available at
+http://www.fsf.org/licensing/licenses
+
+>>> END OF LICENSE >>>
+*************************************************************************/
+
+#include "BGZFReader.h"
+#include "ThreadPool.h"
+#include "LineReader.h"
+
+#include <iostream>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+using namespace std;
+
+static inline int unpackInt16(const unsigned char* buffer)
+{
+    return buffer[0] | (buffer[1] << 8);
+}
+
+static const long UNKNOWN_END = 0x7fffffffffffffffL;
+
+BGZFReader::BGZFReader() : file_(NULL), data_(NULL), blockAddress_(0), blockLength_(0), blockOffset_(0), eof_(false), error_(false),
+    nextToRead_(0), nextToConsume_(0), endOfInput_(UNKNOWN_END), holdingBlock_(false), inputError_(false), stop_(false)
+{
+    pthread_mutex_init(&mutex_, NULL);
+    pthread_cond_init(&blockReady_, NULL);
+    pthread_cond_init(&slotFree_, NULL);
+}
+
+BGZFReader::~BGZFReader()
+{
+    close();
+    pthread_cond_destroy(&slotFree_);
+    pthread_cond_destroy(&blockReady_);
+    pthread_mutex_destroy(&mutex_);
+}
+
+bool BGZFReader::open(std::string const& fileName, bool multithreaded)
+{
+    close();
+    file_ = openInput(fileName);
+    if (!file_) {
+        return false;
+    }
+    fileName_ = fileName;
+    data_ = NULL;
+    blockAddress_ = 0;
+    blockLength_ = 0;
+    blockOffset_ = 0;
+    eof_ = false;
+    error_ = false;
+    if (multithreaded) {
+        startThreads();
+    }
+    if (threads_.empty()) {
+        compressed_.resize(BGZF_MAX_BLOCK_SIZE);
+        uncompressed_.resize(BGZF_MAX_BLOCK_SIZE);
+    }
+    return true;
+}
+
+void BGZFReader::close()
+{
+    stopThreads();
+    if (file_) {
+        fclose(file_);
+        file_ = NULL;
+    }
+}
+
+void BGZFReader::startThreads()
+{
+    ThreadPoolManager* thrPoolManager = ThreadPoolManager::getInstance();
+    if (!thrPoolManager) {
+        return;
+    }
+    int threadNumber = 0;
+    while (threadNumber < BGZF_MAX_THREADS && thrPoolManager->reserveOneThread()) {
+        threadNumber++;
+    }
+    if (threadNumber == 0) {
+        return;
+    }
+    blocks_.resize(threadNumber * BGZF_BLOCKS_PER_THREAD);
+    for (size_t i = 0; i < blocks_.size(); i++) {
+        blocks_[i].compressed.resize(BGZF_MAX_BLOCK_SIZE);
+        blocks_[i].uncompressed.resize(BGZF_MAX_BLOCK_SIZE);
+        blocks_[i].length = 0;
+        blocks_[i].ready = false;
+    }
+    nextToRead_ = 0;
+    nextToConsume_ = 0;
+    endOfInput_ = UNKNOWN_END;
+    holdingBlock_ = false;
+    inputError_ = false;
+    stop_ = false;
+    //the workers live as long as the file is open and synchronize with the consumer block by block,
+    //which is why they are plain pthreads and not a ThreadPool (the reservations are taken above)
+    for (int i = 0; i < threadNumber; i++) {
+        pthread_t tid;
+        if (pthread_create(&tid, NULL, BGZFReader::inflateThread, this) != 0) {
+            thrPoolManager->releaseOneThread();
+            continue;
+        }
+        threads_.push_back(tid);
+    }
+    if (threads_.empty()) {
+        blocks_.clear();
+    }
+#ifdef PROFILE_TRACE
+    std::cout << "PROFILING [tid=" << pthread_self() << "]: " << threads_.size() << " threads inflate " << fileName_ << " [BGZFReader::startThreads]\n" << std::flush;
+#endif
+}
+
+void BGZFReader::stopThreads()
+{
+    if (threads_.empty()) {
+        return;
+    }
+    pthread_mutex_lock(&mutex_);
+    stop_ = true;
+    pthread_cond_broadcast(&slotFree_);
+    pthread_mutex_unlock(&mutex_);
+    for (size_t i = 0; i < threads_.size(); i++) {
+        pthread_join(threads_[i], NULL);
+        ThreadPoolManager::getInstance()->releaseOneThread();
+    }
+    threads_.clear();
+    blocks_.clear();
+}
+
+void* BGZFReader::inflateThread(void* arg)
+{
+    ((BGZFReader*)arg)->inflateLoop();
+    return NULL;
+}
+
+void BGZFReader::inflateLoop()
+{
+    long blockNumber = (long)blocks_.size();
+    pthread_mutex_lock(&mutex_);
+    for (;;) {
+        while (!stop_ && endOfInput_ == UNKNOWN_END && nextToRead_ - nextToConsume_ >= blockNumber) {
+            pthread_cond_wait(&slotFree_, &mutex_);
+        }
+        if (stop_ || endOfInput_ != UNKNOWN_END) {
+            break;
+        }
+        //blocks are read from the file one at a time, but inflated concurrently
+        long index = nextToRead_;
+        Block& block = blocks_[index % blockNumber];
+        int compressedLength = readRawBlock(file_, &block.compressed[0]);
+        if (compressedLength <= 0) {
+            inputError_ = compressedLength < 0;
+            endOfInput_ = index;
+            pthread_cond_broadcast(&blockReady_);
+            pthread_cond_broadcast(&slotFree_);
+            break;
+        }
+        nextToRead_++;
+        pthread_mutex_unlock(&mutex_);
+
+        int length = inflateBlock(&block.compressed[0], compressedLength, &block.uncompressed[0]);
+
+        pthread_mutex_lock(&mutex_);
+        block.length = length;
+        block.ready = true;
+        pthread_cond_broadcast(&blockReady_);
+    }
+    pthread_mutex_unlock(&mutex_);
+}
+
+FILE* BGZFReader::openInput(std::string const& fileName)
+{
+    if (fileName.compare("-")==0) {
+        //a duplicate, so that fclose() leaves the standard input itself open
+        int fd = dup(0);
+        return fd < 0 ? NULL : fdopen(fd, "rb");
+    }
+    return fopen(fileName.c_str(), "rb");
+}
+
+bool BGZFReader::isBGZF(std::string const& fileName)
+{
+    //the first bytes of a stream cannot be read twice
+    if (LineReader::isStream(fileName)) {
+        return false;
+    }
+    FILE* file = fopen(fileName.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    unsigned char header[BGZF_BLOCK_HEADER_LENGTH];
+    size_t count = fread(header, 1, BGZF_BLOCK_HEADER_LENGTH, file);
+    fclose(file);
+    return count == BGZF_BLOCK_HEADER_LENGTH && header[0] == 31 && header[1] == 139 && header[2] == 8 && (header[3] & 4)
+        && header[12] == 'B' && header[13] == 'C';
+}
+
+int BGZFReader::readRawBlock(FILE* file, char* compressed)
+{
+    unsigned char* header = (unsigned char*)compressed;
+    size_t count = fread(header, 1, 12, file);
+    if (count == 0) {
+        return 0;
+    }
+    if (count != 12 || header[0] != 31 || header[1] != 139 || header[2] != 8 || !(header[3] & 4)) {
+        return -1;
+    }
+    int xlen = unpackInt16(header + 10);
+    if (12 + xlen > BGZF_MAX_BLOCK_SIZE || fread(header + 12, 1, xlen, file) != (size_t)xlen) {
+        return -1;
+    }
+    //look for the "BC" subfield giving the total block size minus one:
+    int blockLength = 0;
+    for (int i = 12; i + 4 <= 12 + xlen; ) {
+        int subfieldLength = unpackInt16(header + i + 2);
+        if (header[i] == 'B' && header[i+1] == 'C' && subfieldLength == 2) {
+            blockLength = unpackInt16(header + i + 4) + 1;
+            break;
+        }
+        i += 4 + subfieldLength;
+    }
+    if (blockLength < 12 + xlen + 8 || blockLength > BGZF_MAX_BLOCK_SIZE) {
+        return -1;
+    }
+    int remaining = blockLength - 12 - xlen;
+    if (fread(header + 12 + xlen, 1, remaining, file) != (size_t)remaining) {
+        return -1;
+    }
+    return blockLength;
+}
+
+int BGZFReader::inflateBlock(const char* compressed, int blockLength, char* uncompressed)
+{
+    const unsigned char* block = (const unsigned char*)compressed;
+    int headerLength = 12 + unpackInt16(block + 10);
+    const unsigned char* trailer = block + blockLength - 8;
+    unsigned int isize = trailer[4] | (trailer[5] << 8) | (trailer[6] << 16) | ((unsigned int)trailer[7] << 24);
+    if (isize > BGZF_MAX_BLOCK_SIZE) {
+        return -1;
+    }
+    if (isize == 0) {
+        return 0;
+    }
+
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    zs.next_in = (Bytef*)(block + headerLength);
+    zs.avail_in = blockLength - headerLength - 8;
+    zs.next_out = (Bytef*)uncompressed;
+    zs.avail_out = BGZF_MAX_BLOCK_SIZE;
+
+    if (inflateInit2(&zs, -15) != Z_OK) {
+        return -1;
+    }
+    int status = inflate(&zs, Z_FINISH);
+    inflateEnd(&zs);
+    if (status != Z_STREAM_END || zs.total_out != isize) {
+        return -1;
+    }
+    return (int)isize;
+}
+
+bool BGZFReader::seek(uint64_t virtualOffset)
+{
+    if (!threads_.empty()) {
+        cerr << "Error: cannot seek in " << fileName_ << " while it is inflated by several threads\n";
+        return false;
+    }
+    //the upper 48 bits give the offset of the block in the file, the lower 16 bits the offset in the uncompressed block
+    long blockAddress = (long)(virtualOffset >> 16);
+    int withinBlock = (int)(virtualOffset & 0xffff);
+    if (fseek(file_, blockAddress, SEEK_SET) != 0) {
+        cerr << "Error: unable to seek in " << fileName_ << "\n";
+        error_ = true;
+        return false;
+    }
+    eof_ = false;
+    blockAddress_ = blockAddress;
+    blockLength_ = 0;
+    blockOffset_ = 0;
+    if (withinBlock == 0) {
+        return true;
+    }
+    if (!nextBlock() || withinBlock > blockLength_) {
+        cerr << "Error: unable to seek in " << fileName_ << "\n";
+        error_ = true;
+        return false;
+    }
+    blockOffset_ = withinBlock;
+    return true;
+}
+
+bool BGZFReader::nextBlock()
+{
+    if (!threads_.empty()) {
+        return nextInflatedBlock();
+    }
+    //skip empty blocks such as the end-of-file marker
+    for (;;) {
+        blockAddress_ = ftell(file_);
+        int blockLength = readRawBlock(file_, &compressed_[0]);
+        if (blockLength == 0) {
+            eof_ = true;
+            return false;
+        }
+        if (blockLength < 0) {
+            cerr << "Error: " << fileName_ << " is truncated or is not a BGZF (BAM) file\n";
+            error_ = true;
+            return false;
+        }
+        blockLength_ = inflateBlock(&compressed_[0], blockLength, &uncompressed_[0]);
+        blockOffset_ = 0;
+        data_ = &uncompressed_[0];
+        if (blockLength_ < 0) {
+            cerr << "Error: unable to decompress a block of " << fileName_ << "\n";
+            error_ = true;
+            return false;
+        }
+        if (blockLength_ > 0) {
+            return true;
+        }
+    }
+}
+
+bool BGZFReader::nextInflatedBlock()
+{
+    long blockNumber = (long)blocks_.size();
+    pthread_mutex_lock(&mutex_);
+    if (holdingBlock_) {
+        //the previous block has been consumed: its slot can be reused
+        blocks_[nextToConsume_ % blockNumber].ready = false;
+        nextToConsume_++;
+        holdingBlock_ = false;
+        pthread_cond_broadcast(&slotFree_);
+    }
+    for (;;) {
+        Block& block = blocks_[nextToConsume_ % blockNumber];
+        while (!block.ready && nextToConsume_ < endOfInput_) {
+            pthread_cond_wait(&blockReady_, &mutex_);
+        }
+        if (!block.ready) {
+            if (inputError_) {
+                cerr << "Error: " << fileName_ << " is truncated or is not a BGZF (BAM) file\n";
+                error_ = true;
+            } else {
+                eof_ = true;
+            }
+            pthread_mutex_unlock(&mutex_);
+            return false;
+        }
+        if (block.length < 0) {
+            cerr << "Error: unable to decompress a block of " << fileName_ << "\n";
+            error_ = true;
+            pthread_mutex_unlock(&mutex_);
+            return false;
+        }
+        if (block.length == 0) {
+            //skip empty blocks such as the end-of-file marker
+            block.ready = false;
+            nextToConsume_++;
+            pthread_cond_broadcast(&slotFree_);
+            continue;
+        }
+        holdingBlock_ = true;
+        data_ = &block.uncompressed[0];
+        blockLength_ = block.length;
+        blockOffset_ = 0;
+        pthread_mutex_unlock(&mutex_);
+        return true;
+    }
+}
+
+int BGZFReader::read(void* data, int length)
+{
+    char* output = (char*)data;
+    int bytesRead = 0;
+    while (bytesRead < length) {
+        if (blockOffset_ >= blockLength_) {
+            if (!nextBlock()) {
+                return eof_ ? bytesRead : -1;
+            }
+        }
+        int toCopy = min(length - bytesRead, blockLength_ - blockOffset_);
+        memcpy(output + bytesRead, data_ + blockOffset_, toCopy);
+        blockOffset_ += toCopy;
+        bytesRead += toCopy;
+    }
+    return bytesRead;
+}
+
+int BGZFReader::skip(int length)
+{
+    int bytesSkipped = 0;
+    while (bytesSkipped < length) {
+        if (blockOffset_ >= blockLength_) {
+            if (!nextBlock()) {
+                return eof_ ? bytesSkipped : -1;
+            }
+        }
+        int toSkip = min(length - bytesSkipped, blockLength_ - blockOffset_);
+        blockOffset_ += toSkip;
+        bytesSkipped += toSkip;
+    }
+    return bytesSkipped;
+}
@@ -0,0 +1,90 @@
+#ifndef BGZFREADER_H
+#define BGZFREADER_H
+
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <pthread.h>
+#include <stdint.h>
+
+// BGZF is the blocked gzip format used by BAM (and by bgzip/tabix): a series of
+// independent gzip members of at most 64 Kb each, the size of every member
+// being stored in a "BC" extra field of its gzip header.
+//
+// Since blocks are independent, they can be inflated in parallel: when opened in
+// multithreaded mode, the reader takes as many threads as it can (up to
+// BGZF_MAX_THREADS) from the ThreadPoolManager budget; the worker threads read and
+// inflate blocks ahead while read()/skip() consume them in file order.
+
+#define BGZF_MAX_BLOCK_SIZE 65536
+#define BGZF_BLOCK_HEADER_LENGTH 18
+#define BGZF_MAX_THREADS 8
+#define BGZF_BLOCKS_PER_THREAD 8
+
+class BGZFReader
+{
+    public:
+        BGZFReader();
+        virtual ~BGZFReader();
+
+        bool open(std::string const& fileName, bool multithreaded = false);
+        void close();
+        bool isOpen() const {return file_ != NULL;}
+        const std::string& getFileName() const {return fileName_;}
+        int getNumberOfThreads() const {return int(threads_.size());}
+
+        int read(void* data, int length); //returns the number of bytes read, 0 at the end of file, -1 in case of error
+        int skip(int length); //same as read() but without copying the data
+        bool seek(uint64_t virtualOffset); //moves to a virtual offset taken from a BAM index; single-threaded mode only
+        uint64_t tell() const {return ((uint64_t)blockAddress_ << 16) | (uint64_t)blockOffset_;} //virtual offset of the next byte; single-threaded mode only
+        bool isError() const {return error_;}
+
+        static bool isBGZF(std::string const& fileName); //always false for standard input, pipes and FIFOs
+        static FILE* openInput(std::string const& fileName); //fopen() which also accepts "-" for the standard input
+
+        //block level primitives:
+        static int readRawBlock(FILE* file, char* compressed); //returns the size of the block, 0 at the end of file, -1 in case of error
+        static int inflateBlock(const char* compressed, int blockLength, char* uncompressed); //returns the size of the uncompressed data, -1 in case of error
+
+    protected:
+    private:
+        struct Block {
+            std::vector<char> compressed;
+            std::vector<char> uncompressed;
+            int length; //number of uncompressed bytes, -1 if the block could not be inflated
+            bool ready;
+        };
+
+        bool nextBlock();
+        bool nextInflatedBlock();
+        void startThreads();
+        void stopThreads();
+        void inflateLoop();
+        static void* inflateThread(void* arg);
+
+        FILE* file_;
+        std::string fileName_;
+        std::vector<char> compressed_;
+        std::vector<char> uncompressed_;
+        const char* data_; //uncompressed data of the current block
+        long blockAddress_; //offset of the current block in the file (single-threaded mode)
+        int blockLength_; //number of uncompressed bytes in the current block
+        int blockOffset_; //position in the current block
+        bool eof_;
+        bool error_;
+
+        //multithreaded mode: blocks_ is a ring buffer, block number i being stored at i % blocks_.size()
+        std::vector<Block> blocks_;
+        std::vector<pthread_t> threads_;
+        pthread_mutex_t mutex_;
+        pthread_cond_t blockReady_;
+        pthread_cond_t slotFree_;
+        long nextToRead_; //number of the next block to be read from the file
+        long nextToConsume_; //number of the block currently (or next) used by the consumer
+        long endOfInput_; //number of blocks in the file, known once the last one has been read
+        bool holdingBlock_;
+        bool inputError_;
+        bool stop_;
+};
+
+#endif // BGZFREADER_H
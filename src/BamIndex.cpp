@@ -0,0 +1,313 @@
+/*************************************************************************
+Copyright (c) 2010-2016, Valentina BOEVA.
+
+>>> SOURCE LICENSE >>>
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation (www.fsf.org); either version 2 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+A copy of the GNU General Public License is available at
+http://www.fsf.org/licensing/licenses
+
+>>> END OF LICENSE >>>
+*************************************************************************/
+
+#include "BamIndex.h"
+#include "BGZFReader.h"
+
+#include <iostream>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+using namespace std;
+
+//index integers are little-endian
+static inline uint64_t unpackUInt64(const unsigned char* buffer)
+{
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) {
+        value = (value << 8) | buffer[i];
+    }
+    return value;
+}
+
+static inline int unpackInt32(const unsigned char* buffer)
+{
+    return (int)(buffer[0] | (buffer[1] << 8) | (buffer[2] << 16) | ((unsigned int)buffer[3] << 24));
+}
+
+static bool binLess(BamIndexBin const& a, BamIndexBin const& b)
+{
+    return a.bin < b.bin;
+}
+
+static bool readPlainFile(std::string const& fileName, std::vector<char>& data)
+{
+    FILE* file = fopen(fileName.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    char buffer[65536];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data.insert(data.end(), buffer, buffer + count);
+    }
+    fclose(file);
+    return true;
+}
+
+static bool readBGZFFile(std::string const& fileName, std::vector<char>& data)
+{
+    BGZFReader reader;
+    if (!reader.open(fileName)) {
+        return false;
+    }
+    char buffer[65536];
+    int count;
+    while ((count = reader.read(buffer, sizeof(buffer))) > 0) {
+        data.insert(data.end(), buffer, buffer + count);
+    }
+    return count == 0;
+}
+
+BamIndex::BamIndex() : minShift_(14), depth_(5), unplacedReads_(-1)
+{
+    //ctor
+}
+
+BamIndex::~BamIndex()
+{
+    //dtor
+}
+
+bool BamIndex::load(std::string const& bamFileName)
+{
+    fileName_ = "";
+    bins_.clear();
+    linearIndex_.clear();
+    unplacedReads_ = -1;
+
+    vector<string> candidates;
+    candidates.push_back(bamFileName + ".bai");
+    if (bamFileName.size() > 4 && bamFileName.substr(bamFileName.size()-4,4).compare(".bam")==0) {
+        candidates.push_back(bamFileName.substr(0, bamFileName.size()-4) + ".bai");
+    }
+    candidates.push_back(bamFileName + ".csi");
+
+    for (size_t i = 0; i < candidates.size(); i++) {
+        bool isCSI = candidates[i].substr(candidates[i].size()-4,4).compare(".csi")==0;
+        vector<char> data;
+        if (isCSI ? !readBGZFFile(candidates[i], data) : !readPlainFile(candidates[i], data)) {
+            continue;
+        }
+        if (!parse(data, isCSI)) {
+            cerr << "Warning: " << candidates[i] << " is not a valid BAM index; it will not be used\n";
+            bins_.clear();
+            linearIndex_.clear();
+            unplacedReads_ = -1;
+            continue;
+        }
+        fileName_ = candidates[i];
+        return true;
+    }
+    return false;
+}
+
+bool BamIndex::parse(std::vector<char> const& data, bool isCSI)
+{
+    const unsigned char* buffer = (const unsigned char*)(data.empty() ? NULL : &data[0]);
+    size_t size = data.size();
+    size_t pos = 0;
+
+    #define BAMINDEX_NEED(n) if (pos + (size_t)(n) > size) return false
+
+    BAMINDEX_NEED(8);
+    if (memcmp(buffer, isCSI ? "CSI\1" : "BAI\1", 4) != 0) {
+        return false;
+    }
+    pos = 4;
+    if (isCSI) {
+        BAMINDEX_NEED(12);
+        minShift_ = unpackInt32(buffer + pos);
+        depth_ = unpackInt32(buffer + pos + 4);
+        int l_aux = unpackInt32(buffer + pos + 8);
+        pos += 12;
+        if (l_aux < 0) return false;
+        BAMINDEX_NEED(l_aux);
+        pos += l_aux;
+    } else {
+        minShift_ = 14;
+        depth_ = 5;
+    }
+    BAMINDEX_NEED(4);
+    int n_ref = unpackInt32(buffer + pos);
+    pos += 4;
+    if (n_ref < 0) return false;
+    bins_.resize(n_ref);
+    linearIndex_.resize(n_ref);
+
+    for (int ref = 0; ref < n_ref; ref++) {
+        BAMINDEX_NEED(4);
+        int n_bin = unpackInt32(buffer + pos);
+        pos += 4;
+        if (n_bin < 0) return false;
+        bins_[ref].resize(n_bin);
+        for (int i = 0; i < n_bin; i++) {
+            BamIndexBin& bin = bins_[ref][i];
+            BAMINDEX_NEED(4);
+            bin.bin = (unsigned int)unpackInt32(buffer + pos);
+            pos += 4;
+            bin.loffset = 0;
+            if (isCSI) {
+                BAMINDEX_NEED(8);
+                bin.loffset = unpackUInt64(buffer + pos);
+                pos += 8;
+            }
+            BAMINDEX_NEED(4);
+            int n_chunk = unpackInt32(buffer + pos);
+            pos += 4;
+            if (n_chunk < 0) return false;
+            BAMINDEX_NEED((size_t)n_chunk * 16);
+            bin.chunks.resize(n_chunk);
+            for (int j = 0; j < n_chunk; j++) {
+                bin.chunks[j].begin = unpackUInt64(buffer + pos);
+                bin.chunks[j].end = unpackUInt64(buffer + pos + 8);
+                pos += 16;
+            }
+        }
+        //sorted by bin number for getRegionStart()
+        sort(bins_[ref].begin(), bins_[ref].end(), binLess);
+        if (!isCSI) {
+            BAMINDEX_NEED(4);
+            int n_intv = unpackInt32(buffer + pos);
+            pos += 4;
+            if (n_intv < 0) return false;
+            BAMINDEX_NEED((size_t)n_intv * 8);
+            linearIndex_[ref].resize(n_intv);
+            for (int j = 0; j < n_intv; j++) {
+                linearIndex_[ref][j] = unpackUInt64(buffer + pos);
+                pos += 8;
+            }
+        }
+    }
+    //the number of reads without coordinates is optional
+    if (pos + 8 <= size) {
+        unplacedReads_ = (long long)unpackUInt64(buffer + pos);
+    }
+    #undef BAMINDEX_NEED
+    return true;
+}
+
+unsigned int BamIndex::getPseudoBin() const
+{
+    //the bin following the last bin of the binning scheme stores the offsets of the reference and its read counts
+    return (unsigned int)(((1 << ((depth_ + 1) * 3)) - 1) / 7 + 1);
+}
+
+bool BamIndex::getReferenceStart(int refID, uint64_t& offset) const
+{
+    if (refID < 0 || refID >= (int)bins_.size()) {
+        return false;
+    }
+    unsigned int pseudoBin = getPseudoBin();
+    bool found = false;
+    for (size_t i = 0; i < bins_[refID].size(); i++) {
+        const BamIndexBin& bin = bins_[refID][i];
+        if (bin.bin == pseudoBin) {
+            continue;
+        }
+        for (size_t j = 0; j < bin.chunks.size(); j++) {
+            if (!found || bin.chunks[j].begin < offset) {
+                offset = bin.chunks[j].begin;
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+long long BamIndex::getNumberOfReads(int refID) const
+{
+    if (refID < 0 || refID >= (int)bins_.size()) {
+        return -1;
+    }
+    if (bins_[refID].empty()) {
+        return 0;
+    }
+    unsigned int pseudoBin = getPseudoBin();
+    for (size_t i = 0; i < bins_[refID].size(); i++) {
+        const BamIndexBin& bin = bins_[refID][i];
+        if (bin.bin == pseudoBin && bin.chunks.size() == 2) {
+            return (long long)(bin.chunks[1].begin + bin.chunks[1].end);
+        }
+    }
+    return -1;
+}
+
+const BamIndexBin* BamIndex::findBin(int refID, unsigned int bin) const
+{
+    BamIndexBin key;
+    key.bin = bin;
+    std::vector<BamIndexBin>::const_iterator it = lower_bound(bins_[refID].begin(), bins_[refID].end(), key, binLess);
+    if (it == bins_[refID].end() || it->bin != bin) {
+        return NULL;
+    }
+    return &(*it);
+}
+
+bool BamIndex::getRegionStart(int refID, int beg, int end, uint64_t& offset) const
+{
+    if (refID < 0 || refID >= (int)bins_.size() || end <= beg) {
+        return false;
+    }
+    if (beg < 0) {
+        beg = 0;
+    }
+    //reads overlapping the region cannot start before minOffset
+    uint64_t minOffset = 0;
+    if (!linearIndex_[refID].empty()) {
+        size_t window = (size_t)(beg >> 14);
+        minOffset = window < linearIndex_[refID].size() ? linearIndex_[refID][window] : linearIndex_[refID].back();
+    } else {
+        //CSI: the smallest bin containing beg which is in the index
+        for (int level = depth_; level >= 0; level--) {
+            unsigned int first = (unsigned int)(((1 << (3 * level)) - 1) / 7);
+            const BamIndexBin* bin = findBin(refID, first + (unsigned int)(beg >> (minShift_ + 3 * (depth_ - level))));
+            if (bin) {
+                minOffset = bin->loffset;
+                break;
+            }
+        }
+    }
+    //at each level of the binning scheme, the bins overlapping [beg, end)
+    bool found = false;
+    --end;
+    for (int level = 0; level <= depth_; level++) {
+        int shift = minShift_ + 3 * (depth_ - level);
+        unsigned int first = (unsigned int)(((1 << (3 * level)) - 1) / 7);
+        for (unsigned int k = first + (unsigned int)(beg >> shift); k <= first + (unsigned int)(end >> shift); k++) {
+            const BamIndexBin* bin = findBin(refID, k);
+            if (!bin) {
+                continue;
+            }
+            for (size_t j = 0; j < bin->chunks.size(); j++) {
+                if (bin->chunks[j].end <= minOffset) {
+                    continue;
+                }
+                uint64_t begin = max(bin->chunks[j].begin, minOffset);
+                if (!found || begin < offset) {
+                    offset = begin;
+                    found = true;
+                }
+            }
+        }
+    }
+    return found;
+}
@@ -0,0 +1,51 @@
+#ifndef BAMINDEX_H
+#define BAMINDEX_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+// Index of a coordinate-sorted BAM file, read from a .bai or a .csi file.
+// Offsets are BGZF virtual offsets: (offset of the compressed block << 16) | offset in the uncompressed block
+
+struct BamIndexChunk {
+    uint64_t begin;
+    uint64_t end;
+};
+
+struct BamIndexBin {
+    unsigned int bin;
+    uint64_t loffset; //CSI only: smallest offset of the reads overlapping this bin
+    std::vector<BamIndexChunk> chunks;
+};
+
+class BamIndex
+{
+    public:
+        BamIndex();
+        virtual ~BamIndex();
+
+        bool load(std::string const& bamFileName); //looks for file.bam.bai, file.bai and file.bam.csi; returns false if there is no index
+        const std::string& getFileName() const {return fileName_;}
+
+        int getNumberOfReferences() const {return int(bins_.size());}
+        bool getReferenceStart(int refID, uint64_t& offset) const; //offset of the first read of the reference; false if it has no reads
+        long long getNumberOfReads(int refID) const; //mapped and unmapped reads placed on the reference, -1 if not recorded in the index
+        long long getNumberOfUnplacedReads() const {return unplacedReads_;} //-1 if not recorded in the index
+        bool getRegionStart(int refID, int beg, int end, uint64_t& offset) const; //offset from which to read the reads overlapping [beg, end) (0-based); false if there are none
+
+    protected:
+    private:
+        bool parse(std::vector<char> const& data, bool isCSI);
+        unsigned int getPseudoBin() const;
+        const BamIndexBin* findBin(int refID, unsigned int bin) const; //NULL if the bin is empty
+
+        std::string fileName_;
+        int minShift_;
+        int depth_;
+        std::vector<std::vector<BamIndexBin> > bins_; //for each reference, sorted by bin number
+        std::vector<std::vector<uint64_t> > linearIndex_; //BAI only: for each reference, smallest offset of the reads overlapping each 16 Kb window
+        long long unplacedReads_;
+};
+
+#endif // BAMINDEX_H
@@ -0,0 +1,182 @@
+/*************************************************************************
+Copyright (c) 2010-2016, Valentina BOEVA.
+
+>>> SOURCE LICENSE >>>
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation (www.fsf.org); either version 2 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+A copy of the GNU General Public License is available at
+http://www.fsf.org/licensing/licenses
+
+>>> END OF LICENSE >>>
+*************************************************************************/
+
+#include "BamReader.h"
+#include "LineReader.h"
+
+#include <iostream>
+#include <string.h>
+
+using namespace std;
+
+//BAM integers are little-endian
+static inline int unpackInt32(const unsigned char* buffer)
+{
+    return (int)(buffer[0] | (buffer[1] << 8) | (buffer[2] << 16) | ((unsigned int)buffer[3] << 24));
+}
+
+static inline int unpackUInt16(const unsigned char* buffer)
+{
+    return buffer[0] | (buffer[1] << 8);
+}
+
+BamReader::BamReader() : error_(false)
+{
+    //ctor
+}
+
+BamReader::~BamReader()
+{
+    close();
+}
+
+void BamReader::close()
+{
+    bgzf_.close();
+    refNames_.clear();
+    refLengths_.clear();
+}
+
+bool BamReader::open(std::string const& fileName, bool multithreaded)
+{
+    close();
+    error_ = false;
+    //a stream is checked by its first block instead
+    if (!LineReader::isStream(fileName) && !BGZFReader::isBGZF(fileName)) {
+        cerr << "Error: " << fileName << " is not a BAM file\n";
+        return false;
+    }
+    if (!bgzf_.open(fileName, multithreaded)) {
+        cerr << "Error: unable to open " << fileName << "\n";
+        return false;
+    }
+
+    unsigned char buffer[8];
+    if (bgzf_.read(buffer, 8) != 8 || memcmp(buffer, "BAM\1", 4) != 0) {
+        cerr << "Error: " << fileName << " does not start with a BAM header\n";
+        return false;
+    }
+    //skip the SAM text header
+    int l_text = unpackInt32(buffer + 4);
+    if (l_text < 0 || bgzf_.skip(l_text) != l_text) {
+        cerr << "Error: " << fileName << " has a truncated BAM header\n";
+        return false;
+    }
+    if (bgzf_.read(buffer, 4) != 4) {
+        cerr << "Error: " << fileName << " has a truncated BAM header\n";
+        return false;
+    }
+    int n_ref = unpackInt32(buffer);
+    vector<char> name;
+    for (int i = 0; i < n_ref; i++) {
+        if (bgzf_.read(buffer, 4) != 4) {
+            cerr << "Error: " << fileName << " has a truncated list of reference sequences\n";
+            return false;
+        }
+        int l_name = unpackInt32(buffer);
+        if (l_name <= 0) {
+            cerr << "Error: " << fileName << " has a corrupted list of reference sequences\n";
+            return false;
+        }
+        name.resize(l_name);
+        if (bgzf_.read(&name[0], l_name) != l_name || bgzf_.read(buffer, 4) != 4) {
+            cerr << "Error: " << fileName << " has a truncated list of reference sequences\n";
+            return false;
+        }
+        refNames_.push_back(string(&name[0], strnlen(&name[0], l_name)));
+        refLengths_.push_back(unpackInt32(buffer));
+    }
+    return true;
+}
+
+bool BamReader::isBAM(std::string const& fileName)
+{
+    if (!BGZFReader::isBGZF(fileName))
+        return false;
+    BGZFReader bgzf;
+    if (!bgzf.open(fileName))
+        return false;
+    char magic[4];
+    return bgzf.read(magic, 4) == 4 && memcmp(magic, "BAM\1", 4) == 0;
+}
+
+int BamReader::readCore(BamRecord& record)
+{
+    unsigned char core[36];
+    int bytesRead = bgzf_.read(core, 36);
+    if (bytesRead != 36) {
+        if (bytesRead != 0) {
+            cerr << "Error: " << bgzf_.getFileName() << " is truncated\n";
+            error_ = true;
+        }
+        return -1;
+    }
+    int block_size = unpackInt32(core);
+    if (block_size < 32) {
+        cerr << "Error: " << bgzf_.getFileName() << " contains a corrupted BAM record\n";
+        error_ = true;
+        return -1;
+    }
+    record.refID = unpackInt32(core + 4);
+    record.pos = unpackInt32(core + 8);
+    record.l_read_name = core[12];
+    record.mapq = core[13];
+    record.n_cigar_op = unpackUInt16(core + 16);
+    record.flag = unpackUInt16(core + 18);
+    record.l_seq = unpackInt32(core + 20);
+    record.next_refID = unpackInt32(core + 24);
+    record.next_pos = unpackInt32(core + 28);
+    record.tlen = unpackInt32(core + 32);
+    return block_size - 32;
+}
+
+bool BamReader::next(BamRecord& record)
+{
+    int toSkip = readCore(record);
+    if (toSkip < 0)
+        return false;
+
+    //read name, CIGAR, sequence, qualities and tags are not needed to count reads
+    if (bgzf_.skip(toSkip) != toSkip) {
+        cerr << "Error: " << bgzf_.getFileName() << " is truncated\n";
+        error_ = true;
+        return false;
+    }
+    return true;
+}
+
+bool BamReader::next(BamRecord& record, std::vector<unsigned char>& data)
+{
+    int toRead = readCore(record);
+    if (toRead < 0)
+        return false;
+    if (record.l_read_name + 4*record.n_cigar_op + (record.l_seq+1)/2 + record.l_seq > toRead) {
+        cerr << "Error: " << bgzf_.getFileName() << " contains a corrupted BAM record\n";
+        error_ = true;
+        return false;
+    }
+    data.resize(toRead + 1);
+    if (bgzf_.read(&data[0], toRead) != toRead) {
+        cerr << "Error: " << bgzf_.getFileName() << " is truncated\n";
+        error_ = true;
+        return false;
+    }
+    return true;
+}
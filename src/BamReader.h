@@ -0,0 +1,73 @@
+#ifndef BAMREADER_H
+#define BAMREADER_H
+
+#include <string>
+#include <vector>
+
+#include "BGZFReader.h"
+
+#define BAM_FPAIRED 0x1
+#define BAM_FPROPER_PAIR 0x2
+#define BAM_FUNMAP 0x4
+#define BAM_FREVERSE 0x10
+#define BAM_FMREVERSE 0x20
+#define BAM_FSECONDARY 0x100
+#define BAM_FQCFAIL 0x200
+#define BAM_FDUP 0x400
+#define BAM_FSUPPLEMENTARY 0x800
+
+//CIGAR operations as stored in the lower 4 bits of a BAM CIGAR field
+#define BAM_CMATCH 0
+#define BAM_CINS 1
+#define BAM_CDEL 2
+#define BAM_CREF_SKIP 3
+#define BAM_CSOFT_CLIP 4
+#define BAM_CHARD_CLIP 5
+#define BAM_CPAD 6
+#define BAM_CEQUAL 7
+#define BAM_CDIFF 8
+
+//core (fixed length) fields of a BAM record; positions are 0-based as in the BAM file
+struct BamRecord {
+    int refID;
+    int pos;
+    int mapq;
+    int flag;
+    int l_seq;
+    int next_refID;
+    int next_pos;
+    int tlen;
+    int l_read_name;
+    int n_cigar_op;
+};
+
+class BamReader
+{
+    public:
+        BamReader();
+        virtual ~BamReader();
+
+        bool open(std::string const& fileName, bool multithreaded = false); //opens the file and reads the header; see BGZFReader for the multithreaded mode
+        void close();
+        bool next(BamRecord& record); //reads the core fields of the next record and skips the variable length part; returns false at the end of file or in case of error
+        bool next(BamRecord& record, std::vector<unsigned char>& data); //the same but keeps the variable length part (read name, CIGAR, sequence, qualities, tags) in data
+        bool isError() const {return error_;}
+        bool seek(uint64_t virtualOffset) {return bgzf_.seek(virtualOffset);} //moves to a record start given by a BamIndex
+        uint64_t tell() const {return bgzf_.tell();} //virtual offset of the next record; single-threaded mode only
+
+        int getNumberOfReferences() const {return int(refNames_.size());}
+        const std::string& getReferenceName(int refID) const {return refNames_[refID];}
+        int getReferenceLength(int refID) const {return refLengths_[refID];}
+
+        static bool isBAM(std::string const& fileName); //BGZF file starting with the BAM magic string
+
+    protected:
+    private:
+        int readCore(BamRecord& record); //returns the length of the variable part or -1
+        BGZFReader bgzf_;
+        std::vector<std::string> refNames_;
+        std::vector<int> refLengths_;
+        bool error_;
+};
+
+#endif // BAMREADER_H
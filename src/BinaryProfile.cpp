@@ -0,0 +1,272 @@
+/*************************************************************************
+Copyright (c) 2010-2016, Valentina BOEVA.
+
+>>> SOURCE LICENSE >>>
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation (www.fsf.org); either version 2 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+A copy of the GNU General Public License is available at
+http://www.fsf.org/licensing/licenses
+
+>>> END OF LICENSE >>>
+*************************************************************************/
+
+#include "BinaryProfile.h"
+
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+using namespace std;
+
+static const char PROFILE_MAGIC[8] = {'F', 'R', 'E', 'E', 'C', 'C', 'P', 'N'};
+static const size_t HEADER_SIZE = 24;
+
+static uint64_t padded(uint64_t length)
+{
+    return (length + 7) & ~(uint64_t)7;
+}
+
+BinaryProfileReader::BinaryProfileReader() : map_(NULL), mapLength_(0), windowSize_(0), step_(0)
+{
+}
+
+BinaryProfileReader::~BinaryProfileReader()
+{
+    close();
+}
+
+bool BinaryProfileReader::isBinaryProfile(std::string const& fileName)
+{
+    FILE* file = fopen(fileName.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    char magic[8];
+    bool isBinary = fread(magic, 1, 8, file) == 8 && memcmp(magic, PROFILE_MAGIC, 8) == 0;
+    fclose(file);
+    return isBinary;
+}
+
+bool BinaryProfileReader::open(std::string const& fileName)
+{
+    close();
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < HEADER_SIZE) {
+        ::close(fd);
+        return false;
+    }
+    mapLength_ = (size_t)info.st_size;
+#if !defined(_WIN32)
+    void* map = mmap(NULL, mapLength_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map != MAP_FAILED) {
+        map_ = (const char*)map;
+    }
+#endif
+    if (!map_) {
+        buffer_.resize(mapLength_);
+        size_t done = 0;
+        while (done < mapLength_) {
+            int n = ::read(fd, &buffer_[done], (unsigned int)(mapLength_ - done));
+            if (n <= 0) {
+                break;
+            }
+            done += n;
+        }
+        if (done < mapLength_) {
+            ::close(fd);
+            close();
+            return false;
+        }
+    }
+    ::close(fd);
+
+    const char* data = map_ ? map_ : &buffer_[0];
+    uint32_t version, numberOfChromosomes;
+    int32_t windowSize, step;
+    memcpy(&version, data + 8, 4);
+    memcpy(&numberOfChromosomes, data + 12, 4);
+    memcpy(&windowSize, data + 16, 4);
+    memcpy(&step, data + 20, 4);
+    if (memcmp(data, PROFILE_MAGIC, 8) != 0 || version != BINARY_PROFILE_VERSION
+        || HEADER_SIZE + (uint64_t)numberOfChromosomes*sizeof(BinaryProfileEntry) > mapLength_) {
+        close();
+        return false;
+    }
+    windowSize_ = windowSize;
+    step_ = step;
+    chromosomes_.resize(numberOfChromosomes);
+    if (numberOfChromosomes > 0) {
+        memcpy(&chromosomes_[0], data + HEADER_SIZE, numberOfChromosomes*sizeof(BinaryProfileEntry));
+    }
+    //all arrays must be in the file
+    for (int i = 0; i < (int)chromosomes_.size(); i++) {
+        BinaryProfileEntry const& entry = chromosomes_[i];
+        uint64_t arrays = (entry.flags & BINARY_PROFILE_ENDS) ? 3 : 2;
+        uint64_t end = entry.offset + padded(entry.nameLength) + arrays*padded(4*(uint64_t)entry.length) + entry.geneNamesLength;
+        if (entry.offset % 8 != 0 || end > mapLength_) {
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void BinaryProfileReader::close()
+{
+#if !defined(_WIN32)
+    if (map_) {
+        munmap((void*)map_, mapLength_);
+    }
+#endif
+    map_ = NULL;
+    mapLength_ = 0;
+    vector<char>().swap(buffer_);
+    chromosomes_.clear();
+}
+
+std::string BinaryProfileReader::getChromosome(int i) const
+{
+    const char* data = map_ ? map_ : &buffer_[0];
+    return string(data + chromosomes_[i].offset, chromosomes_[i].nameLength);
+}
+
+const float* BinaryProfileReader::getValues(int i) const
+{
+    const char* data = map_ ? map_ : &buffer_[0];
+    return (const float*)(data + chromosomes_[i].offset + padded(chromosomes_[i].nameLength));
+}
+
+const int* BinaryProfileReader::getCoordinates(int i) const
+{
+    return (const int*)((const char*)getValues(i) + padded(4*(uint64_t)chromosomes_[i].length));
+}
+
+const int* BinaryProfileReader::getEnds(int i) const
+{
+    if (!(chromosomes_[i].flags & BINARY_PROFILE_ENDS)) {
+        return NULL;
+    }
+    return (const int*)((const char*)getCoordinates(i) + padded(4*(uint64_t)chromosomes_[i].length));
+}
+
+void BinaryProfileReader::getGeneNames(int i, std::vector<std::string>& names) const
+{
+    names.clear();
+    if (!(chromosomes_[i].flags & BINARY_PROFILE_GENE_NAMES)) {
+        return;
+    }
+    uint64_t arrays = (chromosomes_[i].flags & BINARY_PROFILE_ENDS) ? 2 : 1;
+    const char* name = (const char*)getCoordinates(i) + arrays*padded(4*(uint64_t)chromosomes_[i].length);
+    const char* end = name + chromosomes_[i].geneNamesLength;
+    while (name < end && (int)names.size() < (int)chromosomes_[i].length) {
+        size_t length = strnlen(name, end - name);
+        names.push_back(string(name, length));
+        name += length + 1;
+    }
+}
+
+BinaryProfileWriter::BinaryProfileWriter() : file_(NULL), offset_(0), error_(false)
+{
+}
+
+BinaryProfileWriter::~BinaryProfileWriter()
+{
+    if (file_) {
+        fclose(file_);
+    }
+}
+
+bool BinaryProfileWriter::open(std::string const& fileName, int windowSize, int step, int numberOfChromosomes)
+{
+    file_ = fopen(fileName.c_str(), "wb");
+    if (!file_) {
+        return false;
+    }
+    error_ = false;
+    directory_.clear();
+    uint32_t version = BINARY_PROFILE_VERSION;
+    uint32_t count = numberOfChromosomes;
+    int32_t window = windowSize;
+    int32_t profileStep = step;
+    error_ = fwrite(PROFILE_MAGIC, 1, 8, file_) != 8 || fwrite(&version, 4, 1, file_) != 1 || fwrite(&count, 4, 1, file_) != 1
+        || fwrite(&window, 4, 1, file_) != 1 || fwrite(&profileStep, 4, 1, file_) != 1;
+    //the directory is written by close(), once the offsets are known
+    vector<BinaryProfileEntry> directory(numberOfChromosomes);
+    offset_ = HEADER_SIZE;
+    if (!directory.empty()) {
+        error_ = error_ || !write(&directory[0], directory.size()*sizeof(BinaryProfileEntry));
+    }
+    return !error_;
+}
+
+bool BinaryProfileWriter::write(const void* data, size_t length)
+{
+    static const char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    size_t padding = padded(length) - length;
+    if ((length > 0 && fwrite(data, 1, length, file_) != length) || (padding > 0 && fwrite(zeros, 1, padding, file_) != padding)) {
+        error_ = true;
+        return false;
+    }
+    offset_ += length + padding;
+    return true;
+}
+
+bool BinaryProfileWriter::addChromosome(std::string const& name, std::vector<float> const& values, std::vector<int> const& coordinates, std::vector<int> const* ends, std::vector<std::string> const* geneNames)
+{
+    BinaryProfileEntry entry;
+    entry.offset = offset_;
+    entry.length = (uint32_t)values.size();
+    entry.flags = (ends ? BINARY_PROFILE_ENDS : 0) | (geneNames ? BINARY_PROFILE_GENE_NAMES : 0);
+    entry.nameLength = (uint32_t)name.size();
+    entry.geneNamesLength = 0;
+    string names;
+    if (geneNames) {
+        for (int i = 0; i < (int)geneNames->size(); i++) {
+            names.append((*geneNames)[i]);
+            names.push_back('\0');
+        }
+        entry.geneNamesLength = (uint32_t)names.size();
+    }
+    write(name.data(), name.size());
+    write(values.empty() ? NULL : &values[0], 4*values.size());
+    write(coordinates.empty() ? NULL : &coordinates[0], 4*coordinates.size());
+    if (ends) {
+        write(ends->empty() ? NULL : &(*ends)[0], 4*ends->size());
+    }
+    write(names.data(), names.size());
+    directory_.push_back(entry);
+    return !error_;
+}
+
+bool BinaryProfileWriter::close()
+{
+    if (!file_) {
+        return false;
+    }
+    if (!directory_.empty()) {
+        error_ = error_ || fseek(file_, HEADER_SIZE, SEEK_SET) != 0 || fwrite(&directory_[0], sizeof(BinaryProfileEntry), directory_.size(), file_) != directory_.size();
+    }
+    error_ = (fclose(file_) != 0) || error_;
+    file_ = NULL;
+    return !error_;
+}
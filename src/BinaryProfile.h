@@ -0,0 +1,83 @@
+#ifndef BINARYPROFILE_H
+#define BINARYPROFILE_H
+
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdint.h>
+
+// Binary copy number profiles (.cpnb), written instead of or with the text .cpn files
+// (copyNumberFormat=binary|both) and accepted by mateCopyNumberFile.
+// The file is memory-mapped when read: read counts, starts and ends are used in place.
+//
+// Layout, in native byte order, every array aligned on 8 bytes:
+//   header:    char magic[8] = "FREECCPN", uint32 version, uint32 number of chromosomes, int32 window, int32 step
+//   directory: one entry per chromosome: uint64 offset, uint32 number of windows, uint32 flags, uint32 name length, uint32 gene names length
+//   at offset: name, float readCount[n], int32 start[n], int32 end[n] (flag BINARY_PROFILE_ENDS),
+//              null-terminated gene names (flag BINARY_PROFILE_GENE_NAMES, WES)
+
+#define BINARY_PROFILE_VERSION 1
+#define BINARY_PROFILE_ENDS 1
+#define BINARY_PROFILE_GENE_NAMES 2
+
+//directory entry of a chromosome
+struct BinaryProfileEntry {
+    uint64_t offset;
+    uint32_t length; //number of windows
+    uint32_t flags;
+    uint32_t nameLength;
+    uint32_t geneNamesLength; //bytes, including the null characters
+};
+
+class BinaryProfileReader
+{
+    public:
+        BinaryProfileReader();
+        virtual ~BinaryProfileReader();
+
+        static bool isBinaryProfile(std::string const& fileName); //checks the magic of the file
+        bool open(std::string const& fileName); //false if the file cannot be mapped or is not a valid profile
+        void close();
+
+        int getWindowSize() const {return windowSize_;}
+        int getStep() const {return step_;}
+        int getNumberOfChromosomes() const {return (int)chromosomes_.size();}
+        std::string getChromosome(int i) const;
+        int getLength(int i) const {return (int)chromosomes_[i].length;}
+        const float* getValues(int i) const;
+        const int* getCoordinates(int i) const;
+        const int* getEnds(int i) const; //NULL if the profile has no ends (window == step)
+        void getGeneNames(int i, std::vector<std::string>& names) const; //empty if the profile has no gene names
+
+    protected:
+    private:
+        const char* map_;
+        size_t mapLength_;
+        std::vector<char> buffer_; //the file when it cannot be mapped
+        std::vector<BinaryProfileEntry> chromosomes_;
+        int windowSize_;
+        int step_;
+};
+
+class BinaryProfileWriter
+{
+    public:
+        BinaryProfileWriter();
+        virtual ~BinaryProfileWriter();
+
+        bool open(std::string const& fileName, int windowSize, int step, int numberOfChromosomes);
+        //ends and geneNames may be NULL
+        bool addChromosome(std::string const& name, std::vector<float> const& values, std::vector<int> const& coordinates, std::vector<int> const* ends, std::vector<std::string> const* geneNames);
+        bool close(); //writes the directory; false if any write failed
+
+    protected:
+    private:
+        bool write(const void* data, size_t length); //padded to 8 bytes
+
+        FILE* file_;
+        std::vector<BinaryProfileEntry> directory_;
+        uint64_t offset_;
+        bool error_;
+};
+
+#endif // BINARYPROFILE_H
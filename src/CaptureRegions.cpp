@@ -0,0 +1,131 @@
+/*************************************************************************
+Copyright (c) 2010-2016, Valentina BOEVA.
+
+>>> SOURCE LICENSE >>>
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation (www.fsf.org); either version 2 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+A copy of the GNU General Public License is available at
+http://www.fsf.org/licensing/licenses
+
+>>> END OF LICENSE >>>
+*************************************************************************/
+
+#include "CaptureRegions.h"
+#include "LineReader.h"
+#include "myFunc.h"
+
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace std;
+
+std::map<std::string, CaptureRegions*> CaptureRegions::instances_;
+pthread_mutex_t CaptureRegions::instancesMutex_ = PTHREAD_MUTEX_INITIALIZER;
+
+CaptureRegions const& CaptureRegions::getInstance(std::string const& bedFileName)
+{
+    //the sample and the control can be read by two threads at the same time
+    pthread_mutex_lock(&instancesMutex_);
+    map<string, CaptureRegions*>::iterator it = instances_.find(bedFileName);
+    if (it == instances_.end()) {
+        it = instances_.insert(make_pair(bedFileName, new CaptureRegions(bedFileName))).first;
+    }
+    pthread_mutex_unlock(&instancesMutex_);
+    return *it->second;
+}
+
+CaptureRegions::CaptureRegions(std::string const& bedFileName) : fileName_(bedFileName), numberOfRegions_(0)
+{
+    LineReader file;
+    if (!file.open(bedFileName)) {
+        cerr << "Error: Unable to open file "+bedFileName+"\n";
+        exit(-1);
+    }
+    cout << "..Reading "<< bedFileName << "\n";
+    cout << "..Your file must be in .BED format, and it must be sorted\n";
+
+    const char* view;
+    int viewLength;
+    string line;
+    string chr;
+    ChrCaptureRegions* current = NULL;
+    while (file.next(view, viewLength)) {
+        //avoid catching a carriage return if the file uses windows-style line endings
+        if (viewLength != 0 && view[viewLength - 1] == '\r')
+            viewLength--;
+        if (viewLength == 0 || view[0] == '#')
+            continue;
+        const char* tab = (const char*)memchr(view, '\t', viewLength);
+        if (tab == NULL)
+            continue;
+
+        line.assign(view, viewLength);
+        size_t offset = tab - view;
+        string bedName = line.substr(0, offset);
+        if (current == NULL || current->bedName != bedName) {
+            //"chr1" and "1" are the same chromosome
+            chr = bedName;
+            processChrName(chr);
+            map<string, ChrCaptureRegions>::iterator it = regions_.find(chr);
+            if (it == regions_.end()) {
+                it = regions_.insert(make_pair(chr, ChrCaptureRegions())).first;
+                it->second.bedName = bedName;
+                chromosomes_.push_back(chr);
+            }
+            current = &it->second;
+            current->blocks++;
+        }
+
+        ++offset;
+        size_t startoff = offset;
+        advance_to(line, offset, '\t');
+        string start = line.substr(startoff, offset - startoff);
+        ++offset;
+        size_t endoff = min(offset, line.size());
+        advance_to(line, offset, '\t');
+        string endstr = line.substr(endoff, offset - endoff);
+        if (start.size() == 0 || endstr.size() == 0) {
+            current->skippedLines++;
+            continue;
+        }
+        current->starts.push_back(atoi(start.c_str()));
+        current->ends.push_back(atoi(endstr.c_str()));
+
+        advance_to(line, offset, ':'); ++offset;
+        advance_to(line, offset, ':'); ++offset;
+        size_t geneoff = offset;
+        advance_to(line, offset, '\t');
+        if (offset != geneoff) {
+            current->names.push_back(line.substr(geneoff, offset - geneoff));
+        } else {
+            //print chr:start-end if a name isn't supplied
+            std::ostringstream oss;
+            oss << chr << ":" << start << "-" << endstr;
+            current->names.push_back(oss.str());
+        }
+        numberOfRegions_++;
+    }
+    if (file.isError()) {
+        cerr << "Error: FREEC was not able to read "<< bedFileName << " until the end\n";
+        exit(-1);
+    }
+    cout << "file " << bedFileName << " is read: " << numberOfRegions_ << " targeted regions\n";
+}
+
+const ChrCaptureRegions* CaptureRegions::getRegions(std::string const& chr) const
+{
+    map<string, ChrCaptureRegions>::const_iterator it = regions_.find(chr);
+    if (it == regions_.end())
+        return NULL;
+    return &it->second;
+}
@@ -0,0 +1,48 @@
+#ifndef CAPTUREREGIONS_H
+#define CAPTUREREGIONS_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <pthread.h>
+
+// Targeted regions of a WES experiment (captureRegions). The .bed file is parsed once per run:
+// the ChrCopyNumber of every chromosome, GenomeCopyNumber::focusOnCapture() and BAFpileup
+// all take their targets from the same instance.
+
+//targets of one chromosome, in the order of the .bed file
+struct ChrCaptureRegions {
+    std::string bedName; //chromosome name as written in the .bed file, e.g. "chr1"
+    std::vector<int> starts;
+    std::vector<int> ends;
+    std::vector<std::string> names; //fourth column after its second ':', or chr:start-end
+    int skippedLines; //lines with an empty start or end
+    int blocks; //number of runs of consecutive lines of this chromosome: more than one if the file is not sorted
+
+    ChrCaptureRegions() : skippedLines(0), blocks(0) { }
+};
+
+class CaptureRegions
+{
+    public:
+        static CaptureRegions const& getInstance(std::string const& bedFileName); //reads the file at the first call for this name; exits if it cannot be opened
+
+        const std::string& getFileName() const {return fileName_;}
+        const std::vector<std::string>& getChromosomes() const {return chromosomes_;} //names processed by processChrName(), in the order of the file
+        const ChrCaptureRegions* getRegions(std::string const& chr) const; //NULL if there are no targets on chr
+        long getNumberOfRegions() const {return numberOfRegions_;}
+
+    protected:
+    private:
+        CaptureRegions(std::string const& bedFileName);
+
+        std::string fileName_;
+        std::vector<std::string> chromosomes_;
+        std::map<std::string, ChrCaptureRegions> regions_;
+        long numberOfRegions_;
+
+        static std::map<std::string, CaptureRegions*> instances_;
+        static pthread_mutex_t instancesMutex_;
+};
+
+#endif // CAPTUREREGIONS_H
@@ -20,21 +20,26 @@ http://www.fsf.org/licensing/licenses
 
 
 #include "ChrCopyNumber.h"
+#include "CaptureRegions.h"
 
 using namespace std ;
 
 ChrCopyNumber::ChrCopyNumber(void)
 {
+	isFixedGrid_ = false;
 	isMedianCalculated_ = false;
 	isSmoothed_ = false;
+	targetNames_ = NULL;
 	normalContamination_=0;
 }
 
 ChrCopyNumber::ChrCopyNumber(std::string const& chrName) {
 	chromosome_ = chrName;
+	isFixedGrid_ = false;
 	isMedianCalculated_ = false;
 	isSmoothed_ = false;
 	ploidy_=NA;
+	targetNames_ = NULL;
 	normalContamination_=0;
 }
 
@@ -43,19 +48,17 @@ ChrCopyNumber::ChrCopyNumber(int windowSize, int chrLength, std::string const& c
 	chrLength_ = chrLength;
 	chromosome_ = chrName;
 	step_=windowSize;
+	isFixedGrid_ = true;
 	isMedianCalculated_ = false;
 	isSmoothed_ = false;
 	ploidy_=NA;
+	targetNames_ = NULL;
 	if (windowSize ==0) {
         cerr << "Error: windowSize is set to Zero\n";
         exit(-1);
 	}
 	length_ = chrLength/windowSize+1;
-	coordinates_ = vector<int>(length_);
 	readCount_ = vector<float>(length_,0);
-	for (int i = 0; i<length_; i++) {
-		coordinates_[i] = i*windowSize;
-	}
 	normalContamination_=0;
 }
 
@@ -67,116 +70,55 @@ ChrCopyNumber::ChrCopyNumber(int windowSize, int chrLength, std::string const& c
 	isMedianCalculated_ = false;
 	isSmoothed_ = false;
 	ploidy_=NA;
+	targetNames_ = NULL;
 	float meanTargetRegionLength=0;
-	if (targetBed == "")     {
+	isFixedGrid_ = targetBed == "";
+	if (isFixedGrid_)     {
         if (windowSize ==0) {
             cerr << "Error: windowSize is set to Zero\n";
             exit(-1);
         }
         length_ = chrLength/step+1;
-        coordinates_ = vector<int>(length_);
         readCount_ = vector<float>(length_,0);
-        if (step<windowSize) {
-            ends_ = vector<int>(length_,0);
-            for (int i = 0; i<length_; i++) {
-                ends_[i] = i*step+windowSize_-1;
-            }
-        }
-        for (int i = 0; i<length_; i++) {
-            coordinates_[i] = i*step;
-            }
     }   else   {
-        std::string const& captureFile = targetBed ;
-        ifstream file (captureFile.c_str());
-        if (file.is_open())     {
-            cout << "..Reading "<< captureFile << "\n";
-            cout << "..Your file must be in .BED format, and it must be sorted\n";
-            std::string line;
-
-			// length_ should end up equal to the number of exons matching this chromosome.
-			length_ = 0;
-			size_t tried = 0;
-
-
-            while (std::getline(file,line))   {
-
-					// Avoid catching a carriage return if the file uses windows-style line endings
-					if(line.size() != 0 && line[line.size() - 1] == '\r')
-						line.erase(line.size() - 1);
-
-					size_t offset = 0;
-					// Treat 'chr1' and '1' equivalently
-					if(line.substr(0, 3) == "chr")
-						offset += 3;
-					size_t chrstart = offset;
-					advance_to(line, offset, '\t');
-
-					if(offset == line.size())
-						continue;
-
-					if(line.substr(chrstart, offset - chrstart) == chromosome_) {
-
-						++tried;
-
-						std::string start, endstr;
-						++offset;
-						size_t startoff = offset;
-						advance_to(line, offset, '\t');
-						start = line.substr(startoff, offset - startoff);
-						if(start.size() == 0)
-							continue;
-
-						coordinates_.push_back(atoi(start.c_str()));
-
-						++offset;
-						size_t endoff = offset;
-						advance_to(line, offset, '\t');
-						endstr = line.substr(endoff, offset - endoff);
-						if(endstr.size() == 0)
-							continue;
-
-						ends_.push_back(atoi(endstr.c_str()));
-
-						advance_to(line, offset, ':'); ++offset;
-						advance_to(line, offset, ':'); ++offset;
-						size_t geneoff = offset;
-						advance_to(line, offset, '\t');
-
-						if(offset != geneoff)
-							genes_names.push_back(line.substr(geneoff, offset - geneoff));
-						else {
-							// Print chr:start-end if a name isn't supplied.
-							std::ostringstream oss;
-							oss << chromosome_ << ":" << start << "-" << endstr;
-							oss.flush();
-							genes_names.push_back(oss.str());
-						}
-                        meanTargetRegionLength+=atoi(endstr.c_str())-atoi(start.c_str());
-						++length_;
-
-					}
-
-                }
-
-            if(int(tried) != length_) {
-                std::cerr << "Warning: skipped " << (tried - length_) << " lines due to formatting problems\n";
+        //the .bed file is read once for all chromosomes
+        const ChrCaptureRegions* targets = CaptureRegions::getInstance(targetBed).getRegions(chromosome_);
+        length_ = 0;
+        if (targets) {
+            coordinates_ = targets->starts;
+            ends_ = targets->ends;
+            targetNames_ = &targets->names;
+            length_ = (int)coordinates_.size();
+            for (int i = 0; i < length_; i++) {
+                meanTargetRegionLength+=ends_[i]-coordinates_[i];
             }
-
-            exons_Countchr_ = length_;
-            meanTargetRegionLength/=length_;
-			readCount_ = vector<float>(exons_Countchr_,0);
-
-			cout << "Number of exons analysed in chromosome "<< chromosome_ << " : " << exons_Countchr_ << "\n";
-            cout << "Average exon length in chromosome "<< chromosome_ << " : " << meanTargetRegionLength << "\n";
-            if (meanTargetRegionLength <30) {
-                cerr << "WARNING: check your file with targeted regions: the average length of targeted regions is unexpectedly short\n";
+            if (targets->skippedLines) {
+                std::cerr << "Warning: skipped " << targets->skippedLines << " lines due to formatting problems\n";
             }
+        }
 
-        }else {
-			std::cerr << "Failed to open " << captureFile << "\n";
-			exit(1);
-		}
+        exons_Countchr_ = length_;
+        //index for findExon(), unless the targets are not sorted
+        bool isSorted = true;
+        for (int i = 1; i < length_ && isSorted; i++) {
+            isSorted = coordinates_[i-1] <= coordinates_[i];
+        }
+        if (isSorted) {
+            maxEnds_.resize(length_);
+            for (int i = 0; i < length_; i++) {
+                maxEnds_[i] = (i == 0) ? ends_[i] : std::max(maxEnds_[i-1], ends_[i]);
+            }
+        } else {
+            std::cerr << "Warning: targeted regions of chromosome " << chromosome_ << " are not sorted; reads will be assigned to them more slowly\n";
+        }
+        meanTargetRegionLength/=length_;
+        readCount_ = vector<float>(exons_Countchr_,0);
 
+        cout << "Number of exons analysed in chromosome "<< chromosome_ << " : " << exons_Countchr_ << "\n";
+        cout << "Average exon length in chromosome "<< chromosome_ << " : " << meanTargetRegionLength << "\n";
+        if (meanTargetRegionLength <30) {
+            cerr << "WARNING: check your file with targeted regions: the average length of targeted regions is unexpectedly short\n";
+        }
     }
 
 
@@ -249,35 +191,46 @@ ChrCopyNumber::ChrCopyNumber(int windowSize, int chrLength, std::string const& c
 }
 
 
-void ChrCopyNumber::mappedPlusOneAtI(int i, int step, int l) {
-  if (l == -1)  {
-    int pos = i/step;
-    if ((int)readCount_.size()<=pos) {
-		//should not normally happen unless we are at the very end of file
-		cout << "Reaching end of file for chr "<<chromosome_ <<", position " << i <<"\n";
-		//readCount_.resize(pos+1);
-		//length_ = pos+1;
-	} else {
-		readCount_[pos]++;
-        while (step*(pos-1)+windowSize_>i && pos>=1) {
-            readCount_[--pos]++;
-        }
+void ChrCopyNumber::finishReadCounting() {
+	if (readCountChanges_.empty()) {
+		return;
 	}
-  }  else  {
-    int pos = l;
-    if ((int)readCount_.size()<=pos)   {
-        //should not normally happen unless we are at the very end of file
-        cout << "Reaching end of file for chr "<<chromosome_ <<", position " << i <<"\n";
-        //readCount_.resize(pos+1);
-        //length_ = pos+1;
-    }    else    {
-        readCount_[pos]++;
-        //while (step*(pos-1)+windowSize_>i && pos>=1)
-          //{
-          //readCount_[--pos]++;
-          //}
-    }
-  }
+	int count = 0;
+	for (int i = 0; i < (int)readCount_.size(); i++) {
+		count += readCountChanges_[i];
+		readCount_[i] += count;
+	}
+	vector<int>().swap(readCountChanges_);
+}
+
+void ChrCopyNumber::setReadCounts(std::vector<unsigned int> const& fineCounts, int resolution) {
+	//window i is made of the fine windows i*step_/resolution to (i*step_+windowSize_)/resolution (excluded)
+	int count = (int)fineCounts.size();
+	vector<long> cumulatedCounts(count+1, 0);
+	for (int j = 0; j < count; j++) {
+		cumulatedCounts[j+1] = cumulatedCounts[j] + fineCounts[j];
+	}
+	for (int i = 0; i < length_; i++) {
+		int first = min(int((long)i*step_/resolution), count);
+		int last = min(int(((long)i*step_+windowSize_)/resolution), count);
+		readCount_[i] = float(cumulatedCounts[last] - cumulatedCounts[first]);
+	}
+}
+
+void ChrCopyNumber::mergeWindows(int factor) {
+	//only valid before any other profile is calculated, and for step == windowSize
+	if (factor <= 1) {
+		return;
+	}
+	windowSize_ *= factor;
+	step_ = windowSize_;
+	int length = chrLength_/windowSize_+1;
+	vector<float> readCount(length,0);
+	for (int i = 0; i<length_; i++) {
+		readCount[i/factor] += readCount_[i];
+	}
+	readCount_.swap(readCount);
+	length_ = length;
 }
 
 void ChrCopyNumber::setValueAt(int i, float val) {
@@ -308,25 +261,17 @@ float ChrCopyNumber::getPopulation_subc(int i)
 
 std::string ChrCopyNumber::getGeneNameAtBin(int i)
 {
-    if (i<int(genes_names.size()))
-        return genes_names[i];
+    if (targetNames_)
+        return i<int(targetNames_->size()) ? (*targetNames_)[i] : "";
+    if (i<int(geneNameIndices_.size()))
+        return geneNames_[geneNameIndices_[i]];
     return "";
 }
 
-float ChrCopyNumber::getValueAt(int i) {
+float ChrCopyNumber::getValueAt(int i) const {
 	return readCount_[i];
 }
 
-int ChrCopyNumber::getCoordinateAtBin(int i) {
-	return coordinates_[i];
-}
-int ChrCopyNumber::getEndAtBin(int i) {
-	if ((int)ends_.size()>i)
-        return ends_[i];
-    else
-        return coordinates_[i]+windowSize_-1;
-}
-
 int ChrCopyNumber::getExons_Countchr() {
 	return exons_Countchr_;
 }
@@ -349,6 +294,12 @@ void ChrCopyNumber::setBAFat(int i, float value) {
 void ChrCopyNumber::addToReadCount(float f) {
 	readCount_.push_back(f);
 }
+void ChrCopyNumber::addToReadCounts(const float* values, const int* coordinates, const int* ends, int length) {
+	readCount_.insert(readCount_.end(), values, values+length);
+	coordinates_.insert(coordinates_.end(), coordinates, coordinates+length);
+	if (ends)
+		ends_.insert(ends_.end(), ends, ends+length);
+}
 void ChrCopyNumber::addToCoordinates(int i) {
 	coordinates_.push_back(i);
 }
@@ -394,12 +345,12 @@ void ChrCopyNumber::setChrLength(int chrLength) {
 	chrLength_ = chrLength;
 }
 
-std::vector <float> ChrCopyNumber::getValues() {
+std::vector <float> const& ChrCopyNumber::getValues() const {
 	return readCount_;
 }
 
 
-void ChrCopyNumber::removeLowReadCountWindows(ChrCopyNumber control,const int RCThresh) {
+void ChrCopyNumber::removeLowReadCountWindows(ChrCopyNumber const& control,const int RCThresh) {
     if (length_!=control.getLength()) {
         cerr << "Warning: control length is not equal to the sample length for chromosome " << chromosome_ << "\n";
         cerr << "Sample: " << length_ << " windows; control: "<< control.getLength()<<" windows\n";
@@ -408,7 +359,6 @@ void ChrCopyNumber::removeLowReadCountWindows(ChrCopyNumber control,const int RC
     for (int i = 0; i<length_; i++) {
 		if (control.getValueAt(i) < RCThresh){
 			readCount_[i]=NA;
-			control.setValueAt(i,0);
 		}
     }
 }
@@ -438,7 +388,7 @@ void ChrCopyNumber::fillInRatio(bool islog) {
     }
 }
 
-void ChrCopyNumber::calculateRatioLog(ChrCopyNumber control, const double * a, const int degree){
+void ChrCopyNumber::calculateRatioLog(ChrCopyNumber const& control, const double * a, const int degree){
 	if ((int)ratio_.size()!=length_)
 		ratio_.resize(length_);
 	for (int i = 0; i<length_; i++) {
@@ -459,7 +409,7 @@ void ChrCopyNumber::calculateRatioLog(ChrCopyNumber control, const double * a, c
 	}
 }
 
-void ChrCopyNumber::calculateRatio(ChrCopyNumber control, const double * a, const int degree){
+void ChrCopyNumber::calculateRatio(ChrCopyNumber const& control, const double * a, const int degree){
 	if ((int)ratio_.size()!=length_)
 		ratio_.resize(length_);
 	for (int i = 0; i<length_; i++) {
@@ -482,7 +432,7 @@ void ChrCopyNumber::calculateRatio(ChrCopyNumber control, const double * a, cons
 	}
 }
 
-void ChrCopyNumber::recalculateRatio(ChrCopyNumber control){
+void ChrCopyNumber::recalculateRatio(ChrCopyNumber const& control){
 	for (int i = 0; i<length_; i++) {
 	    float controlRatio = control.getRatioAtBin(i);
 		if ((control.getLength()>i)&&(controlRatio > 0)){
@@ -498,7 +448,7 @@ void ChrCopyNumber::recalculateRatio(ChrCopyNumber control){
 	}
 }
 
-void ChrCopyNumber::calculateRatio(ChrCopyNumber control, double a0, double a1) {
+void ChrCopyNumber::calculateRatio(ChrCopyNumber const& control, double a0, double a1) {
 	if ((int)ratio_.size()!=length_)
 		ratio_.resize(length_);
 	for (int i = 0; i<length_; i++) {
@@ -521,7 +471,7 @@ void ChrCopyNumber::calculateRatio(ChrCopyNumber control, double a0, double a1)
 	}
 }
 
-void ChrCopyNumber::calculateRatio(ChrCopyNumber control, float normalizationConst) {
+void ChrCopyNumber::calculateRatio(ChrCopyNumber const& control, float normalizationConst) {
 	ratio_ = vector<float>(length_,0);
 	for (int i = 0; i<length_; i++) {
 		if ((control.getLength()>i)&&(control.getValueAt(i) != 0))
@@ -703,7 +653,7 @@ int ChrCopyNumber::calculateBAFBreakpoints(double threshold, int normalChrLength
 int ChrCopyNumber::getCoveredPart(int breakPointStart, int breakPointEnd) { //for exome-seq: get length of the genome covered by the targeted region (from breakPointStart to breakPointEnd)
     int lengthCovered = 0;
     for (int i = breakPointStart; i<=breakPointEnd; i++) {
-        lengthCovered+=ends_[i]-coordinates_[i]+1;
+        lengthCovered+=getEndAtBin(i)-getCoordinateAtBin(i)+1;
     }
     return lengthCovered;
 }
@@ -732,13 +682,13 @@ void ChrCopyNumber::calculateCopyNumberMedian(int ploidy, int minCNAlength, bool
 	float estimatedBAF;
 	float fittedBAF;
 	float uncertainty;
-	string medianBAFSym;
+	BAFgenotype medianBAFSym = makeBAFgenotype(0,0);
 	if (BAF_.size()>0) {
         isBAFpresent = true;
         //medianBAFProfile_ = vector <float> (length_,NA);
         estimatedBAFProfile_ = vector <float> (length_,NA);
         fittedBAFProfile_ = vector <float> (length_,NA);
-        medianBAFSymbol_ = vector <std::string> (length_,"-");
+        medianBAFSymbol_ = vector <BAFgenotype> (length_,BAF_GENOTYPE_UNKNOWN);
         estimatedBAFuncertainty_ = vector <float> (length_,NA);
         cout << "..Control: BAF profile is present\n";
 	}
@@ -757,24 +707,21 @@ void ChrCopyNumber::calculateCopyNumberMedian(int ploidy, int minCNAlength, bool
 		vector<float> data;
         //vector<float> dataBAF;
 		int notNA = 0;
-		string BAFValuesInTheSegment = ""; //here we merge all SNP Values of this segment
+		vector<float> BAFValuesInTheSegment; //here we merge all SNP Values of this segment
+		int lastBAFvalue = NA; //overlapping windows share SNPs: each SNP is taken once
 		for (int j = breakPointStart; j <= breakPointEnd; j++)
 		 {
 			if (ratio_[j] != NA) {
 				data.push_back(ratio_[j]);
 				notNA++;
-				if (isBAFpresent && BAF_[j]!=NA && BAFvalues_[j] != ""){
+				if (isBAFpresent && BAF_[j]!=NA){
                     //dataBAF.push_back(BAF_[j]);
-                    if (BAFValuesInTheSegment != ""){
-                        if (BAFvalues_[j].compare(BAFvalues_[j-1])!=0) {
-                            string suffix = findSmallestSuffix(BAFvalues_[j-1],BAFvalues_[j]);
-                            if (suffix != "")
-                                BAFValuesInTheSegment += ";"+suffix;
-                                //BAFValuesInTheSegment += ";"+BAFvalues_[j];
+                    for (int k = BAFvaluesOffsets_[j]; k < BAFvaluesOffsets_[j+1]; k++) {
+                        if (BAFvaluesIndices_[k] > lastBAFvalue) {
+                            lastBAFvalue = BAFvaluesIndices_[k];
+                            BAFValuesInTheSegment.push_back(heterozygousBAFs_[lastBAFvalue]);
                         }
                     }
-                    else
-                        BAFValuesInTheSegment = BAFvalues_[j];
                 }
 			}
          }
@@ -788,9 +735,7 @@ void ChrCopyNumber::calculateCopyNumberMedian(int ploidy, int minCNAlength, bool
                 locMedian=pow(2, locMedian);
         }
         if (isBAFpresent && notNA > 100 && locMedian < 1 && noisyData ) {
-            vector<string>heteroValuesPerWindowStrings = split(BAFValuesInTheSegment, ';');
-            int numberofBAFpoints =heteroValuesPerWindowStrings.size();
-            heteroValuesPerWindowStrings.clear();
+            int numberofBAFpoints =BAFValuesInTheSegment.size();
             double threshold;
             if (step_ != 0) {
                 threshold = 0.0001*step_*notNA;
@@ -815,7 +760,7 @@ void ChrCopyNumber::calculateCopyNumberMedian(int ploidy, int minCNAlength, bool
                     //medianBAF = NA;
                     estimatedBAF = NA;
                     fittedBAF=NA;
-                    medianBAFSym = "-";
+                    medianBAFSym = BAF_GENOTYPE_UNKNOWN;
                     uncertainty = NA;
 				}
 			} else {
@@ -878,7 +823,7 @@ void ChrCopyNumber::calculateCopyNumberMedian(int ploidy, int minCNAlength, bool
 			if (isBAFpresent) {
                 estBAFuncertaintyPerFrag_.push_back(uncertainty);
                 BAFsymbPerFrag_.push_back(medianBAFSym);
-               // cout << "..Control: adding "<<medianBAFSym<< " to a fragment with median*ploidy="<<median*ploidy<< "\n";
+               // cout << "..Control: adding "<<getBAFgenotypeSymbol(medianBAFSym)<< " to a fragment with median*ploidy="<<median*ploidy<< "\n";
 
 			}
 
@@ -1047,7 +992,7 @@ float ChrCopyNumber::getMappabilityProfileAt(int i) {
 	return mappabilityProfile_[i];
 }
 
-std::vector <float>	ChrCopyNumber::getRatio() {
+std::vector <float> const& ChrCopyNumber::getRatio() const {
 	return ratio_;
 }
 bool ChrCopyNumber::isMedianCalculated() {
@@ -1060,6 +1005,7 @@ bool ChrCopyNumber::isSmoothed(){
 void ChrCopyNumber::setIsSmoothed(bool value) {
 	isSmoothed_ = value;
 	smoothedProfile_.clear();
+	smoothedProfile_.reserve(length_); //filled window by window
 }
 //void ChrCopyNumber::printLog2Ratio(std::ofstream const& file) {
 //	/*for (int i = 0; i<length_; i++) {
@@ -1067,7 +1013,7 @@ void ChrCopyNumber::setIsSmoothed(bool value) {
 //	}*/
 //}
 
-int ChrCopyNumber::getLength() {
+int ChrCopyNumber::getLength() const {
 	return length_;
 }
 int ChrCopyNumber::getChrLength() {
@@ -1080,11 +1026,11 @@ int ChrCopyNumber::getMappabilityLength() {
 }
 
 
-std::string ChrCopyNumber::getChromosome() {
+std::string const& ChrCopyNumber::getChromosome() const {
 	return chromosome_;
 }
 
-float ChrCopyNumber::getRatioAtBin(int i) {
+float ChrCopyNumber::getRatioAtBin(int i) const {
 	return ratio_[i];
 }
 
@@ -1092,22 +1038,22 @@ float ChrCopyNumber::getEstimatedBAFuncertaintyAtBin(int i) {
     return estBAFuncertaintyPerFrag_[i];
 }
 
-std::string ChrCopyNumber::getBAFsymbPerFrg (int i)  {
+BAFgenotype ChrCopyNumber::getBAFsymbPerFrg (int i)  {
     return BAFsymbPerFrag_[i];
 }
 
-std::vector <float> ChrCopyNumber::getMedianValues () {
+std::vector <float> const& ChrCopyNumber::getMedianValues () const {
 	return medianValues_;
 }
 
-std::vector <float> ChrCopyNumber::getSDs () {
+std::vector <float> const& ChrCopyNumber::getSDs () const {
 	return sd_;
 }
-std::vector <int> ChrCopyNumber::getFragmentLengths_notNA () {
+std::vector <int> const& ChrCopyNumber::getFragmentLengths_notNA () const {
 	return fragmentNotNA_lengths_;
 }
 
-std::vector <int> ChrCopyNumber::getFragmentLengths () {
+std::vector <int> const& ChrCopyNumber::getFragmentLengths () const {
 	return fragment_lengths_;
 }
 
@@ -1120,7 +1066,7 @@ int ChrCopyNumber::getFragmentLengths_notNA_At(int i) {
 	return fragmentNotNA_lengths_[i];
 }
 
-std::vector <int> ChrCopyNumber::getBreakPoints() {
+std::vector <int> const& ChrCopyNumber::getBreakPoints() const {
 	return bpfinal_;
 }
 
@@ -1267,7 +1213,7 @@ void ChrCopyNumber::deleteFlanks(int telo_centromeric_flanks) {
 int ChrCopyNumber::removeLargeExons(float threshold) {
     int howManyRemoved = 0;
     for (int i =0; i< length_; i++) {
-        if (ends_[i]-coordinates_[i]>threshold) {
+        if (getEndAtBin(i)-getCoordinateAtBin(i)>threshold) {
             howManyRemoved++;
             readCount_[i]=NA;
         }
@@ -1401,12 +1347,14 @@ void ChrCopyNumber::addToMappabilityProfile (float valueToAdd) {
 
 void ChrCopyNumber::addToGenes_name(string i)
 {
-    genes_names.push_back(i);
+    //exons of the same gene follow each other: store each name once per run of windows
+    if (geneNames_.empty() || geneNames_.back() != i)
+        geneNames_.push_back(i);
+    geneNameIndices_.push_back((int)geneNames_.size()-1);
 }
 
 void ChrCopyNumber::createMappabilityProfile() {
-    for (int i=0; i<length_; i++)
-        mappabilityProfile_.push_back(0);
+    mappabilityProfile_.insert(mappabilityProfile_.end(), length_, 0);
 }
 
 void ChrCopyNumber::checkOrCreateNotNprofileWithZeros() {
@@ -1460,7 +1408,7 @@ void ChrCopyNumber::fillCGprofile(std::string const& chrFolder) {
 		text.push_back(letter);
 	}
 
-	if (ends_.size()==0) { //all windows have equal length => can use the same windowsize for all windows
+	if (getEndsSize()==0) { //all windows have equal length => can use the same windowsize for all windows
 		for (int i = 0; i<length_; i++) {
 			if (file.eof()) {
 				GCprofile_[i] = NA;
@@ -1489,8 +1437,8 @@ void ChrCopyNumber::fillCGprofile(std::string const& chrFolder) {
 				GCprofile_[i] = NA;
 				//cout << "End-of-file reached.." << endl;
 			}
-			start = coordinates_[i];
-			end = ends_[i];
+			start = getCoordinateAtBin(i);
+			end = getEndAtBin(i);
 			while((!file.eof()) && (count < start)) {
 				file>>letter;
 				count ++;
@@ -1519,7 +1467,7 @@ void ChrCopyNumber::fillCGprofile(std::string const& chrFolder) {
                 GCprofile_[i] = NA;
 			//reset
 			if (i+1<length_) {
-			    int nextStart = coordinates_[i+1];
+			    int nextStart = getCoordinateAtBin(i+1);
 			    if (nextStart<=end) {
                     //count = end;
                     //and delete prefix in text;
@@ -1564,7 +1512,7 @@ float ChrCopyNumber::getFittedBAFProfileAt (int i){
 	return fittedBAFProfile_[i];
 }
 
-std::string ChrCopyNumber::getBAFsymbolAt (int i) {
+BAFgenotype ChrCopyNumber::getBAFsymbolAt (int i) {
 	return medianBAFSymbol_[i];
 }
 
@@ -1590,18 +1538,20 @@ void ChrCopyNumber::pushSmoothedProfile(float value) {
 }
 
 int ChrCopyNumber::getEndsSize() {
+	if (isFixedGrid_)
+		return step_<windowSize_ ? length_ : 0;
 	return ends_.size();
 }
 
 void ChrCopyNumber::setLookingForSubclones(bool value) {
     isLookingForSubclones_=value;
     if (value) {
-        if (coordinates_.size()==0) {cerr << "Warning: you should intialize the ChrCopyNumber object before calling this function!!!\n";}
+        if (length_==0) {cerr << "Warning: you should intialize the ChrCopyNumber object before calling this function!!!\n";}
         if (copy_number_subc_.size()==0) {
-            copy_number_subc_=vector <int> (coordinates_.size(),0);
+            copy_number_subc_=vector <int> (length_,0);
         }
         if (population_subc_.size()==0) {
-            population_subc_=vector <float> (coordinates_.size(),0.0);
+            population_subc_=vector <float> (length_,0.0);
         }
     }
 }
@@ -1620,22 +1570,18 @@ ChrCopyNumber::~ChrCopyNumber(void)
 }
 
 void ChrCopyNumber::createBAF(float value) {
-    for (int i=0; i<length_; i++)
-        BAF_.push_back(value);
-}
-void ChrCopyNumber::createBAFvalues() {
-    for (int i=0; i<length_; i++)
-        BAFvalues_.push_back("");
+    BAF_.insert(BAF_.end(), length_, value);
 }
 
 void ChrCopyNumber::addBAFinfo(SNPinGenome & snpingenome,int indexSNP) {
 
-    SNPatChr SNPsatChr = snpingenome.SNP_atChr(indexSNP);
+    SNPatChr& SNPsatChr = snpingenome.SNP_atChr(indexSNP);
 
     //create a vector with BAF
     createBAF(NA);
-    createBAFvalues();
-//BAFvalues_
+    heterozygousBAFs_.clear();
+    vector <pair<int,int> > heterozygousSNPsInWindows; //(window, index in heterozygousBAFs_), in the order they are found
+    int lastHeterozygousSNP = NA;
     int totalSNPnumber = SNPsatChr.getSize() ;
     cout << "..Total Number of SNPs: "<< totalSNPnumber <<"\n";
     int SNPcount = 0;
@@ -1646,18 +1592,18 @@ void ChrCopyNumber::addBAFinfo(SNPinGenome & snpingenome,int indexSNP) {
 
 
     for (int i = 0; i<length_; i++) {
-        int left = coordinates_[i];
+        int left = getCoordinateAtBin(i);
         int right = getEndAtBin(i);
         if (getSNPpos>=left && getSNPpos <=right) {
           //  snpingenome.SNP_atChr(indexSNP).setBinAt(SNPcount,i);
             snpingenome.setBinAt(indexSNP,SNPcount,i);
 
             if (currentBAFstatus !=0 && currentBAF != NA) { //there are values that indicate that this SNP can be heterozygios
-                if (BAFvalues_[i] != "")
-                    BAFvalues_[i] += ";";
-                stringstream ss (stringstream::in | stringstream::out);
-                ss << currentBAF;
-                BAFvalues_[i] += ss.str();
+                if (lastHeterozygousSNP != SNPcount) {
+                    heterozygousBAFs_.push_back(currentBAF);
+                    lastHeterozygousSNP = SNPcount;
+                }
+                heterozygousSNPsInWindows.push_back(make_pair(i, (int)heterozygousBAFs_.size()-1));
             }
             minBAF = BAF_[i];
             if (minBAF==NA) {
@@ -1689,6 +1635,18 @@ void ChrCopyNumber::addBAFinfo(SNPinGenome & snpingenome,int indexSNP) {
             }
         }
     }
+    //group the SNPs by window; windows are visited again after each SNP, so the SNPs of a window stay sorted
+    BAFvaluesOffsets_.assign(length_+1, 0);
+    for (int k = 0; k < (int)heterozygousSNPsInWindows.size(); k++)
+        BAFvaluesOffsets_[heterozygousSNPsInWindows[k].first+1]++;
+    for (int i = 0; i<length_; i++)
+        BAFvaluesOffsets_[i+1] += BAFvaluesOffsets_[i];
+    BAFvaluesIndices_.resize(heterozygousSNPsInWindows.size());
+    vector <int> nextIndex (BAFvaluesOffsets_.begin(), BAFvaluesOffsets_.end()-1);
+    for (int k = 0; k < (int)heterozygousSNPsInWindows.size(); k++)
+        BAFvaluesIndices_[nextIndex[heterozygousSNPsInWindows[k].first]++] = heterozygousSNPsInWindows[k].second;
+    vector <pair<int,int> >().swap(heterozygousSNPsInWindows);
+
     if (ratio_.size()==0) {
         cerr << "Warning: Normalized read counts (ratio_) has not been initialized; check your parameters\n";
     }
@@ -1700,17 +1658,11 @@ void ChrCopyNumber::addBAFinfo(SNPinGenome & snpingenome,int indexSNP) {
             BAF_[i]=NA;
 
         if (BAF_[i]!=NA && BAF_[i]!=0 && BAF_[i]!=1) {
-            //recalculate if using BAFvalues_[i]
-            vector<string>heteroValuesPerWindowStrings = split(BAFvalues_[i], ';');
-            if (heteroValuesPerWindowStrings.size()>0) {
+            //recalculate using the heterozygous SNPs of the window
+            if (BAFvaluesOffsets_[i+1] > BAFvaluesOffsets_[i]) {
                 vector<float>heteroValuesPerWindow;
-                for (int unsigned j = 0; j < heteroValuesPerWindowStrings.size(); j++) {
-                    stringstream ss;
-                    float f;
-                    ss << heteroValuesPerWindowStrings[j];
-                    ss >> f;
-                    heteroValuesPerWindow.push_back(fabs(f-0.5));
-                }
+                for (int j = BAFvaluesOffsets_[i]; j < BAFvaluesOffsets_[i+1]; j++)
+                    heteroValuesPerWindow.push_back(fabs(heterozygousBAFs_[BAFvaluesIndices_[j]]-0.5));
                 float median = get_median(heteroValuesPerWindow)+0.5;
                 BAF_[i] = median;
             } else {
@@ -1733,9 +1685,9 @@ float ChrCopyNumber::getLevelAt(int unsigned i, int ploidy) {
         valueToReturn = float(int(value*ploidy))/ploidy;
 
     //use BAF for ambigious cases:
-    if (valueToReturn>0 && estBAFuncertaintyPerFrag_.size()>i && BAFsymbPerFrag_[i].compare("-")!=0 &&BAFsymbPerFrag_[i]!="" && BAFsymbPerFrag_[i].length()!=valueToReturn*ploidy && (estBAFuncertaintyPerFrag_[i] < MAXUncertainty)) {
+    if (valueToReturn>0 && estBAFuncertaintyPerFrag_.size()>i && hasBAFgenotypeAlleles(BAFsymbPerFrag_[i]) && getBAFgenotypeCopyNumber(BAFsymbPerFrag_[i])!=valueToReturn*ploidy && (estBAFuncertaintyPerFrag_[i] < MAXUncertainty)) {
         //change Level value if there is no incertainty:
-        valueToReturn=BAFsymbPerFrag_[i].length()*1./ploidy;
+        valueToReturn=getBAFgenotypeCopyNumber(BAFsymbPerFrag_[i])*1./ploidy;
     }
 
     return valueToReturn;
@@ -1754,6 +1706,56 @@ void ChrCopyNumber::setRCountToZeroForNNNN() {
     }
 }
 
+template <typename T> static void releaseUnusedCapacity(std::vector<T>& profile) {
+	if (profile.capacity() > profile.size())
+		std::vector<T>(profile).swap(profile); //the copy is allocated with the size of the profile
+}
+
+void ChrCopyNumber::shrinkToFit() {
+	releaseUnusedCapacity(readCount_);
+	releaseUnusedCapacity(coordinates_);
+	releaseUnusedCapacity(ends_);
+	releaseUnusedCapacity(GCprofile_);
+	releaseUnusedCapacity(notNprofile_);
+	releaseUnusedCapacity(mappabilityProfile_);
+	releaseUnusedCapacity(geneNames_);
+	releaseUnusedCapacity(geneNameIndices_);
+}
+
+template <typename T> static double getMemoryUsage(std::vector<T> const& profile) {
+	return double(profile.capacity())*sizeof(T);
+}
+
+static double getMemoryUsage(std::vector<std::string> const& profile) {
+	//strings longer than the small string buffer have their characters on the heap
+	double bytes = double(profile.capacity())*sizeof(std::string);
+	for (int i = 0; i < (int)profile.size(); i++) {
+		if (profile[i].capacity() >= sizeof(std::string)/2)
+			bytes += profile[i].capacity()+1;
+	}
+	return bytes;
+}
+
+void ChrCopyNumber::addMemoryUsage(std::map<std::string, double>& bytesPerProfile) {
+	bytesPerProfile["coordinates"] += getMemoryUsage(coordinates_);
+	bytesPerProfile["ends"] += getMemoryUsage(ends_) + getMemoryUsage(maxEnds_);
+	bytesPerProfile["readCount"] += getMemoryUsage(readCount_) + getMemoryUsage(readCountChanges_);
+	bytesPerProfile["ratio"] += getMemoryUsage(ratio_);
+	bytesPerProfile["GCprofile"] += getMemoryUsage(GCprofile_);
+	bytesPerProfile["notNprofile"] += getMemoryUsage(notNprofile_);
+	bytesPerProfile["mappabilityProfile"] += getMemoryUsage(mappabilityProfile_);
+	bytesPerProfile["medianProfile"] += getMemoryUsage(medianProfile_);
+	bytesPerProfile["smoothedProfile"] += getMemoryUsage(smoothedProfile_);
+	bytesPerProfile["BAF"] += getMemoryUsage(BAF_) + getMemoryUsage(medianBAFProfile_);
+	bytesPerProfile["BAFvalues"] += getMemoryUsage(heterozygousBAFs_) + getMemoryUsage(BAFvaluesOffsets_) + getMemoryUsage(BAFvaluesIndices_);
+	bytesPerProfile["estimatedBAFProfile"] += getMemoryUsage(estimatedBAFProfile_) + getMemoryUsage(fittedBAFProfile_) + getMemoryUsage(estimatedBAFuncertainty_);
+	bytesPerProfile["medianBAFSymbol"] += getMemoryUsage(medianBAFSymbol_);
+	bytesPerProfile["genes_names"] += getMemoryUsage(geneNames_) + getMemoryUsage(geneNameIndices_);
+	bytesPerProfile["subclones"] += getMemoryUsage(copy_number_subc_) + getMemoryUsage(population_subc_);
+	bytesPerProfile["segments"] += getMemoryUsage(bpfinal_) + getMemoryUsage(fragmentNotNA_lengths_) + getMemoryUsage(fragment_lengths_)
+		+ getMemoryUsage(medianValues_) + getMemoryUsage(sd_) + getMemoryUsage(BAFsymbPerFrag_) + getMemoryUsage(estBAFuncertaintyPerFrag_);
+}
+
 void* ChrCopyNumber_calculateBreakpoint_wrapper(void *arg)
 {
   ChrCopyNumberCalculateBreakpointArgWrapper* warg = (ChrCopyNumberCalculateBreakpointArgWrapper*)arg;
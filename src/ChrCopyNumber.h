@@ -7,6 +7,7 @@
 
 #include <vector>
 #include <map>
+#include <algorithm>
 #include <string>
 #include <stdlib.h>
 #include <iostream>
@@ -24,18 +25,22 @@ public:
 	ChrCopyNumber(int windowSize, int chrLength, std::string const& chrName, int step, std::string targetBed = "");
 	~ChrCopyNumber(void);
 	void mappedPlusOneAtI(int i, int step, int l = -1);
+	void finishReadCounting(); //to be called once all reads are counted: adds the reads counted in overlapping windows to readCount_
+	void setReadCounts(std::vector<unsigned int> const& fineCounts, int resolution); //sums the reads counted in windows of "resolution" bp, a divisor of windowSize_ and step_
+	int findExon(int position, int flank, int& cursor); //WES: first exon such that start-flank < position <= end, NA if none; cursor makes the search faster for sorted positions
+	void mergeWindows(int factor); //merge each "factor" consecutive non-overlapping windows into one
 
 	void addBAFinfo(SNPinGenome & snpingenome,int indexSNP);
 
 	void fillInRatio(bool islog);
-	void calculateRatio(ChrCopyNumber control, float normalizationConst) ;
+	void calculateRatio(ChrCopyNumber const& control, float normalizationConst) ;
 	void recalculateRatio (float constant);
 	void recalculateLogRatio (float constant) ;
 	void recalculateRatioWithContam(float contamination, float normGenytype, bool isLogged);
-    void recalculateRatio(ChrCopyNumber control);
-	void calculateRatio(ChrCopyNumber control, double a0, double a1);
-	void calculateRatio(ChrCopyNumber control, const double * a, const int degree);
-	void calculateRatioLog(ChrCopyNumber control, const double * a, const int degree);
+    void recalculateRatio(ChrCopyNumber const& control);
+	void calculateRatio(ChrCopyNumber const& control, double a0, double a1);
+	void calculateRatio(ChrCopyNumber const& control, const double * a, const int degree);
+	void calculateRatioLog(ChrCopyNumber const& control, const double * a, const int degree);
 	int calculateBreakpoints(double breakPointThreshold, int firstChrLength, int breakPointType);
     int calculateBAFBreakpoints(double breakPointThreshold, int firstChrLength, int breakPointType);
 	double calculateXiSum(int ploidy, std::map <float,float> &sds, std::map <float,float> &meds);
@@ -49,7 +54,7 @@ public:
 	void calculateRatio(double *a, int degree);
     void recalculateRatio(double *a, int degree);
 
-    void removeLowReadCountWindows(ChrCopyNumber control, const int RCThresh);
+    void removeLowReadCountWindows(ChrCopyNumber const& control, const int RCThresh);
     void removeLowReadCountWindows(const int RCThresh) ;
 
 	void deleteFlanks(int telo_centromeric_flanks);
@@ -57,38 +62,38 @@ public:
     int removeLargeExons(float threshold);
 
     std::string getGeneNameAtBin(int i);
-	float		getValueAt(int i);
+	float		getValueAt(int i) const;
 	int			getCoordinateAtBin(int i);
 	int			getEndAtBin(int i);
 	//void printLog2Ratio(std::ofstream const& file) ;
-	float		getRatioAtBin(int i);
-	std::vector <float>	getRatio();
-	int			getLength();
+	float		getRatioAtBin(int i) const;
+	std::vector <float> const& getRatio() const;
+	int			getLength() const;
     int         getChrLength();
-	std::string getChromosome();
+	std::string const& getChromosome() const;
 	int getCoveredPart(int breakPointStart, int breakPointEnd);//for exome-seq: get length of the genome covered by the targeted region (from breakPointStart to breakPointEnd)
-	std::vector <float> getValues(); //get readCount_
+	std::vector <float> const& getValues() const; //get readCount_
 	float		getMedianProfileAtI (int i) ;
-	std::vector <float> getMedianValues () ;
+	std::vector <float> const& getMedianValues () const;
 	float getMedianValuesAt (int i) ;
-	std::vector <float> getSDs ();//unUsed
-	std::vector <int> getFragmentLengths_notNA ();
-	std::vector <int> getFragmentLengths ();
+	std::vector <float> const& getSDs () const;//unUsed
+	std::vector <int> const& getFragmentLengths_notNA () const;
+	std::vector <int> const& getFragmentLengths () const;
 	int getFragmentLengthsAt(int i);
     int getFragmentLengths_notNA_At (int i);
 	int			getNumberOfFragments();
 	int			getNumberOfGoodFragments();
 	double		getXiSum(int ploidy, float minSD); //OLD unUsed
-	std::vector <int> getBreakPoints();
+	std::vector <int> const& getBreakPoints() const;
 	float getCGprofileAt(int i);
 	float getMappabilityProfileAt(int i);
 	float getNotNprofileAt(int i);
 	float getSmoothedProfileAtI(int i);
 	float getBAFat (int i);
 	float getBAFProfileAt (int i);
-	std::string getBAFsymbolAt (int i);
+	BAFgenotype getBAFsymbolAt (int i);
 	float getEstimatedBAFuncertaintyAtI(int i) ;
-	std::string getBAFsymbPerFrg (int i) ;
+	BAFgenotype getBAFsymbPerFrg (int i) ;
     float getEstimatedBAFuncertaintyAtBin(int i);
     float getFittedBAFProfileAt (int i);
 
@@ -108,6 +113,7 @@ public:
 	int nextNoNAIndex(int i1, int ploidy, int min_fragment);
 
 	void addToReadCount(float);
+	void addToReadCounts(const float* values, const int* coordinates, const int* ends, int length); //same as the functions above for length windows; ends may be NULL
 	void addToCoordinates(int);
 	void addToEnds(int i);
 	void addToCGcontent (float valueToAdd);
@@ -136,7 +142,6 @@ public:
 
     void createMappabilityProfile();
     void createBAF(float);
-    void createBAFvalues();
     void checkOrCreateNotNprofileWithZeros();
 
 	void pushSmoothedProfile(float value);
@@ -153,12 +158,17 @@ public:
     void setLookingForSubclones(bool);
     float getSmoothedForInterval(int start , int end);
 
+	void shrinkToFit(); //releases the unused capacity of the profiles filled value by value
+	void addMemoryUsage(std::map<std::string, double>& bytesPerProfile); //adds the memory of each profile, in bytes
+
 private:
    // std::vector <std::string> coordinatesTmp_;
 //	std::vector <std::string> endsTmp_;
 //	std::vector <std::string> chr_namestmp;
  //   std::vector <std::string> chr_names;
-	std::vector <std::string> genes_names;
+	std::vector <std::string> const* targetNames_; //names of the targets, shared with CaptureRegions; NULL if the names are read with the profile
+	std::vector <std::string> geneNames_; //distinct gene names, a new entry each time the name of the next window changes
+	std::vector <int> geneNameIndices_; //index in geneNames_ for each window
   //  int exons_Count;
 	int exons_Countchr_;
 	std::vector <int> copy_number_subc_;
@@ -176,9 +186,12 @@ private:
 	bool isMedianCalculated_;
 	bool isSmoothed_; //medianProfileHasBeenSmoothed
 	std::string chromosome_;
+	bool isFixedGrid_; //WGS: window i is [i*step_, i*step_+windowSize_-1] and coordinates_, ends_ are empty; otherwise (targeted regions, profiles read from a file) the windows are stored in coordinates_ and ends_
 	std::vector <int> coordinates_;
-	std::vector <int> ends_;
+	std::vector <int> ends_; //empty if every window is windowSize_ long
+	std::vector <int> maxEnds_; //WES with targets sorted by start: maxEnds_[l] is the largest end of exons 0..l
 	std::vector <float> readCount_;
+	std::vector <int> readCountChanges_; //overlapping windows (step < windowSize): +1 at the first window of a read, -1 after its last window
 	std::vector <float> ratio_;
 	std::vector <int> bpfinal_;
 	std::vector <int> fragmentNotNA_lengths_;
@@ -192,16 +205,106 @@ private:
 	std::vector <float> smoothedProfile_;
     std::vector <float> BAF_; //median value of abs(BAF-0.5) in a window (only for heterozygous SNPs)
     std::vector <float> medianBAFProfile_; //median values of BAF_ for each segment)
-    std::vector <std::string> BAFvalues_; // values of abs(BAF-0.5) in a window
+    std::vector <float> heterozygousBAFs_; //BAF of the heterozygous SNPs of the chromosome, in the order of the SNPs
+    std::vector <int> BAFvaluesOffsets_; //length_+1: the heterozygous SNPs of window i are BAFvaluesIndices_[BAFvaluesOffsets_[i]..BAFvaluesOffsets_[i+1]-1]
+    std::vector <int> BAFvaluesIndices_; //indices in heterozygousBAFs_, increasing in each window
     std::vector <float> estimatedBAFProfile_; //estimation of BAF for each segment (value per window)
     std::vector <float> fittedBAFProfile_;
-    std::vector <std::string> medianBAFSymbol_; //estimation of BAF for each segment: AA,AAB;AB,AABB etc
+    std::vector <BAFgenotype> medianBAFSymbol_; //estimation of BAF for each segment: AA,AAB;AB,AABB etc (value per window)
     std::vector <float> estimatedBAFuncertainty_;//uncertainty of estimation of BAF for each segment (1./(LL_best-LL_secondBest)))
-    std::vector <std::string> BAFsymbPerFrag_; //estimation of BAF for each segment: AA,AAB;AB,AABB etc - one value per fragment
+    std::vector <BAFgenotype> BAFsymbPerFrag_; //estimation of BAF for each segment: AA,AAB;AB,AABB etc - one value per fragment
     std::vector <float> estBAFuncertaintyPerFrag_;//uncertainty of estimation of BAF for each segment (1./(LL_best-LL_secondBest))) - one value per fragment
 
 
 };
+
+//called for every read: defined here so that the read counting loops can inline it
+inline void ChrCopyNumber::mappedPlusOneAtI(int i, int step, int l) {
+  if (l == -1)  {
+    int pos = i/step;
+    if ((int)readCount_.size()<=pos || i > chrLength_) {
+		//should not normally happen unless we are at the very end of file
+		//reads starting after the end of the chromosome are never counted: the last window would count them or not depending on its size
+		std::cout << "Reaching end of file for chr "<<chromosome_ <<", position " << i <<"\n";
+		//readCount_.resize(pos+1);
+		//length_ = pos+1;
+	} else {
+		if (windowSize_ <= step) {
+			readCount_[pos]++;
+		} else {
+			//the read is in windows first..pos: the first window ending after i, the last one starting before it
+			int first = 0;
+			if (i >= windowSize_)
+				first = std::min((i-windowSize_)/step+1, pos);
+			if (readCountChanges_.empty())
+				readCountChanges_.resize(readCount_.size()+1, 0);
+			readCountChanges_[first]++;
+			readCountChanges_[pos+1]--;
+		}
+	}
+  }  else  {
+    int pos = l;
+    if ((int)readCount_.size()<=pos)   {
+        //should not normally happen unless we are at the very end of file
+        std::cout << "Reaching end of file for chr "<<chromosome_ <<", position " << i <<"\n";
+        //readCount_.resize(pos+1);
+        //length_ = pos+1;
+    }    else    {
+        readCount_[pos]++;
+        //while (step*(pos-1)+windowSize_>i && pos>=1)
+          //{
+          //readCount_[--pos]++;
+          //}
+    }
+  }
+}
+
+//window layout: computed for WGS windows, loaded for targeted regions and profiles read from a file
+inline int ChrCopyNumber::getCoordinateAtBin(int i) {
+  if (isFixedGrid_)
+    return i*step_;
+  return coordinates_[i];
+}
+
+inline int ChrCopyNumber::getEndAtBin(int i) {
+  if (isFixedGrid_)
+    return i*step_+windowSize_-1;
+  if ((int)ends_.size()>i)
+    return ends_[i];
+  return coordinates_[i]+windowSize_-1;
+}
+
+//called for every read in WES mode
+inline int ChrCopyNumber::findExon(int position, int flank, int& cursor) {
+  int count = (int)maxEnds_.size();
+  if (count != exons_Countchr_) {
+    //targets are not sorted: scan all of them
+    for (int l = 0; l < exons_Countchr_; l++) {
+      if (position - 1 < getEndAtBin(l) && position > coordinates_[l] - flank)
+        return l;
+    }
+    return NA;
+  }
+  //the first exon ending at or after position is the first l such that maxEnds_[l] >= position;
+  //exons after it start later, so it is also the only candidate for the left bound
+  int l = cursor;
+  if (l < 0 || l > count || (l > 0 && maxEnds_[l-1] >= position)) {
+    l = int(std::lower_bound(maxEnds_.begin(), maxEnds_.end(), position) - maxEnds_.begin());
+  } else {
+    //sorted positions: the exon is the one of the previous read or one of the next ones
+    for (int steps = 0; l < count && maxEnds_[l] < position; steps++, l++) {
+      if (steps == 8) {
+        l = int(std::lower_bound(maxEnds_.begin() + l, maxEnds_.end(), position) - maxEnds_.begin());
+        break;
+      }
+    }
+  }
+  cursor = l;
+  if (l < count && position > coordinates_[l] - flank)
+    return l;
+  return NA;
+}
+
 #endif
 
 //
@@ -0,0 +1,128 @@
+/*************************************************************************
+Copyright (c) 2010-2016, Valentina BOEVA.
+
+>>> SOURCE LICENSE >>>
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation (www.fsf.org); either version 2 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+A copy of the GNU General Public License is available at
+http://www.fsf.org/licensing/licenses
+
+>>> END OF LICENSE >>>
+*************************************************************************/
+
+#include "ContigDictionary.h"
+#include "myFunc.h"
+
+#include <string.h>
+
+using namespace std;
+
+#define CONTIG_DICTIONARY_INITIAL_SIZE 64
+
+ContigDictionary::ContigDictionary()
+{
+    clear();
+}
+
+void ContigDictionary::clear()
+{
+    names_.assign(CONTIG_DICTIONARY_INITIAL_SIZE, Entry());
+    numberOfNames_ = 0;
+    spellings_.assign(CONTIG_DICTIONARY_INITIAL_SIZE, Entry());
+    numberOfSpellings_ = 0;
+    lastSpelling_ = -1;
+}
+
+unsigned int ContigDictionary::hash(const char* key, int length)
+{
+    //FNV-1a
+    unsigned int h = 2166136261u;
+    for (int i = 0; i < length; i++) {
+        h = (h ^ (unsigned char)key[i]) * 16777619u;
+    }
+    return h;
+}
+
+int ContigDictionary::lookup(Table const& table, const char* key, int length, unsigned int h)
+{
+    //tables are never more than half full: there is always a free slot
+    int mask = (int)table.size() - 1;
+    int slot = (int)(h & (unsigned int)mask);
+    while (table[slot].used) {
+        Entry const& entry = table[slot];
+        if (entry.hash == h && (int)entry.key.size() == length && memcmp(entry.key.data(), key, length) == 0) {
+            return slot;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+void ContigDictionary::insert(Table& table, int& count, std::string const& key, unsigned int h, int id)
+{
+    if (2 * (count + 1) > (int)table.size()) {
+        Table larger(2 * table.size());
+        for (size_t i = 0; i < table.size(); i++) {
+            if (table[i].used) {
+                larger[lookup(larger, table[i].key.data(), (int)table[i].key.size(), table[i].hash)] = table[i];
+            }
+        }
+        table.swap(larger);
+    }
+    Entry& entry = table[lookup(table, key.data(), (int)key.size(), h)];
+    entry.key = key;
+    entry.hash = h;
+    entry.id = id;
+    entry.used = true;
+    count++;
+}
+
+void ContigDictionary::add(std::string const& name, int id)
+{
+    unsigned int h = hash(name.data(), (int)name.size());
+    if (names_[lookup(names_, name.data(), (int)name.size(), h)].used) {
+        return;
+    }
+    insert(names_, numberOfNames_, name, h, id);
+    //spellings seen before may refer to this name
+    if (numberOfSpellings_ > 0) {
+        spellings_.assign(CONTIG_DICTIONARY_INITIAL_SIZE, Entry());
+        numberOfSpellings_ = 0;
+        lastSpelling_ = -1;
+    }
+}
+
+int ContigDictionary::find(std::string const& name) const
+{
+    int slot = lookup(names_, name.data(), (int)name.size(), hash(name.data(), (int)name.size()));
+    return names_[slot].used ? names_[slot].id : NA;
+}
+
+int ContigDictionary::findSpelling(const char* spelling, int length)
+{
+    if (lastSpelling_ >= 0) {
+        Entry const& entry = spellings_[lastSpelling_];
+        if ((int)entry.key.size() == length && memcmp(entry.key.data(), spelling, length) == 0) {
+            return entry.id;
+        }
+    }
+    unsigned int h = hash(spelling, length);
+    int slot = lookup(spellings_, spelling, length, h);
+    if (!spellings_[slot].used) {
+        string key(spelling, length);
+        string name = key;
+        processChrName(name);
+        insert(spellings_, numberOfSpellings_, key, h, find(name));
+        slot = lookup(spellings_, spelling, length, h);
+    }
+    lastSpelling_ = slot;
+    return spellings_[slot].id;
+}
@@ -0,0 +1,46 @@
+#ifndef CONTIGDICTIONARY_H
+#define CONTIGDICTIONARY_H
+
+#include <string>
+#include <vector>
+
+// Dense integer IDs of chromosome names, in hash tables (open addressing) instead of std::map.
+// Names are added as given by processChrName() ("1", "X"), usually from the chrLenFile.
+// findSpelling() looks a name up as it is written in an input (SAM, pileup or VCF line: "chr1"):
+// processChrName() is applied the first time a spelling is met only, the spelling then maps
+// straight to its ID. The last spelling found is checked first, as inputs come by chromosome.
+
+class ContigDictionary
+{
+    public:
+        ContigDictionary();
+
+        void clear();
+        void add(std::string const& name, int id); //a name keeps its first ID
+        int find(std::string const& name) const; //NA if the name is unknown
+        int findSpelling(const char* spelling, int length); //NA if the name is unknown
+        int getNumberOfNames() const {return numberOfNames_;}
+
+    protected:
+    private:
+        struct Entry {
+            std::string key;
+            unsigned int hash;
+            int id;
+            bool used;
+            Entry() : hash(0), id(0), used(false) { }
+        };
+        typedef std::vector<Entry> Table;
+
+        static unsigned int hash(const char* key, int length);
+        static int lookup(Table const& table, const char* key, int length, unsigned int h); //slot of key, or the free slot where it would go
+        static void insert(Table& table, int& count, std::string const& key, unsigned int h, int id);
+
+        Table names_;
+        int numberOfNames_;
+        Table spellings_;
+        int numberOfSpellings_;
+        int lastSpelling_; //slot in spellings_, -1 if none
+};
+
+#endif // CONTIGDICTIONARY_H
@@ -31,12 +31,12 @@ EntryCNV::EntryCNV(string chr, int start, int end, int startCoord, int endCoord,
 	endCoord_ = endCoord;
 	copyNumber_ = copyNumber;
 	estimatedBAFuncertainty_ = NA;
-	medianBAFSymbol_ = "";
+	medianBAFSymbol_ = makeBAFgenotype(0,0);
 	type_="";
 	isBAFassessed_=0;
 }
 
-EntryCNV::EntryCNV(string chr, int start, int end, int startCoord, int endCoord, int copyNumber,float estimatedBAFuncertainty, std::string medianBAFSymbol, bool hasBAF) {
+EntryCNV::EntryCNV(string chr, int start, int end, int startCoord, int endCoord, int copyNumber,float estimatedBAFuncertainty, BAFgenotype medianBAFSymbol, bool hasBAF) {
 	chr_ = chr;
 	start_ = start;
 	end_ = end;
@@ -48,7 +48,7 @@ EntryCNV::EntryCNV(string chr, int start, int end, int startCoord, int endCoord,
 	type_="";
 	if (hasBAF && copyNumber==0) {
         estimatedBAFuncertainty_=-1;
-        medianBAFSymbol_="-";
+        medianBAFSymbol_=BAF_GENOTYPE_UNKNOWN;
 	}
     isBAFassessed_=1;
 }
@@ -66,7 +66,7 @@ std::string EntryCNV::printEntryCNV(float ploidy){
         ss << "neutral";
 
     if (isBAFassessed_!=0)
-             ss << "\t"<< medianBAFSymbol_<< "\t"<< estimatedBAFuncertainty_;
+             ss << "\t"<< getBAFgenotypeSymbol(medianBAFSymbol_)<< "\t"<< estimatedBAFuncertainty_;
 
     if (type_ != "" && type_.compare("normal")!=0)
             ss << "\t"<< type_<< "\t"<< germlinePercent_;
@@ -15,7 +15,7 @@ class EntryCNV
 {
 public:
 	EntryCNV(std::string chr, int start, int end, int startCoord, int endCoord, int copyNumber);
-    EntryCNV(std::string chr, int start, int end, int startCoord, int endCoord, int copyNumber, float estimatedBAFuncertainty, std::string medianBAFSymbol, bool hasBAF);
+    EntryCNV(std::string chr, int start, int end, int startCoord, int endCoord, int copyNumber, float estimatedBAFuncertainty, BAFgenotype medianBAFSymbol, bool hasBAF);
 
 	~EntryCNV(void);
 	std::string getChr();
@@ -38,7 +38,7 @@ private:
 	int endCoord_;
 	int copyNumber_;
 	float estimatedBAFuncertainty_;
-	std::string medianBAFSymbol_;
+	BAFgenotype medianBAFSymbol_;
 	std::string type_; //somatic or germline
 	float germlinePercent_; //percent of germline CNA or LOH
 	bool isBAFassessed_;
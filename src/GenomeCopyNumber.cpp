@@ -20,6 +20,8 @@ http://www.fsf.org/licensing/licenses
 
 
 #include "GenomeCopyNumber.h"
+#include "BAFpileup.h"
+#include "CaptureRegions.h"
 
 using namespace std ;
 
@@ -35,6 +37,14 @@ GenomeCopyNumber::GenomeCopyNumber(void)
 	isMappUsed_=false;
     totalNumberOfPairs_=0;
 	normalNumberOfPairs_=0;
+	alleleCountingPileup_=NULL;
+	alleleCountingSNPs_=NULL;
+	minimalTotalLetterCountPerPosition_=0;
+	minimalQualityPerPosition_=0;
+	readCountCache_=false;
+	maxFragmentLength_=0;
+	isCopyNumberPrintedAsText_=true;
+	isCopyNumberPrintedAsBinary_=false;
 }
 
 bool GenomeCopyNumber::isMappUsed() {return isMappUsed_;}
@@ -42,7 +52,7 @@ bool GenomeCopyNumber::isMappUsed() {return isMappUsed_;}
 void GenomeCopyNumber::readCopyNumber(std::string const& mateFileName ,std::string const& inputFormat, std::string const& matesOrientation, std::string const& chrLenFileName, float coefficientOfVariation ) {
 	//first get the number of reads and the genome size
 	//long genomeSize = 0;
-	long readNumber = 0;
+	long readNumber = NA;
 	int windowSize;
 	//reading the file with genome information
 	std::vector<std::string> names;
@@ -52,8 +62,39 @@ void GenomeCopyNumber::readCopyNumber(std::string const& mateFileName ,std::stri
 	cout << "\t total genome size:\t" << refGenomeSize_ << "\n";
 	if ((inputFormat.compare("pileup")==0 || inputFormat.compare("SAMtools pileup")==0)) {
         	readNumber = getReadNumberFromPileup(mateFileName);
-	} else {
-	        readNumber = getLineNumber(mateFileName, pathToSamtools_, pathToSambamba_, SambambaThreads_);
+	} else if (BamReader::isBAM(mateFileName)) {
+	        readNumber = getReadNumberFromBamIndex(mateFileName);
+	}
+	if (readNumber == NA && !LineReader::isStream(mateFileName)) {
+		//no read statistics: count the records first, so that the reads are assigned once to windows of the evaluated size
+		readNumber = getLineNumber(mateFileName, pathToSamtools_, pathToSambamba_, SambambaThreads_);
+	}
+	if (readNumber == NA) {
+		//a stream cannot be read twice: count reads in fine windows and merge them once the window size is evaluated
+		cout << "\t read number is unknown: will count reads in windows of " << FINE_WINDOW_SIZE << "bp first\n";
+		for (int i = 0; i < (int) names.size(); i++) {
+			ChrCopyNumber chrCopyNumber(FINE_WINDOW_SIZE, lengths[i],names[i]);
+			chromosomesInd_.insert(pair<string, int> (names[i],i));
+			chrCopyNumber_.push_back(chrCopyNumber);
+		}
+		readNumber = GenomeCopyNumber::fillMyHash(mateFileName ,inputFormat, matesOrientation, FINE_WINDOW_SIZE, FINE_WINDOW_SIZE);
+		cout << "\t read number:\t" << readNumber << "\n";
+		cout << "\t coefficientOfVariation:\t" << coefficientOfVariation << "\n";
+		windowSize = round_f(float(1./(coefficientOfVariation*coefficientOfVariation)/readNumber*refGenomeSize_));
+		cout << "\t evaluated window size:\t" << windowSize << "\n";
+		int factor = max(1, round_f(float(windowSize)/FINE_WINDOW_SIZE));
+		if (factor*FINE_WINDOW_SIZE != windowSize) {
+			windowSize = factor*FINE_WINDOW_SIZE;
+			cout << "..Warning: " << mateFileName << " cannot be read again: the window size is rounded to " << windowSize << "bp\n";
+			cout << "..Set \"window\" instead of \"coefficientOfVariation\" to use another window size\n";
+		}
+		vector<ChrCopyNumber>::iterator it;
+		for ( it=chrCopyNumber_.begin() ; it != chrCopyNumber_.end(); it++ ) {
+			it->mergeWindows(factor);
+		}
+		windowSize_ = windowSize;
+		step_ = windowSize;
+		return;
 	}
 	cout << "\t read number:\t" << readNumber << "\n";
 	cout << "\t coefficientOfVariation:\t" << coefficientOfVariation << "\n";
@@ -71,6 +112,11 @@ void GenomeCopyNumber::readCopyNumber(std::string const& mateFileName ,std::stri
 
 }
 
+void GenomeCopyNumber::setReadFilter(int minMappingQuality, int excludedFlags) {
+	readFilter_.minMappingQuality = minMappingQuality;
+	readFilter_.excludedFlags = excludedFlags;
+}
+
 long GenomeCopyNumber::getNormalNumberOfPairs(void) {
 	return normalNumberOfPairs_;
 }
@@ -207,10 +253,14 @@ void GenomeCopyNumber::initCopyNumber(std::string const& chrLenFileName, int win
 		chrCopyNumber_.push_back(chrCopyNumber);
     }
    }
+   indexChromosomeNames();
    ThreadPoolManager::getInstance()->unlock();
 }
 
 void GenomeCopyNumber::finishCopyNumber(long normalCount) {
+	for (vector<ChrCopyNumber>::iterator it = chrCopyNumber_.begin(); it != chrCopyNumber_.end(); it++) {
+		it->finishReadCounting();
+	}
 	totalNumberOfPairs_ = normalCount;
 	normalNumberOfPairs_ = normalCount;
 	cout << normalNumberOfPairs_<< " reads used to compute copy number profile\n";
@@ -267,12 +317,22 @@ void GenomeCopyNumber::calculateBAFBreakpoints(double breakPointThreshold, int b
 #endif
 }
 
-void GenomeCopyNumber::fillMyHash(std::string const& mateFileName ,std::string const& inputFormat_str, std::string const& matesOrientation_str, int windowSize , int step, std::string targetBed) {
+long GenomeCopyNumber::fillMyHash(std::string const& mateFileName ,std::string const& inputFormat_str, std::string const& matesOrientation_str, int windowSize , int step, std::string targetBed) {
 	//read mateFileName and calculate copyNumber
 	long count = 0;
 	long normalCount = 0;
 	int bin = 0;
 
+	//WGS windows made of fine windows: the counts can be taken from the cache of a previous run
+	if (readCountCache_ && !WESanalysis && alleleCountingSNPs_ == NULL && windowSize > 0 && step > 0
+	    && windowSize % READ_COUNT_CACHE_RESOLUTION == 0 && step % READ_COUNT_CACHE_RESOLUTION == 0) {
+		count = fillMyHashWithCountCache(mateFileName, inputFormat_str, matesOrientation_str, windowSize, step);
+		if (count != NA) {
+			return count;
+		}
+		count = 0;
+	}
+
 	cout << "..Starting reading "<< mateFileName << "\n";
 	//if (mateFileName.substr(mateFileName.size()-1,3).compare(".gz")==0) {
 	//	igzstream in( mateFileName );
@@ -282,92 +342,137 @@ void GenomeCopyNumber::fillMyHash(std::string const& mateFileName ,std::string c
 	//	}
 	//	in.close();
 	//}
-	std::ifstream fileMates (mateFileName.c_str());
 	vector<float> insertSizeVector;
 	windowSize_ = windowSize;
 	step_=step;
 	string line;
-	if (!fileMates.is_open()) {
-	    cerr << "Error: unable to open "+mateFileName+"\n" ;
-	    exit(-1);
-	}
+	//the readers below report files that cannot be opened; a stream (mateFile=-, pipe or FIFO) must not be opened twice
+	bool isStream = LineReader::isStream(mateFileName);
 
 #ifdef PROFILE_TRACE
 	time_t t0 = time(NULL);
 #endif
 
 	MateOrientation matesOrientation = getMateOrientation(matesOrientation_str);
+	readFilter_.clearCounts();
+	indexChromosomeNames();
 
 	InputFormat inputFormat;
 	char* line_buffer;
-    if (inputFormat_str.compare("bam")==0 || inputFormat_str.compare("BAM")==0 || mateFileName.substr(mateFileName.size()-4,4).compare(".bam")==0 || mateFileName.substr(mateFileName.size()-3,3).compare(".gz")==0) {
-
-        fileMates.close();
+    bool isGZ = mateFileName.size() > 3 && mateFileName.substr(mateFileName.size()-3,3).compare(".gz")==0;
+    bool isBAMFileName = mateFileName.size() > 4 && mateFileName.substr(mateFileName.size()-4,4).compare(".bam")==0;
+    if ((inputFormat_str.compare("bam")==0 || inputFormat_str.compare("BAM")==0 || isBAMFileName) && !isGZ) {
 
-        FILE *stream;
-        char buffer[MAX_BUFFER];
-        string command;
+        //BAM records are decoded in-process: no need for samtools or sambamba to count reads
+        BamReader bamReader;
+        if (!bamReader.open(mateFileName, true)) {
+            exit(-1);
+        }
+        //map BAM reference IDs to chromosome indices once for all reads
+        vector<int> refIndex;
+        vector<string> refNames;
+        for (int i = 0; i < bamReader.getNumberOfReferences(); i++) {
+            string chr = bamReader.getReferenceName(i);
+            processChrName(chr);
+            refNames.push_back(chr);
+            refIndex.push_back(findIndex(chr));
+        }
 
-        string myInputFormat=inputFormat_str;
-        if (mateFileName.substr(mateFileName.size()-3,3).compare(".gz")!=0) {
-                if (pathToSambamba_ != "")
-                    {
-                    command = pathToSambamba_ + " view -t " + SambambaThreads_ + " " + mateFileName;
-                    myInputFormat="sam";       //will try to use existing sambamba
-                    cout << "..sambamba should be installed to be able to read BAM files; will use the following command for sambamba: "<<pathToSambamba_ + " view -t " + SambambaThreads_ + " " + mateFileName << "\n";
-                    }
-                else
-                    {
-                    command = pathToSamtools_ + " view "+mateFileName;
-                    myInputFormat="sam";       //will try to use existing samtools
-                    cout << "..samtools should be installed to be able to read BAM files; will use the following command for samtools: "<<pathToSamtools_ + " view "+mateFileName<<"\n";
-                    }
+        //SNP allele counts for BAF profiles can be collected from the same records
+        if (alleleCountingSNPs_) {
+            cout << "..will also count alleles at SNP positions while reading "<< mateFileName << "\n";
+            SNPAlleleCounter::clearValues(*alleleCountingSNPs_);
         }
-        else {
-            command = "gzip -cd "+mateFileName;
-		}
 
-		inputFormat = getInputFormat(myInputFormat);
-        stream =
-#if defined(_WIN32)
-		  _popen(command.c_str(), "r");
-#else
-		popen(command.c_str(), "r");
-#endif
+        //with an index, chromosomes are read in parallel, each task filling only its own ChrCopyNumber
+        //for WES, a task only reads the parts of the file around the targets, unless all reads are needed for SNPs
+        //or the fragment length is not bounded (a pair can then be assigned to a target from any distance)
+        BamIndex bamIndex;
+        ThreadPoolManager* thrPoolManager = ThreadPoolManager::getInstance();
+        if ((WESanalysis == false || (alleleCountingSNPs_ == NULL && maxFragmentLength_ > 0)) && !isStream && thrPoolManager && thrPoolManager->getMaxThreads() > 0 && bamIndex.load(mateFileName)) {
+            bamReader.close();
+            if (WESanalysis)
+                cout << "..using "<< bamIndex.getFileName() << " to read the targeted regions of "<< mateFileName << " in parallel\n";
+            else
+                cout << "..using "<< bamIndex.getFileName() << " to read chromosomes of "<< mateFileName << " in parallel\n";
+            normalCount = fillMyHashFromIndexedBam(mateFileName, bamIndex, matesOrientation, refIndex, refNames, count);
+        } else {
+            if (alleleCountingSNPs_) {
+                SNPAlleleCounter counter(*alleleCountingPileup_, *alleleCountingSNPs_, mateFileName, refNames, minimalTotalLetterCountPerPosition_, minimalQualityPerPosition_);
+                normalCount = countBamReads(bamReader, matesOrientation, refIndex, refNames, NA, &counter, readFilter_, count, bin);
+                counter.finish();
+            } else {
+                normalCount = countBamReads(bamReader, matesOrientation, refIndex, refNames, NA, NULL, readFilter_, count, bin);
+            }
+            if (bamReader.isError()) {
+                cerr << "Error: FREEC was not able to read "<< mateFileName << " until the end\n";
+                exit(-1);
+            }
+        }
+        if (alleleCountingSNPs_) {
+            alleleCountingSNPs_->setPileupRead(true);
+            alleleCountingSNPs_ = NULL;
+        }
+        cout << "..finished reading "<<mateFileName<<endl;
+    } else {
 
-		while ((line_buffer = getLine(buffer, MAX_BUFFER, stream, line)) != NULL) {
-		  count++;
-		  normalCount+=processRead(inputFormat,matesOrientation,line_buffer, bin,targetBed, mateFileName);
+        //text formats, plain or compressed with gzip
+        LineReader reader;
+        if (!reader.open(mateFileName, true)) {
+            cerr << "Error: unable to open "+mateFileName+"\n" ;
+            exit(-1);
+        }
+		inputFormat = getInputFormat(inputFormat_str);
+		bool bowtiePairs = (inputFormat_str.compare("bowtie")==0 || inputFormat_str.compare("Bowtie")==0)&&(matesOrientation_str.compare("0")!=0);
+		if (inputFormat == SAM_INPUT_FORMAT) {
+		  normalCount = countSAMReads(reader, matesOrientation, count, bin);
+		} else {
+		  while ((line_buffer = reader.nextLine()) != NULL) {
+		    count++;
+		    if (bowtiePairs) {
+		      line = line_buffer;
+		      string line2;
+		      if ((line_buffer = reader.nextLine()) != NULL) {
+		        line2 = line_buffer;
+		        count++;
+		      }
+		      normalCount+=processReadWithBowtie(inputFormat_str,matesOrientation_str,line,line2);
+		    } else {
+		      normalCount+=processRead(inputFormat,matesOrientation,line_buffer, bin,targetBed, mateFileName);
+		    }
+		  }
 		}
-        #if defined(_WIN32)
-				_pclose(stream);
-		#else
-				pclose(stream);
-		#endif
+        if (reader.isError()) {
+            cerr << "Error: FREEC was not able to read "<< mateFileName << " until the end\n";
+            exit(-1);
+        }
 		cout << "..finished reading "<<mateFileName<<endl;
-    } else {
- 	        inputFormat = getInputFormat(inputFormat_str);
-    		while (std::getline(fileMates,line)) {
-                count++;
-                if ((inputFormat_str.compare("bowtie")==0 || inputFormat_str.compare("Bowtie")==0)&&(matesOrientation_str.compare("0")!=0)){
-                    string line2;
-                    std::getline(fileMates,line2);
-                    count++;
-                    normalCount+=processReadWithBowtie(inputFormat_str,matesOrientation_str,line,line2);
-                } else {
-				    normalCount+=processRead(inputFormat,matesOrientation,line.c_str(), bin,targetBed, mateFileName);
-				}
-    		}
-            fileMates.close();
     }
 
 #ifdef PROFILE_TRACE
 	std::cout << "PROFILING [tid=" << pthread_self() << "]: " << mateFileName << " read in " << (time(NULL)-t0) << " seconds [fillMyHash]\n" << std::flush;
 #endif
 
+	for (vector<ChrCopyNumber>::iterator it = chrCopyNumber_.begin(); it != chrCopyNumber_.end(); it++) {
+		it->finishReadCounting();
+	}
+
+	//SNPs could not be genotyped while reading a non-BAM file
+	if (alleleCountingSNPs_) {
+	    alleleCountingPileup_->countAlleles(*alleleCountingSNPs_, mateFileName, minimalTotalLetterCountPerPosition_, minimalQualityPerPosition_);
+	    alleleCountingSNPs_ = NULL;
+	}
+
+	//WES profiles have one value per exon
+	if (WESanalysis)
+	    step_ = 0;
+
 	totalNumberOfPairs_ = normalCount;
 	normalNumberOfPairs_ = normalCount;
 	cout << count<< " lines read..\n";
+	if (readFilter_.isActive()) {
+	    cout << readFilter_.rejectedByFlags << " reads rejected for their flags, " << readFilter_.rejectedByMappingQuality << " for their mapping quality\n";
+	}
 	cout << normalNumberOfPairs_<< " reads used to compute copy number profile\n";
 	if (normalNumberOfPairs_==0) {
         cerr << "\nError: FREEC was not able to extract reads from " << mateFileName;
@@ -384,6 +489,62 @@ void GenomeCopyNumber::fillMyHash(std::string const& mateFileName ,std::string c
 
         exit(-1);
 	}
+	return count;
+}
+
+long GenomeCopyNumber::fillMyHashWithCountCache(std::string const& mateFileName, std::string const& inputFormat, std::string const& matesOrientation, int windowSize, int step) {
+	vector<string> names;
+	vector<int> lengths;
+	for (int i = 0; i < (int)chrCopyNumber_.size(); i++) {
+		names.push_back(chrCopyNumber_[i].getChromosome());
+		lengths.push_back(chrCopyNumber_[i].getChrLength());
+	}
+	string key = ReadCountCache::makeKey(mateFileName, inputFormat, matesOrientation, readFilter_, names, lengths);
+	if (key.empty()) {
+		return NA;
+	}
+	string cacheFileName = ReadCountCache::getFileName(mateFileName, readCountCacheDir_);
+	ReadCountCache cache;
+	long count;
+	if (cache.load(cacheFileName, key)) {
+		cout << "..reading counts of " << mateFileName << " from " << cacheFileName << "\n";
+		count = cache.getCount();
+		readFilter_.clearCounts();
+		cache.getRejectedCounts(readFilter_);
+		totalNumberOfPairs_ = cache.getNormalCount();
+		normalNumberOfPairs_ = cache.getNormalCount();
+		cout << count<< " lines read..\n";
+		if (readFilter_.isActive()) {
+		    cout << readFilter_.rejectedByFlags << " reads rejected for their flags, " << readFilter_.rejectedByMappingQuality << " for their mapping quality\n";
+		}
+		cout << normalNumberOfPairs_<< " reads used to compute copy number profile\n";
+	} else {
+		//count the reads in fine windows first
+		vector<ChrCopyNumber> fineCopyNumber;
+		for (int i = 0; i < (int)names.size(); i++) {
+			fineCopyNumber.push_back(ChrCopyNumber(READ_COUNT_CACHE_RESOLUTION, lengths[i], names[i]));
+		}
+		chrCopyNumber_.swap(fineCopyNumber);
+		readCountCache_ = false;
+		count = fillMyHash(mateFileName, inputFormat, matesOrientation, READ_COUNT_CACHE_RESOLUTION, READ_COUNT_CACHE_RESOLUTION);
+		readCountCache_ = true;
+		chrCopyNumber_.swap(fineCopyNumber);
+		for (int i = 0; i < (int)fineCopyNumber.size(); i++) {
+			cache.setCounts(i, fineCopyNumber[i].getValues());
+		}
+		cache.setTotals(count, normalNumberOfPairs_, readFilter_);
+		if (cache.save(cacheFileName, key)) {
+			cout << "..read counts of " << mateFileName << " saved in " << cacheFileName << "\n";
+		} else {
+			cout << "..could not write " << cacheFileName << ": read counts will not be cached\n";
+		}
+	}
+	windowSize_ = windowSize;
+	step_ = step;
+	for (int i = 0; i < (int)chrCopyNumber_.size(); i++) {
+		chrCopyNumber_[i].setReadCounts(cache.getCounts(i), READ_COUNT_CACHE_RESOLUTION);
+	}
+	return count;
 }
 
 int GenomeCopyNumber::findIndex (std::string const& chr) {
@@ -1053,7 +1214,7 @@ double GenomeCopyNumber::calculateMedianAround (GenomeCopyNumber & controlCopyNu
 	vector<ChrCopyNumber>::iterator it;
 	for ( it=chrCopyNumber_.begin() ; it != chrCopyNumber_.end(); it++ ) {
 		if (! (it->getChromosome().find("X")!=string::npos || it->getChromosome().find("Y")!=string::npos)) {
-			vector <float> controlcounts = controlCopyNumber.getChrCopyNumber(it->getChromosome()).getValues() ;
+			vector <float> const& controlcounts = controlCopyNumber.getChrCopyNumber(it->getChromosome()).getValues() ;
             //check that everything is all right:
             if (int(controlcounts.size())!=it->getLength()) {
                 cerr << "Possible Error: calculateMedianAround ()\n";
@@ -1063,7 +1224,6 @@ double GenomeCopyNumber::calculateMedianAround (GenomeCopyNumber & controlCopyNu
 				if ((controlValue<=maxVal)&&(controlValue>=minVal))
 					myValuesAround.push_back(it->getValueAt(i));
 			}
-			controlcounts.clear();
         }
 	}
     if (myValuesAround.size()==0) {
@@ -1199,7 +1359,7 @@ void GenomeCopyNumber::calculateRatioUsingCG_Regression( GenomeCopyNumber & cont
     vector<ChrCopyNumber>::iterator it;
     for ( it=chrCopyNumber_.begin() ; it != chrCopyNumber_.end(); it++ ) {
         if (! (it->getChromosome().find("X")!=string::npos || it->getChromosome().find("Y")!=string::npos)) {
-            vector <float> controlcounts = controlCopyNumber.getChrCopyNumber(it->getChromosome()).getRatio() ;
+            vector <float> const& controlcounts = controlCopyNumber.getChrCopyNumber(it->getChromosome()).getRatio() ;
             //check that everything is all right:
             if (int(controlcounts.size())!=it->getLength()) {
                 cerr << "Possible Error: calculateMedianAround ()\n";
@@ -1211,7 +1371,6 @@ void GenomeCopyNumber::calculateRatioUsingCG_Regression( GenomeCopyNumber & cont
                     positions.push_back(it->getCoordinateAtBin(i));
                 }
             }
-            controlcounts.clear();
         }
     }
     if (degree==1) {
@@ -1296,7 +1455,7 @@ int GenomeCopyNumber::calculateRatio( GenomeCopyNumber & controlCopyNumber, int
         vector<ChrCopyNumber>::iterator it;
         for ( it=chrCopyNumber_.begin() ; it != chrCopyNumber_.end(); it++ ) {
             if (! (it->getChromosome().find("X")!=string::npos || it->getChromosome().find("Y")!=string::npos)) {
-                vector <float> controlcounts = controlCopyNumber.getChrCopyNumber(it->getChromosome()).getValues() ;
+                vector <float> const& controlcounts = controlCopyNumber.getChrCopyNumber(it->getChromosome()).getValues() ;
                 //check that everything is all right:
                 if (int(controlcounts.size())!=it->getLength()) {
                     cerr << "Possible Error: calculateMedianAround ()\n";
@@ -1307,7 +1466,6 @@ int GenomeCopyNumber::calculateRatio( GenomeCopyNumber & controlCopyNumber, int
                         y.push_back(log(it->getValueAt(i)));
                     }
                 }
-                controlcounts.clear();
             }
         }
         cout << "Initial guess for polynomial:\n";
@@ -1509,7 +1667,7 @@ int GenomeCopyNumber::calculateRatio( GenomeCopyNumber & controlCopyNumber, int
         vector<ChrCopyNumber>::iterator it;
         for ( it=chrCopyNumber_.begin() ; it != chrCopyNumber_.end(); it++ ) {
             if (! (it->getChromosome().find("X")!=string::npos || it->getChromosome().find("Y")!=string::npos)) {
-                vector <float> controlcounts = controlCopyNumber.getChrCopyNumber(it->getChromosome()).getValues() ;
+                vector <float> const& controlcounts = controlCopyNumber.getChrCopyNumber(it->getChromosome()).getValues() ;
                 //check that everything is all right:
                 if (int(controlcounts.size())!=it->getLength()) {
                     cerr << "Possible Error: calculateMedianAround ()\n";
@@ -1520,7 +1678,6 @@ int GenomeCopyNumber::calculateRatio( GenomeCopyNumber & controlCopyNumber, int
                         y.push_back(it->getValueAt(i));
                     }
                 }
-                controlcounts.clear();
             }
         }
 	//const char * nametmp = "/bioinfo/users/vboeva/Desktop/TMP/Lena/patientT/xy.txt";
@@ -1597,7 +1754,7 @@ float GenomeCopyNumber::getMedianRatio() {
 	vector<float>selectedValues;
 	vector<ChrCopyNumber>::iterator it;
 	for ( it=chrCopyNumber_.begin() ; it != chrCopyNumber_.end(); it++ ) {
-		vector<float> chr_values = it->getRatio();
+		vector<float> const& chr_values = it->getRatio();
 		for (int i = 0; i<(int)chr_values.size(); i++)
 			if (chr_values[i]!=NA)
 				selectedValues.push_back(chr_values[i]);
@@ -1620,7 +1777,7 @@ float GenomeCopyNumber::getMedianCopyNumber() {
 	vector<float>selectedValues;
 	vector<ChrCopyNumber>::iterator it;
 	for ( it=chrCopyNumber_.begin() ; it != chrCopyNumber_.end(); it++ ) {
-		vector<float> chr_values = it->getValues();
+		vector<float> const& chr_values = it->getValues();
 		for (int i = 0; i<(int)chr_values.size(); i++)
 			//if (chr_values[i]!=0)
 				selectedValues.push_back(chr_values[i]);
@@ -1631,9 +1788,12 @@ float GenomeCopyNumber::getMedianCopyNumber() {
     return median;
 }
 
-ChrCopyNumber GenomeCopyNumber::getChrCopyNumber(std::string const& chr) {
+ChrCopyNumber& GenomeCopyNumber::getChrCopyNumber(std::string const& chr) {
 	int index = findIndex(chr);
-	if (index==NA) throw "No such chromosome";
+	if (index==NA) {
+		cerr << "Error: chromosome " << chr << " is not in the copy number profile\n";
+		exit(-1);
+	}
 	return chrCopyNumber_[index];
 }
 void GenomeCopyNumber::printRatio(std::string const& outFile, bool ifBedGraphOutPut, bool printNA) {
@@ -1731,7 +1891,7 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_exomeLength(int breakPointTy
 	vector<ChrCopyNumber>::iterator it;
 	unsigned long long count = 0;
     int endsSize=0;
-	string NormalBAF,NormalBAF_XY;
+	BAFgenotype NormalBAF = BAF_GENOTYPE_UNKNOWN,NormalBAF_XY = BAF_GENOTYPE_UNKNOWN;
     float normalXYploidy=ploidy_*0.5; //will only use it when the genome is male
     estimationOfGenomeSize_=0;
     if (hasBAF_)
@@ -1756,10 +1916,10 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_exomeLength(int breakPointTy
 		int start = 0;
 		int end = NA;
 		int cnumber = NA;
-		string BAFSym = "-";
-        string BAFprev = "-";
-        string BAFnext = "-";
-        string lBAF = "-";
+		BAFgenotype BAFSym = BAF_GENOTYPE_UNKNOWN;
+        BAFgenotype BAFprev = BAF_GENOTYPE_UNKNOWN;
+        BAFgenotype BAFnext = BAF_GENOTYPE_UNKNOWN;
+        BAFgenotype lBAF = BAF_GENOTYPE_UNKNOWN;
 
         float lUncertainty = NA;
         float BAFUncertainty = NA;
@@ -1774,7 +1934,7 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_exomeLength(int breakPointTy
             if (hasBAF_) {
                 BAFSym = it->getBAFsymbPerFrg(i);
                 BAFUncertainty = it->getEstimatedBAFuncertaintyAtBin(i);
-//                cout << "..Control: read "<< BAFSym << "\n";
+//                cout << "..Control: read "<< getBAFgenotypeSymbol(BAFSym) << "\n";
             }
 
 			if (level == NA)
@@ -1784,7 +1944,7 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_exomeLength(int breakPointTy
 				if (nextIndex == NA) {
 					nextLevel = NA;
 					lengthOfNextLevel = 0;
-					BAFnext = "-";
+					BAFnext = BAF_GENOTYPE_UNKNOWN;
 				} else {
 					nextLevel = it->getLevelAt(nextIndex, ploidy_);
 					lengthOfNextLevel = it->getFragmentLengthsAt(nextIndex);
@@ -1796,7 +1956,7 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_exomeLength(int breakPointTy
 
                 if (breakPointType==NOCALL) {
                     if ((previousLevel != NA) && (nextLevel != NA) && previousLevel==nextLevel && previousLevel==normalLevel) {
-                        if (BAFprev.compare(BAFnext)==0) {
+                        if (BAFprev==BAFnext) {
                             level = previousLevel;
                         }
                     }
@@ -1830,10 +1990,10 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_exomeLength(int breakPointTy
                     } else if (breakPointType==NORMALLEVEL) {
                         if ((previousLevel == normalLevel) || (nextLevel == normalLevel) ) {
                             level = normalLevel;
-                            if (BAFprev.compare(BAFnext)==0)
+                            if (BAFprev==BAFnext)
                                 BAFSym = BAFnext;
                             else
-                                BAFSym = "-";
+                                BAFSym = BAF_GENOTYPE_UNKNOWN;
 
                         } else {
                             if ((previousLevel != NA) && (nextLevel != NA) ) {
@@ -1884,13 +2044,13 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_exomeLength(int breakPointTy
                     //if (cnumber < 0) //should happen only with "NOCALL"
                     //    cnumber = NA;
 				} else {
-					if (round_f(level*ploidy_) != cnumber || lBAF.compare(BAFSym)!=0 || lUncertainty != BAFUncertainty) {
+					if (round_f(level*ploidy_) != cnumber || lBAF!=BAFSym || lUncertainty != BAFUncertainty) {
 					    int realEndOfTheCNV=(end+1)*windowSize_; //check that CNV is not larger than chr size
 					    if (realEndOfTheCNV > it->getChrLength())
                             realEndOfTheCNV=it->getChrLength();
 
-                        if (hasBAF_ && lBAF!="" && lBAF.compare("-")!=0)
-                            cnumber = lBAF.length();
+                        if (hasBAF_ && hasBAFgenotypeAlleles(lBAF))
+                            cnumber = getBAFgenotypeCopyNumber(lBAF);
 
                         if (sex_.compare("XY")==0 && (it->getChromosome().find("X")!=string::npos || it->getChromosome().find("Y")!=string::npos)) {
                             if (cnumber != normalXYploidy && cnumber != NA) //push previous entry
@@ -1898,7 +2058,7 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_exomeLength(int breakPointTy
                                     CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,start*windowSize_,realEndOfTheCNV,cnumber,lUncertainty, lBAF,hasBAF_)); //save previous CNV
                                 else
                                     CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,start*windowSize_,realEndOfTheCNV,cnumber)); //save previous CNV
-                            else if (hasBAF_ && lBAF.compare(NormalBAF_XY)!=0 && cnumber == normalXYploidy && lBAF!=""&& lBAF.compare("-")!=0) //abnormal BAF
+                            else if (hasBAF_ && lBAF!=NormalBAF_XY && cnumber == normalXYploidy && hasBAFgenotypeAlleles(lBAF)) //abnormal BAF
                                     CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,start*windowSize_,realEndOfTheCNV,cnumber,lUncertainty, lBAF,hasBAF_)); //save previous CNV
 
 
@@ -1909,7 +2069,7 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_exomeLength(int breakPointTy
                                     CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,start*windowSize_,realEndOfTheCNV,cnumber,lUncertainty, lBAF,hasBAF_)); //save previous CNV
                                 else
                                     CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,start*windowSize_,realEndOfTheCNV,cnumber)); //save previous CNV
-                            else if (hasBAF_ && lBAF.compare(NormalBAF)!=0 && cnumber == ploidy_ && lBAF!=""&& lBAF.compare("-")!=0) //abnormal BAF
+                            else if (hasBAF_ && lBAF!=NormalBAF && cnumber == ploidy_ && hasBAFgenotypeAlleles(lBAF)) //abnormal BAF
                                     CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,start*windowSize_,realEndOfTheCNV,cnumber,lUncertainty, lBAF,hasBAF_)); //save previous CNV
 						}
 
@@ -1938,7 +2098,7 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_exomeLength(int breakPointTy
 					//if (cnumber < 0) //should happen only with "NOCALL"
                     //        cnumber = NA;
 				} else {
-					if (round_f(level*ploidy_) != cnumber || lBAF.compare(BAFSym)!=0 || lUncertainty != BAFUncertainty) { //save previous value:
+					if (round_f(level*ploidy_) != cnumber || lBAF!=BAFSym || lUncertainty != BAFUncertainty) { //save previous value:
 						int realLength = it->getEndAtBin(end)-it->getCoordinateAtBin(start)+1;
 						copyNumberProbs_.find(cnumber)->second += realLength;
 						if (cnumber>=0) {
@@ -1951,8 +2111,8 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_exomeLength(int breakPointTy
                             realEndOfTheCNV=it->getChrLength();
 
 
-                        if (hasBAF_ && lBAF!="" && lBAF.compare("-")!=0)
-                            cnumber = lBAF.length();
+                        if (hasBAF_ && hasBAFgenotypeAlleles(lBAF))
+                            cnumber = getBAFgenotypeCopyNumber(lBAF);
 
 
                         if (sex_.compare("XY")==0 && (it->getChromosome().find("X")!=string::npos || it->getChromosome().find("Y")!=string::npos)) {
@@ -1962,7 +2122,7 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_exomeLength(int breakPointTy
                                     CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,it->getCoordinateAtBin(start),realEndOfTheCNV,cnumber,lUncertainty, lBAF,hasBAF_)); //save previous CNV
                                 else
                                     CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,it->getCoordinateAtBin(start),realEndOfTheCNV,cnumber)); //save previous CNV
-                            else if (hasBAF_ && lBAF.compare(NormalBAF_XY)!=0 && cnumber == normalXYploidy && lBAF!=""&& lBAF.compare("-")!=0) //abnormal BAF
+                            else if (hasBAF_ && lBAF!=NormalBAF_XY && cnumber == normalXYploidy && hasBAFgenotypeAlleles(lBAF)) //abnormal BAF
                                     CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,it->getCoordinateAtBin(start),realEndOfTheCNV,cnumber,lUncertainty, lBAF,hasBAF_)); //save previous CNV
 
 
@@ -1973,7 +2133,7 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_exomeLength(int breakPointTy
                                     CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,it->getCoordinateAtBin(start),realEndOfTheCNV,cnumber,lUncertainty, lBAF,hasBAF_)); //save previous CNV
                                 else
                                     CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,it->getCoordinateAtBin(start),realEndOfTheCNV,cnumber)); //save previous CNV
-                            else if (hasBAF_ && lBAF.compare(NormalBAF)!=0 && cnumber == ploidy_ && lBAF!=""&& lBAF.compare("-")!=0) //abnormal BAF
+                            else if (hasBAF_ && lBAF!=NormalBAF && cnumber == ploidy_ && hasBAFgenotypeAlleles(lBAF)) //abnormal BAF
                                     CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,it->getCoordinateAtBin(start),realEndOfTheCNV,cnumber,lUncertainty, lBAF,hasBAF_)); //save previous CNV
                         }
 
@@ -1999,8 +2159,8 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_exomeLength(int breakPointTy
 		}
 		//save the last CNV for this chromosomerealLength
 
-        if (hasBAF_ && lBAF!="" && lBAF.compare("-")!=0)
-            cnumber = lBAF.length();
+        if (hasBAF_ && hasBAFgenotypeAlleles(lBAF))
+            cnumber = getBAFgenotypeCopyNumber(lBAF);
 
 		if (it->getEndsSize()==0) {
             int realEndOfTheCNV=(end+1)*windowSize_; //check that CNV is not larger than chr size
@@ -2016,7 +2176,7 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_exomeLength(int breakPointTy
                         CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,start*windowSize_,realEndOfTheCNV,cnumber,lUncertainty, lBAF,hasBAF_)); //save previous CNV
                     else
                         CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,start*windowSize_,realEndOfTheCNV,cnumber)); //save previous CNV
-                else if (hasBAF_ && lBAF.compare(NormalBAF_XY)!=0 && cnumber == normalXYploidy && lBAF!=""&& lBAF.compare("-")!=0) //abnormal BAF
+                else if (hasBAF_ && lBAF!=NormalBAF_XY && cnumber == normalXYploidy && hasBAFgenotypeAlleles(lBAF)) //abnormal BAF
                     CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,start*windowSize_,realEndOfTheCNV,cnumber,lUncertainty, lBAF,hasBAF_)); //save previous CNV
 
             } else {
@@ -2026,7 +2186,7 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_exomeLength(int breakPointTy
                         CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,start*windowSize_,realEndOfTheCNV,cnumber,lUncertainty, lBAF,hasBAF_)); //save previous CNV
                     else
                         CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,start*windowSize_,realEndOfTheCNV,cnumber)); //save previous CNV
-                else if (hasBAF_ && lBAF.compare(NormalBAF)!=0 && cnumber == ploidy_ && lBAF!=""&& lBAF.compare("-")!=0) //abnormal BAF
+                else if (hasBAF_ && lBAF!=NormalBAF && cnumber == ploidy_ && hasBAFgenotypeAlleles(lBAF)) //abnormal BAF
                     CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,start*windowSize_,realEndOfTheCNV,cnumber,lUncertainty, lBAF,hasBAF_)); //save previous CNV
 
             }
@@ -2053,7 +2213,7 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_exomeLength(int breakPointTy
                         CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,it->getCoordinateAtBin(start),realEndOfTheCNV,cnumber,lUncertainty, lBAF,hasBAF_)); //save previous CNV
                     else
                         CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,it->getCoordinateAtBin(start),realEndOfTheCNV,cnumber)); //save previous CNV
-                else if (hasBAF_ && lBAF.compare(NormalBAF_XY)!=0 && cnumber == normalXYploidy && lBAF!=""&& lBAF.compare("-")!=0) //abnormal BAF
+                else if (hasBAF_ && lBAF!=NormalBAF_XY && cnumber == normalXYploidy && hasBAFgenotypeAlleles(lBAF)) //abnormal BAF
                     CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,it->getCoordinateAtBin(start),realEndOfTheCNV,cnumber,lUncertainty, lBAF,hasBAF_)); //save previous CNV
 
             } else {
@@ -2062,7 +2222,7 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_exomeLength(int breakPointTy
                         CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,it->getCoordinateAtBin(start),realEndOfTheCNV,cnumber,lUncertainty, lBAF,hasBAF_)); //save previous CNV
                     else
                         CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,it->getCoordinateAtBin(start),realEndOfTheCNV,cnumber)); //save previous CNV
-                else if (hasBAF_ && lBAF.compare(NormalBAF)!=0 && cnumber == ploidy_ && lBAF!=""&& lBAF.compare("-")!=0) //abnormal BAF
+                else if (hasBAF_ && lBAF!=NormalBAF && cnumber == ploidy_ && hasBAFgenotypeAlleles(lBAF)) //abnormal BAF
                     CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,it->getCoordinateAtBin(start),realEndOfTheCNV,cnumber,lUncertainty, lBAF,hasBAF_)); //save previous CNV
 
             }
@@ -2095,7 +2255,7 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_genomeLength(int breakPointT
 	unsigned long long count = 0;
     int min_fragment= telo_centromeric_flanks_/step_;
 	int endsSize=0;
-	string NormalBAF,NormalBAF_XY;
+	BAFgenotype NormalBAF = BAF_GENOTYPE_UNKNOWN,NormalBAF_XY = BAF_GENOTYPE_UNKNOWN;
     float normalXYploidy=ploidy_*0.5; //will only use it when the genome is male
 
     if (hasBAF_) {
@@ -2124,10 +2284,10 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_genomeLength(int breakPointT
 		int start = 0;
 		int end = NA;
 		int cnumber = NA;
-		string BAFSym = "-";
-        string BAFprev = "-";
-        string BAFnext = "-";
-        string lBAF = "-";
+		BAFgenotype BAFSym = BAF_GENOTYPE_UNKNOWN;
+        BAFgenotype BAFprev = BAF_GENOTYPE_UNKNOWN;
+        BAFgenotype BAFnext = BAF_GENOTYPE_UNKNOWN;
+        BAFgenotype lBAF = BAF_GENOTYPE_UNKNOWN;
 
         float lUncertainty = NA;
         float BAFUncertainty = NA;
@@ -2143,7 +2303,7 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_genomeLength(int breakPointT
             if (hasBAF_) {
                 BAFSym = it->getBAFsymbPerFrg(i);
                 BAFUncertainty = it->getEstimatedBAFuncertaintyAtBin(i);
-//                cout << "..Control: read "<< BAFSym << "\n";
+//                cout << "..Control: read "<< getBAFgenotypeSymbol(BAFSym) << "\n";
             }
 
 			if (breakPointType==HALFLENGTH && i<(int)it->getMedianValues().size()-1) {
@@ -2164,7 +2324,7 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_genomeLength(int breakPointT
 				if (nextIndex == NA) {
 					nextLevel = NA;
 					lengthOfNextLevel = 0;
-					BAFnext = "-";
+					BAFnext = BAF_GENOTYPE_UNKNOWN;
 				} else {
 					nextLevel = it->getLevelAt(nextIndex, ploidy_);
 					lengthOfNextLevel = it->getFragmentLengthsAt(nextIndex);
@@ -2176,7 +2336,7 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_genomeLength(int breakPointT
 
                 if (breakPointType==NOCALL) {
                     if ((previousLevel != NA) && (nextLevel != NA) && previousLevel==nextLevel && previousLevel==normalLevel) {
-                        if (BAFprev.compare(BAFnext)==0) {
+                        if (BAFprev==BAFnext) {
                             level = previousLevel;
                         }
                     }
@@ -2210,10 +2370,10 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_genomeLength(int breakPointT
                     } else if (breakPointType==NORMALLEVEL) {
                         if ((previousLevel == normalLevel) || (nextLevel == normalLevel) ) {
                             level = normalLevel;
-                            if (BAFprev.compare(BAFnext)==0)
+                            if (BAFprev==BAFnext)
                                 BAFSym = BAFnext;
                             else
-                                BAFSym = "-";
+                                BAFSym = BAF_GENOTYPE_UNKNOWN;
 
                         } else {
                             if ((previousLevel != NA) && (nextLevel != NA) ) {
@@ -2264,13 +2424,13 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_genomeLength(int breakPointT
                     //if (cnumber < 0) //should happen only with "NOCALL"
                     //    cnumber = NA;
 				} else {
-					if (round_f(level*ploidy_) != cnumber || lBAF.compare(BAFSym)!=0 || lUncertainty != BAFUncertainty) {
+					if (round_f(level*ploidy_) != cnumber || lBAF!=BAFSym || lUncertainty != BAFUncertainty) {
 					    int realEndOfTheCNV=(end+1)*windowSize_; //check that CNV is not larger than chr size
 					    if (realEndOfTheCNV > it->getChrLength())
                             realEndOfTheCNV=it->getChrLength();
 
-                        if (hasBAF_ && lBAF!="" && lBAF.compare("-")!=0)
-                            cnumber = lBAF.length();
+                        if (hasBAF_ && hasBAFgenotypeAlleles(lBAF))
+                            cnumber = getBAFgenotypeCopyNumber(lBAF);
 
                         if (sex_.compare("XY")==0 && (it->getChromosome().find("X")!=string::npos || it->getChromosome().find("Y")!=string::npos)) {
                             if (cnumber != normalXYploidy && cnumber != NA) //push previous entry
@@ -2278,7 +2438,7 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_genomeLength(int breakPointT
                                     CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,start*windowSize_,realEndOfTheCNV,cnumber,lUncertainty, lBAF,hasBAF_)); //save previous CNV
                                 else
                                     CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,start*windowSize_,realEndOfTheCNV,cnumber)); //save previous CNV
-                            else if (hasBAF_ && lBAF.compare(NormalBAF_XY)!=0 && cnumber == normalXYploidy && lBAF!=""&& lBAF.compare("-")!=0) //abnormal BAF
+                            else if (hasBAF_ && lBAF!=NormalBAF_XY && cnumber == normalXYploidy && hasBAFgenotypeAlleles(lBAF)) //abnormal BAF
                                     CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,start*windowSize_,realEndOfTheCNV,cnumber,lUncertainty, lBAF,hasBAF_)); //save previous CNV
 
 
@@ -2289,7 +2449,7 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_genomeLength(int breakPointT
                                     CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,start*windowSize_,realEndOfTheCNV,cnumber,lUncertainty, lBAF,hasBAF_)); //save previous CNV
                                 else
                                     CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,start*windowSize_,realEndOfTheCNV,cnumber)); //save previous CNV
-                            else if (hasBAF_ && lBAF.compare(NormalBAF)!=0 && cnumber == ploidy_ && lBAF!=""&& lBAF.compare("-")!=0) //abnormal BAF
+                            else if (hasBAF_ && lBAF!=NormalBAF && cnumber == ploidy_ && hasBAFgenotypeAlleles(lBAF)) //abnormal BAF
                                     CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,start*windowSize_,realEndOfTheCNV,cnumber,lUncertainty, lBAF,hasBAF_)); //save previous CNV
 						}
 
@@ -2318,7 +2478,7 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_genomeLength(int breakPointT
 					//if (cnumber < 0) //should happen only with "NOCALL"
                     //        cnumber = NA;
 				} else {
-					if (round_f(level*ploidy_) != cnumber || lBAF.compare(BAFSym)!=0 || lUncertainty != BAFUncertainty) { //save previous value:
+					if (round_f(level*ploidy_) != cnumber || lBAF!=BAFSym || lUncertainty != BAFUncertainty) { //save previous value:
 						int realLength = it->getEndAtBin(end)-it->getCoordinateAtBin(start)+1;
 						copyNumberProbs_.find(cnumber)->second += realLength;
 						if (cnumber>=0) {
@@ -2331,8 +2491,8 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_genomeLength(int breakPointT
                             realEndOfTheCNV=it->getChrLength();
 
 
-                        if (hasBAF_ && lBAF!="" && lBAF.compare("-")!=0)
-                            cnumber = lBAF.length();
+                        if (hasBAF_ && hasBAFgenotypeAlleles(lBAF))
+                            cnumber = getBAFgenotypeCopyNumber(lBAF);
 
 
                         if (sex_.compare("XY")==0 && (it->getChromosome().find("X")!=string::npos || it->getChromosome().find("Y")!=string::npos)) {
@@ -2342,7 +2502,7 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_genomeLength(int breakPointT
                                     CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,it->getCoordinateAtBin(start),realEndOfTheCNV,cnumber,lUncertainty, lBAF,hasBAF_)); //save previous CNV
                                 else
                                     CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,it->getCoordinateAtBin(start),realEndOfTheCNV,cnumber)); //save previous CNV
-                            else if (hasBAF_ && lBAF.compare(NormalBAF_XY)!=0 && cnumber == normalXYploidy && lBAF!=""&& lBAF.compare("-")!=0) //abnormal BAF
+                            else if (hasBAF_ && lBAF!=NormalBAF_XY && cnumber == normalXYploidy && hasBAFgenotypeAlleles(lBAF)) //abnormal BAF
                                     CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,it->getCoordinateAtBin(start),realEndOfTheCNV,cnumber,lUncertainty, lBAF,hasBAF_)); //save previous CNV
 
 
@@ -2353,7 +2513,7 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_genomeLength(int breakPointT
                                     CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,it->getCoordinateAtBin(start),realEndOfTheCNV,cnumber,lUncertainty, lBAF,hasBAF_)); //save previous CNV
                                 else
                                     CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,it->getCoordinateAtBin(start),realEndOfTheCNV,cnumber)); //save previous CNV
-                            else if (hasBAF_ && lBAF.compare(NormalBAF)!=0 && cnumber == ploidy_ && lBAF!=""&& lBAF.compare("-")!=0) //abnormal BAF
+                            else if (hasBAF_ && lBAF!=NormalBAF && cnumber == ploidy_ && hasBAFgenotypeAlleles(lBAF)) //abnormal BAF
                                     CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,it->getCoordinateAtBin(start),realEndOfTheCNV,cnumber,lUncertainty, lBAF,hasBAF_)); //save previous CNV
                         }
 
@@ -2379,8 +2539,8 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_genomeLength(int breakPointT
 		}
 		//save the last CNV for this chromosomerealLength
 
-        if (hasBAF_ && lBAF!="" && lBAF.compare("-")!=0)
-            cnumber = lBAF.length();
+        if (hasBAF_ && hasBAFgenotypeAlleles(lBAF))
+            cnumber = getBAFgenotypeCopyNumber(lBAF);
 
 		if (it->getEndsSize()==0) {
             int realEndOfTheCNV=(end+1)*windowSize_; //check that CNV is not larger than chr size
@@ -2396,7 +2556,7 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_genomeLength(int breakPointT
                         CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,start*windowSize_,realEndOfTheCNV,cnumber,lUncertainty, lBAF,hasBAF_)); //save previous CNV
                     else
                         CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,start*windowSize_,realEndOfTheCNV,cnumber)); //save previous CNV
-                else if (hasBAF_ && lBAF.compare(NormalBAF_XY)!=0 && cnumber == normalXYploidy && lBAF!=""&& lBAF.compare("-")!=0) //abnormal BAF
+                else if (hasBAF_ && lBAF!=NormalBAF_XY && cnumber == normalXYploidy && hasBAFgenotypeAlleles(lBAF)) //abnormal BAF
                     CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,start*windowSize_,realEndOfTheCNV,cnumber,lUncertainty, lBAF,hasBAF_)); //save previous CNV
 
             } else {
@@ -2406,7 +2566,7 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_genomeLength(int breakPointT
                         CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,start*windowSize_,realEndOfTheCNV,cnumber,lUncertainty, lBAF,hasBAF_)); //save previous CNV
                     else
                         CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,start*windowSize_,realEndOfTheCNV,cnumber)); //save previous CNV
-                else if (hasBAF_ && lBAF.compare(NormalBAF)!=0 && cnumber == ploidy_ && lBAF!=""&& lBAF.compare("-")!=0) //abnormal BAF
+                else if (hasBAF_ && lBAF!=NormalBAF && cnumber == ploidy_ && hasBAFgenotypeAlleles(lBAF)) //abnormal BAF
                     CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,start*windowSize_,realEndOfTheCNV,cnumber,lUncertainty, lBAF,hasBAF_)); //save previous CNV
 
             }
@@ -2433,7 +2593,7 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_genomeLength(int breakPointT
                         CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,it->getCoordinateAtBin(start),realEndOfTheCNV,cnumber,lUncertainty, lBAF,hasBAF_)); //save previous CNV
                     else
                         CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,it->getCoordinateAtBin(start),realEndOfTheCNV,cnumber)); //save previous CNV
-                else if (hasBAF_ && lBAF.compare(NormalBAF_XY)!=0 && cnumber == normalXYploidy && lBAF!=""&& lBAF.compare("-")!=0) //abnormal BAF
+                else if (hasBAF_ && lBAF!=NormalBAF_XY && cnumber == normalXYploidy && hasBAFgenotypeAlleles(lBAF)) //abnormal BAF
                     CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,it->getCoordinateAtBin(start),realEndOfTheCNV,cnumber,lUncertainty, lBAF,hasBAF_)); //save previous CNV
 
             } else {
@@ -2442,7 +2602,7 @@ void GenomeCopyNumber::calculateCopyNumberProbs_and_genomeLength(int breakPointT
                         CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,it->getCoordinateAtBin(start),realEndOfTheCNV,cnumber,lUncertainty, lBAF,hasBAF_)); //save previous CNV
                     else
                         CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,it->getCoordinateAtBin(start),realEndOfTheCNV,cnumber)); //save previous CNV
-                else if (hasBAF_ && lBAF.compare(NormalBAF)!=0 && cnumber == ploidy_ && lBAF!=""&& lBAF.compare("-")!=0) //abnormal BAF
+                else if (hasBAF_ && lBAF!=NormalBAF && cnumber == ploidy_ && hasBAFgenotypeAlleles(lBAF)) //abnormal BAF
                     CNVs_.push_back(EntryCNV(it->getChromosome(),start,end,it->getCoordinateAtBin(start),realEndOfTheCNV,cnumber,lUncertainty, lBAF,hasBAF_)); //save previous CNV
 
             }
@@ -2612,21 +2772,22 @@ void GenomeCopyNumber::readGemMappabilityFile(std::string const& inFile) {
 }
 
 int GenomeCopyNumber::readCGprofile(std::string const& inFile) {
-	ifstream file (inFile.c_str());
-	string line;
+	LineReader file;
+	char* line_buffer;
+	int length;
+	char* strs[32];
 	int count = 0;
 	int observedStep = 0;
-	if (file.is_open())	{
-		while (! file.eof() )	{
-			getline (file,line);
-			if (! line.length()) continue;
-			std::vector<std::string> strs = split(line, '\t');
-			if (strs.size()>=4) {
+	if (file.open(inFile))	{
+		while ((line_buffer = file.nextLine(&length)) != NULL)	{
+			if (! length) continue;
+			unsigned int strs_cnt = split(line_buffer, '\t', strs);
+			if (strs_cnt>=4) {
 				string currentChr = strs[0];
 				if (observedStep==0)
-                    observedStep = ceil(strtod(strs[1].c_str(), NULL));
-				float CGperc =(float)strtod(strs[2].c_str(), NULL);
-				float nonNperc =(float)strtod(strs[3].c_str(), NULL);
+                    observedStep = ceil(strtod(strs[1], NULL));
+				float CGperc =(float)strtod(strs[2], NULL);
+				float nonNperc =(float)strtod(strs[3], NULL);
 				string::size_type pos = 0;
 				if ( ( pos = currentChr.find("chr", pos)) != string::npos )
 					currentChr.replace( pos, 3, "" );
@@ -2635,8 +2796,8 @@ int GenomeCopyNumber::readCGprofile(std::string const& inFile) {
 				    chrCopyNumber_[index].addToCGcontent(CGperc);
                     chrCopyNumber_[index].addToNonNpercent(nonNperc);
                     count++;
-                    if (strs.size()==5) { //means that there are also mappability values in the 5th colomn
-                        float MappPerc =(float)strtod(strs[4].c_str(), NULL);
+                    if (strs_cnt==5) { //means that there are also mappability values in the 5th colomn
+                        float MappPerc =(float)strtod(strs[4], NULL);
                         chrCopyNumber_[index].addToMappabilityProfile(MappPerc);
                     }
                     if (observedStep!=0 && observedStep!=step_ && step_!=NA && step_!=0) {
@@ -2649,11 +2810,12 @@ int GenomeCopyNumber::readCGprofile(std::string const& inFile) {
                     }
 				}
 			}
-
-			strs.clear();
 		}
 		file.close();
 		cout << "file " << inFile << " is read\n";
+		for (int i = 0; i < (int)chrCopyNumber_.size(); i++) {
+			chrCopyNumber_[i].shrinkToFit();
+		}
 		if (count==0){
             cerr << "Your GC-content file "<<inFile<< " is empty or is in a wrong format\n\nPlease use chomosome sequences (option \"chrFiles\") to recreate it!\n\n";
             exit(-1);
@@ -2667,42 +2829,47 @@ int GenomeCopyNumber::readCGprofile(std::string const& inFile) {
 }
 
 void GenomeCopyNumber::readCopyNumber(std::string const& inFile) {
+  if (BinaryProfileReader::isBinaryProfile(inFile)) {
+    readBinaryCopyNumber(inFile);
+    return;
+  }
   if (WESanalysis == false)
     {
 	totalNumberOfPairs_ = 0;
 	normalNumberOfPairs_ = 0;
 	windowSize_ = 0;
-	ifstream file (inFile.c_str());
-	string line;
+	LineReader file;
+	char* line_buffer;
+	int length;
+	char* strs[32];
 	string currentChr = "";
 	int chrCount = -1;
 	refGenomeSize_ = 0;
 	string::size_type pos = 0;
 	int count = 0;
-	if (file.is_open())	{
-		while (! file.eof() )	{
-			getline (file,line);
+	if (file.open(inFile))	{
+		while ((line_buffer = file.nextLine(&length)) != NULL)	{
 
-			if (! line.length()) continue;
+			if (! length) continue;
 
-			std::vector<std::string> strs = split(line, '\t');
-			if (strs.size()==3) {
-				if (strs[0].compare(currentChr)!=0) {
+			unsigned int strs_cnt = split(line_buffer, '\t', strs);
+			if (strs_cnt==3) {
+				if (currentChr.compare(strs[0])!=0) {
 					chrCount ++;
 					currentChr = strs[0];
 					chromosomesInd_.insert(pair<string, int> (currentChr,chrCount));
 					chrCopyNumber_.push_back(ChrCopyNumber(currentChr));
-					windowSize_ = atoi(strs[1].c_str());
+					windowSize_ = atoi(strs[1]);
 				}
-				float cp = (float)strtod(strs[2].c_str(), NULL);
+				float cp = (float)strtod(strs[2], NULL);
 				chrCopyNumber_[chrCount].addToReadCount(cp);
-				chrCopyNumber_[chrCount].addToCoordinates(atoi(strs[1].c_str()));
+				chrCopyNumber_[chrCount].addToCoordinates(atoi(strs[1]));
 				normalNumberOfPairs_ += (int)cp;
 				if (windowSize_ == 0)
-					windowSize_ = atoi(strs[1].c_str());
+					windowSize_ = atoi(strs[1]);
                 count++;
 			}
-			else if (strs.size()==4) {
+			else if (strs_cnt==4) {
 				string chrNumber = strs[0];
 				if ( ( pos = chrNumber.find("chr", pos)) != string::npos )
 					chrNumber.replace( pos, 3, "" );
@@ -2712,12 +2879,12 @@ void GenomeCopyNumber::readCopyNumber(std::string const& inFile) {
 					currentChr = chrNumber;
 					chromosomesInd_.insert(pair<string, int> (currentChr,chrCount));
 					chrCopyNumber_.push_back(ChrCopyNumber(currentChr));
-					windowSize_ = atoi(strs[2].c_str())-atoi(strs[1].c_str())+1;
+					windowSize_ = atoi(strs[2])-atoi(strs[1])+1;
 				}
-				float cp = (float)strtod(strs[3].c_str(), NULL);
+				float cp = (float)strtod(strs[3], NULL);
 				chrCopyNumber_[chrCount].addToReadCount(cp);
-				chrCopyNumber_[chrCount].addToCoordinates(atoi(strs[1].c_str()));
-				chrCopyNumber_[chrCount].addToEnds(atoi(strs[2].c_str()));
+				chrCopyNumber_[chrCount].addToCoordinates(atoi(strs[1]));
+				chrCopyNumber_[chrCount].addToEnds(atoi(strs[2]));
 				normalNumberOfPairs_ += (int)cp;
 				if (count>0 && step_==NA) {
 				  // int first = chrCopyNumber_[chrCount].getCoordinateAtBin(0);
@@ -2726,12 +2893,11 @@ void GenomeCopyNumber::readCopyNumber(std::string const& inFile) {
 				}
 
 				if (windowSize_ == 0)
-					windowSize_ = atoi(strs[1].c_str());
+					windowSize_ = atoi(strs[1]);
 
                 count++;
 			}
 
-			strs.clear();
 		}
 		file.close();
 		cout << "file " << inFile << " read\n";
@@ -2740,6 +2906,7 @@ void GenomeCopyNumber::readCopyNumber(std::string const& inFile) {
 		//fill other values
 		map<string,int>::iterator it;
 		for ( it=chromosomesInd_.begin() ; it != chromosomesInd_.end(); it++ ) {
+			chrCopyNumber_[(*it).second].shrinkToFit();
 			chrCopyNumber_[(*it).second].setWindowSize(windowSize_);
 			int length = chrCopyNumber_[(*it).second].getValues().size();
 			chrCopyNumber_[(*it).second].setVectorLength(length);
@@ -2767,20 +2934,21 @@ void GenomeCopyNumber::readCopyNumber(std::string const& inFile) {
     totalNumberOfPairs_ = 0;
 	normalNumberOfPairs_ = 0;
 	windowSize_ = 0;
-	ifstream file (inFile.c_str());
-	string line;
+	LineReader file;
+	char* line_buffer;
+	int length;
+	char* strs[32];
 	string currentChr = "";
 	int chrCount = -1;
 	refGenomeSize_ = 0;
 	string::size_type pos = 0;
 	int count = 0;
-	if (file.is_open())	{
-		while (! file.eof() )	{
-			getline (file,line);
+	if (file.open(inFile))	{
+		while ((line_buffer = file.nextLine(&length)) != NULL)	{
 
-			if (! line.length()) continue;
+			if (! length) continue;
 
-			std::vector<std::string> strs = split(line, '\t');
+			unsigned int strs_cnt = split(line_buffer, '\t', strs);
 				string chrNumber = strs[0];
 				if ( ( pos = chrNumber.find("chr", pos)) != string::npos )
 					chrNumber.replace( pos, 3, "" );
@@ -2792,19 +2960,18 @@ void GenomeCopyNumber::readCopyNumber(std::string const& inFile) {
 					chrCopyNumber_.push_back(ChrCopyNumber(currentChr));
 					windowSize_ = 0;
 				}
-				float cp = (float)strtod(strs[3].c_str(), NULL);
+				float cp = (float)strtod(strs[3], NULL);
 				chrCopyNumber_[chrCount].addToReadCount(cp);
-				chrCopyNumber_[chrCount].addToCoordinates(atoi(strs[1].c_str()));
-				chrCopyNumber_[chrCount].addToEnds(atoi(strs[2].c_str()));
-				if (strs.size()>=4)
-                    chrCopyNumber_[chrCount].addToGenes_name(strs[4].c_str());
+				chrCopyNumber_[chrCount].addToCoordinates(atoi(strs[1]));
+				chrCopyNumber_[chrCount].addToEnds(atoi(strs[2]));
+				if (strs_cnt>4)
+                    chrCopyNumber_[chrCount].addToGenes_name(strs[4]);
 				normalNumberOfPairs_ += (int)cp;
 				if (count>0 && step_==NA) {
 					step_ = 0;
 				}
                 count++;
 
-			strs.clear();
 		}
 		file.close();
 		cout << "file " << inFile << " read\n";
@@ -2813,6 +2980,7 @@ void GenomeCopyNumber::readCopyNumber(std::string const& inFile) {
 		//fill other values
 		map<string,int>::iterator it;
 		for ( it=chromosomesInd_.begin() ; it != chromosomesInd_.end(); it++ ) {
+			chrCopyNumber_[(*it).second].shrinkToFit();
 			chrCopyNumber_[(*it).second].setWindowSize(windowSize_);
 			int length = chrCopyNumber_[(*it).second].getValues().size();
 			chrCopyNumber_[(*it).second].setVectorLength(length);
@@ -2847,7 +3015,126 @@ void GenomeCopyNumber::readCopyNumber(std::string const& inFile) {
 }
 
 
+void GenomeCopyNumber::readBinaryCopyNumber(std::string const& inFile) {
+	//same profile as the one read from the text file with the same values
+	BinaryProfileReader profile;
+	if (!profile.open(inFile)) {
+	    cerr << "Error: unable to read " << inFile << " (not a valid binary copy number profile)\n";
+	    exit(-1);
+	}
+	totalNumberOfPairs_ = 0;
+	normalNumberOfPairs_ = 0;
+	refGenomeSize_ = 0;
+	windowSize_ = WESanalysis ? 0 : profile.getWindowSize();
+	if (step_==NA)
+		step_ = WESanalysis ? 0 : profile.getStep();
+	vector<string> geneNames;
+	for (int i = 0; i < profile.getNumberOfChromosomes(); i++) {
+		int length = profile.getLength(i);
+		const float* values = profile.getValues(i);
+		chromosomesInd_.insert(pair<string, int> (profile.getChromosome(i),i));
+		chrCopyNumber_.push_back(ChrCopyNumber(profile.getChromosome(i)));
+		ChrCopyNumber& chrCopyNumber = chrCopyNumber_.back();
+		chrCopyNumber.addToReadCounts(values, profile.getCoordinates(i), profile.getEnds(i), length);
+		profile.getGeneNames(i, geneNames);
+		for (int j = 0; j < (int)geneNames.size(); j++)
+			chrCopyNumber.addToGenes_name(geneNames[j]);
+		for (int j = 0; j < length; j++)
+			normalNumberOfPairs_ += (int)values[j];
+
+		chrCopyNumber.setWindowSize(windowSize_);
+		chrCopyNumber.setVectorLength(length);
+		int chromosomeLength = length*step_;
+		if (chrCopyNumber.getEndsSize()>0)
+			chromosomeLength = chrCopyNumber.getEndAtBin(chrCopyNumber.getEndsSize()-1);
+		chrCopyNumber.setChrLength(chromosomeLength);
+		if (WESanalysis == false) {
+			chrCopyNumber.setStep(step_);
+			refGenomeSize_ += chromosomeLength;
+		} else {
+			if (SeekingSubc_ == true) {
+				chrCopyNumber.setCN_subcLength(length+3);
+				chrCopyNumber.setpop_subcLength(length+3);
+			}
+			chrCopyNumber.setStep(0);
+			refGenomeSize_ += length;
+		}
+	}
+	cout << "file " << inFile << " read\n";
+	totalNumberOfPairs_ = normalNumberOfPairs_;
+	if (WESanalysis == false)
+		cout << "\t evaluated genome size:\t" << refGenomeSize_ << "\n";
+}
+
+void GenomeCopyNumber::printMemoryUsage(std::string const& stage) {
+	map<string, double> bytesPerProfile;
+	long windows = 0;
+	for (int i = 0; i < (int)chrCopyNumber_.size(); i++) {
+		chrCopyNumber_[i].addMemoryUsage(bytesPerProfile);
+		windows += chrCopyNumber_[i].getLength();
+	}
+	//largest profiles first
+	vector<pair<double, string> > profiles;
+	double total = 0;
+	for (map<string, double>::iterator it = bytesPerProfile.begin(); it != bytesPerProfile.end(); it++) {
+		if (it->second > 0)
+			profiles.push_back(pair<double, string>(-it->second, it->first));
+		total += it->second;
+	}
+	sort(profiles.begin(), profiles.end());
+	std::cout << "PROFILING [tid=" << pthread_self() << "]: profiles " << stage << ": " << total/1048576 << " MB for " << windows << " windows (" << (windows > 0 ? total/windows : 0) << " bytes per window)";
+	for (int i = 0; i < (int)profiles.size(); i++) {
+		std::cout << (i == 0 ? "; " : ", ") << profiles[i].second << " " << -profiles[i].first/1048576 << " MB";
+	}
+	std::cout << " [printMemoryUsage]\n" << std::flush;
+}
+
+void GenomeCopyNumber::printBinaryCopyNumber(std::string const& outFile) {
+	BinaryProfileWriter profile;
+	bool ok = profile.open(outFile, windowSize_, step_, (int)chromosomesInd_.size());
+	vector<float> values;
+	vector<int> coordinates;
+	vector<int> ends;
+	vector<string> geneNames;
+	//the columns of the text file: ends if they are not start+window-1, gene names for exomes
+	bool hasEnds = WESanalysis || windowSize_ != step_;
+	map<string,int>::iterator it;
+	for ( it=chromosomesInd_.begin() ; ok && it != chromosomesInd_.end(); it++ ) {
+		ChrCopyNumber& chrCopyNumber = chrCopyNumber_[(*it).second];
+		int length = chrCopyNumber.getLength();
+		values.resize(length);
+		coordinates.resize(length);
+		ends.resize(hasEnds ? length : 0);
+		geneNames.resize(WESanalysis ? length : 0);
+		for (int i = 0; i < length; i++) {
+			values[i] = chrCopyNumber.getValueAt(i);
+			coordinates[i] = chrCopyNumber.getCoordinateAtBin(i);
+			if (hasEnds)
+				ends[i] = chrCopyNumber.getEndAtBin(i);
+			if (WESanalysis)
+				geneNames[i] = chrCopyNumber.getGeneNameAtBin(i);
+		}
+		string chrNumber = (*it).first;
+		string::size_type pos = chrNumber.find("chr");
+		if (pos != string::npos)
+			chrNumber.replace(pos, 3, "");
+		ok = profile.addChromosome(chrNumber, values, coordinates, hasEnds ? &ends : NULL, WESanalysis ? &geneNames : NULL);
+	}
+	ok = profile.close() && ok;
+	if (!ok) {
+		cerr << "Error: unable to write " << outFile << "\n";
+		exit(-1);
+	}
+	cout << "printing counts into "<<outFile <<"\n";
+}
+
 void GenomeCopyNumber::printCopyNumber(std::string const& outFile) {
+	if (isCopyNumberPrintedAsBinary_) {
+		printBinaryCopyNumber(outFile + "b");
+	}
+	if (!isCopyNumberPrintedAsText_) {
+		return;
+	}
 	const char * name = outFile.c_str();
 	std::ofstream file;
 	file.open(name);
@@ -2987,8 +3274,8 @@ void GenomeCopyNumber::printRatioBedGraph(std::string const& chr, std::ofstream
             if (valueToPrint<0)
                 valueToPrint = NA;
             if (hasBAF_) {
-                 if (valueToPrint>0 && chrCopyNumber_[index].getBAFsymbolAt(i).compare("-")!=0 &&chrCopyNumber_[index].getBAFsymbolAt(i)!="" && chrCopyNumber_[index].getBAFsymbolAt(i).length()!=valueToPrint ) { //&& (chrCopyNumber_[index].getEstimatedBAFuncertaintyAtI(i)< MAXUncertainty)
-                    valueToPrint=chrCopyNumber_[index].getBAFsymbolAt(i).length();
+                 if (valueToPrint>0 && hasBAFgenotypeAlleles(chrCopyNumber_[index].getBAFsymbolAt(i)) && getBAFgenotypeCopyNumber(chrCopyNumber_[index].getBAFsymbolAt(i))!=valueToPrint ) { //&& (chrCopyNumber_[index].getEstimatedBAFuncertaintyAtI(i)< MAXUncertainty)
+                    valueToPrint=getBAFgenotypeCopyNumber(chrCopyNumber_[index].getBAFsymbolAt(i));
                  }
             }
             myType="NA";
@@ -3035,9 +3322,9 @@ void GenomeCopyNumber::printRatio(std::string const& chr, std::ofstream & file,
                     if (valueToPrint<0)
                         valueToPrint = NA;
                     if (hasBAF_) {
-                         if (valueToPrint>0 && chrCopyNumber_[index].getBAFsymbolAt(i).compare("-")!=0 &&chrCopyNumber_[index].getBAFsymbolAt(i)!="" && chrCopyNumber_[index].getBAFsymbolAt(i).length()!=valueToPrint ) { //&& (chrCopyNumber_[index].getEstimatedBAFuncertaintyAtI(i)< MAXUncertainty)
+                         if (valueToPrint>0 && hasBAFgenotypeAlleles(chrCopyNumber_[index].getBAFsymbolAt(i)) && getBAFgenotypeCopyNumber(chrCopyNumber_[index].getBAFsymbolAt(i))!=valueToPrint ) { //&& (chrCopyNumber_[index].getEstimatedBAFuncertaintyAtI(i)< MAXUncertainty)
                     //change Level value if there is no incertainty:
-                            valueToPrint=chrCopyNumber_[index].getBAFsymbolAt(i).length();
+                            valueToPrint=getBAFgenotypeCopyNumber(chrCopyNumber_[index].getBAFsymbolAt(i));
                          }
                     }
                     file <<"\t"<< valueToPrint;
@@ -3046,8 +3333,9 @@ void GenomeCopyNumber::printRatio(std::string const& chr, std::ofstream & file,
                 file <<"\t"<< chrCopyNumber_[index].getBAFat(i);
                 file <<"\t"<< (1-chrCopyNumber_[index].getBAFProfileAt(i));
 
-                if (chrCopyNumber_[index].getBAFsymbolAt(i)!="")
-                    file <<"\t"<< chrCopyNumber_[index].getBAFsymbolAt(i);
+                string BAFsymbol = getBAFgenotypeSymbol(chrCopyNumber_[index].getBAFsymbolAt(i));
+                if (BAFsymbol!="")
+                    file <<"\t"<< BAFsymbol;
                 else
                     file <<"\t0";
                 file <<"\t"<< chrCopyNumber_[index].getEstimatedBAFuncertaintyAtI(i);
@@ -3762,162 +4050,409 @@ int GenomeCopyNumber::processRead(std::string const& inputFormat, std::string co
 }
 */
 
-int GenomeCopyNumber::processRead(InputFormat inputFormat, MateOrientation matesOrientation, const char* line_buffer, int & prevInd,std::string targetBed, std::string mateFileName)
+int GenomeCopyNumber::processPairedRead(MateOrientation matesOrientation, int index, char orient1, char orient2, int left, int right, int insert_size, int& prevInd)
 {
-
-    int read_Size =150; // in case it is not initialized (e.g. for Pileup files)
-
-    if (!*line_buffer) {
-        return 0;
-    }
-
     int valueToReturn = 0;
+    MateOrientation orient1_2 = getMateOrientation(orient1, orient2);
+    MateOrientation orient2_1 = getMateOrientation(orient2, orient1);
 
-    if (inputFormat == SAM_INPUT_FORMAT && matesOrientation != SINGLE_END_SORTED_SAM) {
-        if (line_buffer[0] == '@')
+    if (WESanalysis == true)  {
+        //the targeted regions of an indexed BAM file contain every pair up to maxFragmentLength_
+        if (maxFragmentLength_ > 0 && (abs(insert_size) > maxFragmentLength_ || abs(right-left) > maxFragmentLength_))
             return 0;
-        if (WESanalysis == true)  {
-            string chr1, chr2;
-            char orient1, orient2;
-            int left,right, insert_size;
-
-            if (getSAMinfo(line_buffer,chr1,chr2,orient1,orient2,left,right, insert_size)) {
-                char orient1_2_str[] = {orient1, orient2, 0};
-                char orient2_1_str[] = {orient2, orient1, 0};
-                MateOrientation orient1_2 = getMateOrientation(orient1_2_str);
-                MateOrientation orient2_1 = getMateOrientation(orient2_1_str);
-                if ((matesOrientation == orient1_2 && right-left>0) || (matesOrientation == orient2_1 && right-left<0)) {
-                    left = min(left, right);
-                    right  = left + abs(insert_size);
-                    int index = findIndex(chr1);
-                    if (index!=NA && chrCopyNumber_[index].getExons_Countchr() != 0) {
-                        bool leftIsInTheWindow = false;
-                        int l = 0;
-                       // try around this value first
-                        for (l=prevInd-1; l<=prevInd+30 && l<chrCopyNumber_[index].getExons_Countchr();l++ ) {
-                            if ((left - 1 < chrCopyNumber_[index].getEndAtBin(l) && (left > (chrCopyNumber_[index].getCoordinateAtBin(l) - insert_size)))) {
-                                leftIsInTheWindow = true;
-                                prevInd=l;
-                                break;
-                            }
-                        }
-                        if (!leftIsInTheWindow) {
-                             //start from the beginning of the chromosome
-                            for (l=0; left>=chrCopyNumber_[index].getCoordinateAtBin(l)- 30*insert_size && l<chrCopyNumber_[index].getExons_Countchr();l++ ) {
-                                if ((left - 1 < chrCopyNumber_[index].getEndAtBin(l) && (left > (chrCopyNumber_[index].getCoordinateAtBin(l) - insert_size)))) {
-                                    leftIsInTheWindow = true;
-                                    prevInd=l;
-                                    break;
-                                }
-                            }
-                        }
-                        if (leftIsInTheWindow == false)   {
-                            valueToReturn = 0;
-                            return valueToReturn;
-                        }
-                        if ((right >  chrCopyNumber_[index].getCoordinateAtBin(l)) && (leftIsInTheWindow == true))   {
-                            step_ = chrCopyNumber_[index].getEndAtBin(l) - chrCopyNumber_[index].getCoordinateAtBin(l) + insert_size +1;
-                            chrCopyNumber_[index].mappedPlusOneAtI(left,step_, l);
-                            valueToReturn = 1;
-                            step_ = 0;
-                        }
-                        if (right < chrCopyNumber_[index].getCoordinateAtBin(l))  {
-                            valueToReturn = 0;
-                            return valueToReturn;
-                        }
+        if ((matesOrientation == orient1_2 && right-left>0) || (matesOrientation == orient2_1 && right-left<0)) {
+            left = min(left, right);
+            right  = left + abs(insert_size);
+            if (index!=NA && chrCopyNumber_[index].getExons_Countchr() != 0) {
+                bool leftIsInTheWindow = false;
+                int l = 0;
+               // try around this value first
+                for (l=prevInd-1; l<=prevInd+30 && l<chrCopyNumber_[index].getExons_Countchr();l++ ) {
+                    if ((left - 1 < chrCopyNumber_[index].getEndAtBin(l) && (left > (chrCopyNumber_[index].getCoordinateAtBin(l) - insert_size)))) {
+                        leftIsInTheWindow = true;
+                        prevInd=l;
+                        break;
                     }
                 }
-            }
-        } else  {
-            string chr1, chr2;
-            char orient1, orient2;
-            int left,right ;
-            if (getSAMinfo(line_buffer,chr1,chr2,orient1,orient2,left,right))  {
-                char orient1_2_str[] = {orient1, orient2, 0};
-                char orient2_1_str[] = {orient2, orient1, 0};
-                MateOrientation orient1_2 = getMateOrientation(orient1_2_str);
-                MateOrientation orient2_1 = getMateOrientation(orient2_1_str);
-                if ((matesOrientation == orient1_2 && right-left>=0) || (matesOrientation == orient2_1 && right-left<=0)) {
-                    int index = findIndex(chr1);
-                    if (index!=NA)  {
-                        chrCopyNumber_[index].mappedPlusOneAtI(min(left,right),step_);
-                        valueToReturn=1;
+                if (!leftIsInTheWindow) {
+                     //start from the beginning of the chromosome
+                    for (l=0; left>=chrCopyNumber_[index].getCoordinateAtBin(l)- 30*insert_size && l<chrCopyNumber_[index].getExons_Countchr();l++ ) {
+                        if ((left - 1 < chrCopyNumber_[index].getEndAtBin(l) && (left > (chrCopyNumber_[index].getCoordinateAtBin(l) - insert_size)))) {
+                            leftIsInTheWindow = true;
+                            prevInd=l;
+                            break;
+                        }
                     }
                 }
+                if (leftIsInTheWindow == false)   {
+                    valueToReturn = 0;
+                    return valueToReturn;
+                }
+                if ((right >  chrCopyNumber_[index].getCoordinateAtBin(l)) && (leftIsInTheWindow == true))   {
+                    //not step_: chromosomes can be read in parallel
+                    int exonStep = chrCopyNumber_[index].getEndAtBin(l) - chrCopyNumber_[index].getCoordinateAtBin(l) + insert_size +1;
+                    chrCopyNumber_[index].mappedPlusOneAtI(left,exonStep, l);
+                    valueToReturn = 1;
+                }
+                if (right < chrCopyNumber_[index].getCoordinateAtBin(l))  {
+                    valueToReturn = 0;
+                    return valueToReturn;
+                }
             }
         }
-        return valueToReturn;
+    } else  {
+        if ((matesOrientation == orient1_2 && right-left>=0) || (matesOrientation == orient2_1 && right-left<=0)) {
+            if (index!=NA)  {
+                chrCopyNumber_[index].mappedPlusOneAtI(min(left,right),step_);
+                valueToReturn=1;
+            }
+        }
+    }
+    return valueToReturn;
+}
+
+int GenomeCopyNumber::processSingleEndRead(int index, int left, int read_Size, int& prevInd)
+{
+    int valueToReturn = 0;
+    if (index==NA)
+        return 0;
+    if (WESanalysis == false) {
+        chrCopyNumber_[index].mappedPlusOneAtI(left,step_);
+        valueToReturn=1;
+    } else {
+        if (maxFragmentLength_ > 0 && read_Size > maxFragmentLength_)
+            return 0;
+        int right = left + read_Size;
+        int l = chrCopyNumber_[index].findExon(left, read_Size, prevInd);
+        if (l == NA) {
+            valueToReturn = 0;
+            return valueToReturn;
+        }
+        if (right >  chrCopyNumber_[index].getCoordinateAtBin(l)) {
+            int exonStep = chrCopyNumber_[index].getEndAtBin(l) - chrCopyNumber_[index].getCoordinateAtBin(l) + read_Size +1;
+            chrCopyNumber_[index].mappedPlusOneAtI(left,exonStep, l);
+            valueToReturn = 1;
+        }
+        if (right < chrCopyNumber_[index].getCoordinateAtBin(l)) {
+            valueToReturn = 0;
+            return valueToReturn;
+        }
     }
+    return valueToReturn;
+}
 
-    if (inputFormat == SAM_INPUT_FORMAT && matesOrientation == SINGLE_END_SORTED_SAM)  {
+int GenomeCopyNumber::processSAMRead(MateOrientation matesOrientation, const char* line, int length, int& prevInd)
+{
+    if (!length || line[0] == '@')
+        return 0;
+    SAMFields fields;
+    int fieldCount = parseSAMFields(line, length, fields);
 
-        if (line_buffer[0] == '@')
+    if (matesOrientation != SINGLE_END_SORTED_SAM) {
+        if (fieldCount < 9)
             return 0;
+        if (readFilter_.isActive() && readFilter_.isRejected(fields.flag, fields.mapq))
+            return 0;
+        //unmapped reads ("*") and unknown chromosomes give NA
+        int index = findIndex(fields.rname, fields.rnameLength);
+        if (index == NA)
+            return 0;
+        //mates must be on the same chromosome: "=" or the same name, possibly spelled differently ("chr1" and "1")
+        bool isSameName = (fields.rnextLength == 1 && fields.rnext[0] == '=') ||
+            (fields.rnextLength == fields.rnameLength && memcmp(fields.rnext, fields.rname, fields.rnameLength) == 0);
+        if (!isSameName && findIndex(fields.rnext, fields.rnextLength) != index)
+            return 0;
+        char orient1 = (fields.flag & BAM_FREVERSE) ? 'R' : 'F';
+        char orient2 = (fields.flag & BAM_FMREVERSE) ? 'R' : 'F';
+        return processPairedRead(matesOrientation, index, orient1, orient2, fields.pos, fields.pnext, fields.tlen, prevInd);
+    }
+    if (fieldCount < 4)
+        return 0;
+    if (readFilter_.isActive() && readFilter_.isRejected(fields.flag, fields.mapq))
+        return 0;
+    //150 in case the line has no SEQ column
+    return processSingleEndRead(findIndex(fields.rname, fields.rnameLength), fields.pos, fields.seqLength == NA ? 150 : fields.seqLength, prevInd);
+}
 
-        // EV: to be optimized
-        string chr1,chr2;
-        char* strs[32];
-        unsigned int strs_cnt = split((char*)line_buffer, '\t', strs);
-        if (strs_cnt > 3) {
-            if (WESanalysis == false) {
-                string chr = strs[2];
-                processChrName(chr);
-                if (chr.compare("*")!=0 ) {
-                    int left = atoi(strs[3]);
-                    int index = findIndex(chr);
-                    if (index!=NA) {
-                        chrCopyNumber_[index].mappedPlusOneAtI(left,step_);
-                        valueToReturn=1;
-                    }
-                }
-            } else {
-                string sequence = strs[9];
-                read_Size = sequence.size();
-                string chr = strs[2];
-                processChrName(chr);
-                int index = findIndex(chr);
-                //chr = "chr" + chr; //I do not understand why it was written here. Valentina
-                int l = 0;
-                if (chr.compare("*")!=0 ) {
-                    int left = atoi(strs[3]);
-                    if (index!=NA) {
-                        int right = left + read_Size;
-                        bool leftIsInTheWindow = false;
-                        if ((left - 1 < chrCopyNumber_[index].getEndAtBin(l) && (left > (chrCopyNumber_[index].getCoordinateAtBin(l) - read_Size))))   {
-                            leftIsInTheWindow = true;
-                        }   else   {
-                            while ((!((left - 1 < chrCopyNumber_[index].getEndAtBin(l)) && (left > (chrCopyNumber_[index].getCoordinateAtBin(l) - read_Size))))  && (l <  chrCopyNumber_[index].getExons_Countchr()))
-                            {
-                                leftIsInTheWindow = false;
-                                l++;
-                            }
-                            if (l < chrCopyNumber_[index].getExons_Countchr())  {
-                                leftIsInTheWindow = true;
-                            } else if (l == (chrCopyNumber_[index].getExons_Countchr() - 1)) {
-                                leftIsInTheWindow = false;
-                            }
-                        }
-                        if (leftIsInTheWindow == false) {
-                            valueToReturn = 0;
-                            return valueToReturn;
-                        }
-                        if ((right >  chrCopyNumber_[index].getCoordinateAtBin(l)) && (leftIsInTheWindow == true)) {
-                            step_ = chrCopyNumber_[index].getEndAtBin(l) - chrCopyNumber_[index].getCoordinateAtBin(l) + read_Size +1;
-                            chrCopyNumber_[index].mappedPlusOneAtI(left,step_, l);
-                            valueToReturn = 1;
-                            step_ = 0;
-                        }
-                        if (right < chrCopyNumber_[index].getCoordinateAtBin(l)) {
-                            valueToReturn = 0;
-                            return valueToReturn;
-                        }
-                    }
+int GenomeCopyNumber::findIndex(const char* chr, int length)
+{
+    //no string is built for the reads: the spelling of the input is looked up directly
+    return contigs_.findSpelling(chr, length);
+}
+
+void GenomeCopyNumber::indexChromosomeNames()
+{
+    contigs_.clear();
+    map<string,int>::iterator it;
+    for (it = chromosomesInd_.begin(); it != chromosomesInd_.end(); it++) {
+        contigs_.add(it->first, it->second);
+    }
+}
+
+int GenomeCopyNumber::processBamRecord(BamRecord const& record, MateOrientation matesOrientation, std::vector<int> const& refIndex, std::vector<std::string> const& refNames, int& prevInd)
+{
+    //same as processSAMRead() for a SAM line, but from the binary fields (BAM positions are 0-based)
+    if (record.refID < 0 || record.refID >= (int)refIndex.size())
+        return 0;
+    int index = refIndex[record.refID];
+
+    if (matesOrientation != SINGLE_END_SORTED_SAM) {
+        if (record.next_refID < 0 || record.next_refID >= (int)refIndex.size())
+            return 0;
+        if (record.next_refID != record.refID && refNames[record.next_refID].compare(refNames[record.refID])!=0)
+            return 0;
+        char orient1 = (record.flag & BAM_FREVERSE) ? 'R' : 'F';
+        char orient2 = (record.flag & BAM_FMREVERSE) ? 'R' : 'F';
+        return processPairedRead(matesOrientation, index, orient1, orient2, record.pos+1, record.next_pos+1, record.tlen, prevInd);
+    }
+    //a SAM line without sequence ("*") has a sequence field of length 1
+    return processSingleEndRead(index, record.pos+1, record.l_seq > 0 ? record.l_seq : 1, prevInd);
+}
+
+#ifdef PROFILE_TRACE
+static void printReadThroughput(const char* input, MateOrientation matesOrientation, bool isWES, long reads, struct timespec const& start)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec)*1e-9;
+    std::cout << "PROFILING [tid=" << pthread_self() << "]: " << input << " (" << (matesOrientation == SINGLE_END_SORTED_SAM ? "single-end" : "paired-end")
+        << ", " << (isWES ? "WES" : "WGS") << "): " << reads << " reads in " << seconds << " seconds";
+    if (reads > 0 && seconds > 0)
+        std::cout << ", " << long(reads/seconds) << " reads/second, " << seconds*1e9/reads << " ns/read";
+    std::cout << " [fillMyHash]\n" << std::flush;
+}
+#endif
+
+long GenomeCopyNumber::countSAMReads(LineReader& reader, MateOrientation matesOrientation, long& count, int& prevInd)
+{
+#ifdef PROFILE_TRACE
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    long count0 = count;
+#endif
+    //SAM lines are tokenized where they are: no copy into a null-terminated buffer
+    const char* view;
+    int viewLength;
+    long normalCount = 0;
+    while (reader.next(view, viewLength)) {
+        count++;
+        normalCount += processSAMRead(matesOrientation, view, viewLength, prevInd);
+    }
+#ifdef PROFILE_TRACE
+    printReadThroughput("SAM", matesOrientation, WESanalysis, count-count0, t0);
+#endif
+    return normalCount;
+}
+
+long GenomeCopyNumber::countBamReads(BamReader& bamReader, MateOrientation matesOrientation, std::vector<int> const& refIndex, std::vector<std::string> const& refNames, int refID, SNPAlleleCounter* counter, ReadFilter& filter, long& count, int& prevInd)
+{
+#ifdef PROFILE_TRACE
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    long count0 = count;
+#endif
+    BamRecord record;
+    vector<unsigned char> data;
+    long normalCount = 0;
+    while (counter ? bamReader.next(record, data) : bamReader.next(record)) {
+        //with an index, only the reads of one reference are read
+        if (refID != NA && record.refID != refID)
+            break;
+        count++;
+        //SNP alleles are counted with their own filters
+        if (counter)
+            counter->addRead(record, data);
+        //only the core fields are decoded at this point
+        if (filter.isActive() && filter.isRejected(record.flag, record.mapq))
+            continue;
+        normalCount += processBamRecord(record, matesOrientation, refIndex, refNames, prevInd);
+    }
+#ifdef PROFILE_TRACE
+    printReadThroughput("BAM", matesOrientation, WESanalysis, count-count0, t0);
+#endif
+    return normalCount;
+}
+
+long GenomeCopyNumber::countTargetedBamReads(BamReader& bamReader, BamIndex const& bamIndex, MateOrientation matesOrientation, std::vector<int> const& refIndex, std::vector<std::string> const& refNames, int refID, std::vector<std::pair<int, int> > const& regions, ReadFilter& filter, long& count, int& prevInd)
+{
+#ifdef PROFILE_TRACE
+    struct timespec t0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    long count0 = count;
+#endif
+    BamRecord record;
+    bool hasRecord = false; //the first record after the previous region, already read
+    uint64_t recordOffset = 0;
+    long normalCount = 0;
+    bool isFinished = false; //end of the file or of the reference
+    for (size_t r = 0; r < regions.size() && !isFinished; r++) {
+        uint64_t offset;
+        if (!bamIndex.getRegionStart(refID, regions[r].first, regions[r].second, offset))
+            continue;
+        //regions are sorted: seek only if the region starts after the current record
+        if (!hasRecord || offset > recordOffset) {
+            if (!bamReader.seek(offset)) {
+                exit(-1);
+            }
+            hasRecord = false;
+        }
+        for (;;) {
+            if (!hasRecord) {
+                recordOffset = bamReader.tell();
+                if (!bamReader.next(record)) {
+                    isFinished = true;
+                    break;
                 }
+                hasRecord = true;
             }
+            if (record.refID != refID) {
+                isFinished = true;
+                break;
+            }
+            if (record.pos >= regions[r].second)
+                break;
+            hasRecord = false;
+            if (record.pos < regions[r].first)
+                continue;
+            count++;
+            if (filter.isActive() && filter.isRejected(record.flag, record.mapq))
+                continue;
+            normalCount += processBamRecord(record, matesOrientation, refIndex, refNames, prevInd);
         }
-        return valueToReturn;
     }
+#ifdef PROFILE_TRACE
+    printReadThroughput("BAM targets", matesOrientation, true, count-count0, t0);
+#endif
+    return normalCount;
+}
 
+void GenomeCopyNumber::getTargetedRegions(int index, std::vector<std::pair<int, int> >& regions)
+{
+    //reads are assigned to an exon by their leftmost position, which can be up to one fragment length before or after it:
+    //with fragments of at most maxFragmentLength_, these regions contain all the reads counted by the streaming path
+    ChrCopyNumber& chrCopyNumber = chrCopyNumber_[index];
+    int flank = max(maxFragmentLength_, TARGET_FLANK);
+    vector<pair<int, int> > targets;
+    for (int l = 0; l < chrCopyNumber.getExons_Countchr(); l++) {
+        targets.push_back(make_pair(max(0, chrCopyNumber.getCoordinateAtBin(l) - flank), chrCopyNumber.getEndAtBin(l) + flank));
+    }
+    sort(targets.begin(), targets.end());
+    regions.clear();
+    for (size_t i = 0; i < targets.size(); i++) {
+        if (!regions.empty() && targets[i].first <= regions.back().second)
+            regions.back().second = max(regions.back().second, targets[i].second);
+        else
+            regions.push_back(targets[i]);
+    }
+}
+
+long GenomeCopyNumber::fillMyHashFromIndexedBam(std::string const& mateFileName, BamIndex const& bamIndex, MateOrientation matesOrientation, std::vector<int> const& refIndex, std::vector<std::string> const& refNames, long& count)
+{
+    //group BAM references by chromosome ("chr1" and "1" would both go to the same ChrCopyNumber)
+    map<int, GenomeCopyNumberReadIndexedBamArgWrapper*> tasks;
+    for (int refID = 0; refID < (int)refIndex.size(); refID++) {
+        if (refIndex[refID] == NA) {
+            //not read, but counted as in the sequential mode when the index records it
+            long long reads = bamIndex.getNumberOfReads(refID);
+            if (reads > 0)
+                count += (long)reads;
+            continue;
+        }
+        if (tasks.find(refIndex[refID]) == tasks.end()) {
+            tasks[refIndex[refID]] = new GenomeCopyNumberReadIndexedBamArgWrapper(*this, mateFileName, bamIndex, matesOrientation, refIndex, refNames, readFilter_);
+        }
+        tasks[refIndex[refID]]->refIDs.push_back(refID);
+    }
+    if (bamIndex.getNumberOfUnplacedReads() > 0)
+        count += (long)bamIndex.getNumberOfUnplacedReads();
+
+    //start with the longest chromosomes so that the short ones fill the gaps at the end
+    vector<pair<int, int> > lengthAndIndex;
+    map<int, GenomeCopyNumberReadIndexedBamArgWrapper*>::iterator it;
+    for (it = tasks.begin(); it != tasks.end(); it++) {
+        lengthAndIndex.push_back(make_pair(-chrCopyNumber_[it->first].getLength(), it->first));
+    }
+    sort(lengthAndIndex.begin(), lengthAndIndex.end());
+
+    ThreadPool* thrPool = ThreadPoolManager::getInstance()->newThreadPool("GenomeCopyNumber_readIndexedBam");
+    for (size_t i = 0; i < lengthAndIndex.size(); i++) {
+        thrPool->addThread(GenomeCopyNumber_readIndexedBam_wrapper, tasks[lengthAndIndex[i].second], false);
+    }
+    thrPool->run();
+    delete thrPool;
+
+    long normalCount = 0;
+    for (it = tasks.begin(); it != tasks.end(); it++) {
+        count += it->second->count;
+        normalCount += it->second->normalCount;
+        readFilter_.addCounts(it->second->filter);
+        delete it->second;
+    }
+    return normalCount;
+}
+
+long GenomeCopyNumber::readIndexedBamReferences(std::string const& mateFileName, BamIndex const& bamIndex, std::vector<int> const& refIDs, MateOrientation matesOrientation, std::vector<int> const& refIndex, std::vector<std::string> const& refNames, ReadFilter& filter, long& count)
+{
+    //every task has its own file handle and only touches the ChrCopyNumber of its references
+    BamReader bamReader;
+    if (!bamReader.open(mateFileName)) {
+        exit(-1);
+    }
+    long normalCount = 0;
+    int prevInd = 0;
+    //SNPs of these references are genotyped by this task only
+    SNPAlleleCounter* counter = NULL;
+    if (alleleCountingSNPs_) {
+        counter = new SNPAlleleCounter(*alleleCountingPileup_, *alleleCountingSNPs_, mateFileName, refNames, minimalTotalLetterCountPerPosition_, minimalQualityPerPosition_);
+    }
+    for (size_t i = 0; i < refIDs.size(); i++) {
+        if (WESanalysis) {
+            vector<pair<int, int> > regions;
+            getTargetedRegions(refIndex[refIDs[i]], regions);
+            long decoded = 0;
+            normalCount += countTargetedBamReads(bamReader, bamIndex, matesOrientation, refIndex, refNames, refIDs[i], regions, filter, decoded, prevInd);
+            if (bamReader.isError()) {
+                cerr << "Error: FREEC was not able to read "<< mateFileName << " until the end\n";
+                exit(-1);
+            }
+            //reads outside the targets are not read, but counted when the index records them
+            long long reads = bamIndex.getNumberOfReads(refIDs[i]);
+            count += reads >= 0 ? (long)reads : decoded;
+            continue;
+        }
+        uint64_t offset;
+        if (!bamIndex.getReferenceStart(refIDs[i], offset))
+            continue;
+        if (!bamReader.seek(offset)) {
+            exit(-1);
+        }
+        //the file is sorted: reads of the reference are contiguous
+        normalCount += countBamReads(bamReader, matesOrientation, refIndex, refNames, refIDs[i], counter, filter, count, prevInd);
+        if (counter)
+            counter->finish();
+        if (bamReader.isError()) {
+            cerr << "Error: FREEC was not able to read "<< mateFileName << " until the end\n";
+            exit(-1);
+        }
+    }
+    delete counter;
+    return normalCount;
+}
+
+int GenomeCopyNumber::processRead(InputFormat inputFormat, MateOrientation matesOrientation, const char* line_buffer, int & prevInd,std::string targetBed, std::string mateFileName)
+{
+
+    int read_Size =150; // in case it is not initialized (e.g. for Pileup files)
+
+    if (!*line_buffer) {
+        return 0;
+    }
+
+    int valueToReturn = 0;
+
+    if (inputFormat == SAM_INPUT_FORMAT) {
+        return processSAMRead(matesOrientation, line_buffer, strlen(line_buffer), prevInd);
+    }
 
     if (inputFormat == SAM_PILEUP_INPUT_FORMAT) {
         if (line_buffer[0] == '#') return 0;
@@ -3934,11 +4469,9 @@ int GenomeCopyNumber::processRead(InputFormat inputFormat, MateOrientation mates
         if (strs_cnt > 4) {
             valueToReturn=strccnt(strs[4], '^');
             if (valueToReturn) {
-                string chr = string(strs[0]);
-                processChrName(chr);
+                int index = findIndex(strs[0], strlen(strs[0]));
                 int left = atoi(strs[1]);
                 if (WESanalysis == false)   {
-                    int index = findIndex(chr);
                     if (index==NA)
                         valueToReturn=0;
                     else {
@@ -3947,26 +4480,12 @@ int GenomeCopyNumber::processRead(InputFormat inputFormat, MateOrientation mates
                         }
                     }
                 } else {
-                    int l = 0;
-                    int index = findIndex(chr);
                     if (index==NA)   {
                         valueToReturn = 0;
                         return valueToReturn;
                     }
-                    bool leftIsInTheWindow = false;
-                    if ((left - 1 < chrCopyNumber_[index].getEndAtBin(l) && (left > (chrCopyNumber_[index].getCoordinateAtBin(l) - read_Size))))   {
-                        leftIsInTheWindow = true;
-                    }  else    {
-                        while ((!((left - 1 < chrCopyNumber_[index].getEndAtBin(l)) &&
-                            (left > (chrCopyNumber_[index].getCoordinateAtBin(l) - read_Size))))  &&
-                            (l <  chrCopyNumber_[index].getExons_Countchr()))    {
-                            leftIsInTheWindow = false;
-                            l++;
-                        }   if (l < chrCopyNumber_[index].getExons_Countchr() -1 )    {
-                            leftIsInTheWindow = true;
-                        }
-                    }
-                    if (leftIsInTheWindow == false)  {
+                    int l = chrCopyNumber_[index].findExon(left, read_Size, prevInd);
+                    if (l == NA)  {
                         valueToReturn = 0;
                         return valueToReturn;
                     }   else    {
@@ -4005,9 +4524,7 @@ int GenomeCopyNumber::processRead(InputFormat inputFormat, MateOrientation mates
     if (inputFormat == BOWTIE_INPUT_FORMAT && matesOrientation == SINGLE_END_SORTED_SAM) {
         std::vector<std::string> strs = split(line_buffer, '\t');
         if (strs.size() > 4) {
-          string chr = strs[2];
-          processChrName(chr);
-          int index = findIndex(chr);
+          int index = findIndex(strs[2].c_str(), (int)strs[2].size());
           if (index!=NA) {
             int left = atoi(strs[3].c_str());
             chrCopyNumber_[index].mappedPlusOneAtI(left, step_);
@@ -4021,9 +4538,7 @@ int GenomeCopyNumber::processRead(InputFormat inputFormat, MateOrientation mates
     if (inputFormat == PSL_INPUT_FORMAT && matesOrientation == SINGLE_END_SORTED_SAM) {
         std::vector<std::string> strs = split(line_buffer, '\t');
         if (strs.size() > 17) {
-          string chr = strs[13];
-          processChrName(chr);
-          int index = findIndex(chr);
+          int index = findIndex(strs[13].c_str(), (int)strs[13].size());
           if (index!=NA) {
             int left = atoi(strs[15].c_str());
             chrCopyNumber_[index].mappedPlusOneAtI(left,step_);
@@ -4037,9 +4552,7 @@ int GenomeCopyNumber::processRead(InputFormat inputFormat, MateOrientation mates
     if (inputFormat == ARACHNE_BED_INPUT_FORMAT && matesOrientation == SINGLE_END_SORTED_SAM) {
         std::vector<std::string> strs = split(line_buffer, '\t');
         if (strs.size() > 1) {
-          string chr = strs[0];
-          processChrName(chr);
-          int index = findIndex(chr);
+          int index = findIndex(strs[0].c_str(), (int)strs[0].size());
           if (index!=NA){
             int left = atoi(strs[1].c_str());
             chrCopyNumber_[index].mappedPlusOneAtI(left,step_);
@@ -4049,9 +4562,7 @@ int GenomeCopyNumber::processRead(InputFormat inputFormat, MateOrientation mates
           strs.clear();
           strs = split(line_buffer, ' ');
           if (strs.size() > 1) {
-            string chr = strs[0];
-            processChrName(chr);
-            int index = findIndex(chr);
+            int index = findIndex(strs[0].c_str(), (int)strs[0].size());
             if (index!=NA) {
               int left = atoi(strs[1].c_str());
               chrCopyNumber_[index].mappedPlusOneAtI(left,step_);
@@ -4066,9 +4577,7 @@ int GenomeCopyNumber::processRead(InputFormat inputFormat, MateOrientation mates
     if (inputFormat == SOAP_INPUT_FORMAT && matesOrientation == SINGLE_END_SORTED_SAM) {
         std::vector<std::string> strs = split(line_buffer, '\t');
         if (strs.size() > 8) {
-          string chr = strs[7];
-          processChrName(chr);
-          int index = findIndex(chr);
+          int index = findIndex(strs[7].c_str(), (int)strs[7].size());
           if (index!=NA) {
             int left = atoi(strs[8].c_str());
             chrCopyNumber_[index].mappedPlusOneAtI(left,step_);
@@ -4082,9 +4591,7 @@ int GenomeCopyNumber::processRead(InputFormat inputFormat, MateOrientation mates
     if (inputFormat == SOAP_INPUT_FORMAT && matesOrientation != SINGLE_END_SORTED_SAM) {
         std::vector<std::string> strs = split(line_buffer, '\t');
         if (strs.size() > 8) {
-          string chr = strs[7];
-          processChrName(chr);
-          int index = findIndex(chr);
+          int index = findIndex(strs[7].c_str(), (int)strs[7].size());
           if (index!=NA) {
             int left = atoi(strs[8].c_str());
             chrCopyNumber_[index].mappedPlusOneAtI(left,step_);
@@ -4169,63 +4676,39 @@ float GenomeCopyNumber::removeLargeExons(float iqrToKeep) {
 	return numberOfRemovedExons/totalNumberExons;
 }
 int GenomeCopyNumber::focusOnCapture (std::string const& captureFile) {
-	ifstream file (captureFile.c_str());
-	string line;
-    //string::size_type pos = 0;
-    string currentChr = "";
-    int index = NA;
-    int count = 0;
-    int mapCount;
-    float ratio;
     int endShift = - windowSize_/step_ + 1;
     unsigned long int minRegion = refGenomeSize_;
     refGenomeSize_=0; //will be recalculated!!!
-
-    map<int,int> chrRead;
-    map<int,int>::iterator itMapChr;
+    int mapCount;
+    float ratio;
 
     int averageReadLength=400; averageReadLength=150;//from version 6.6
 
-	if (file.is_open())	{
-	    cout << "..Reading "<< captureFile << "\n";
-        cout << "..Your file must be in .BED format, and it must be sorted\n";
-
-		while (! file.eof() )	{
-			getline (file,line);
-			if (! line.length()) continue;
-            std::vector<std::string> strs = split(line, '\t');
-            if (strs.size()<3) continue;
+    //the same targets as the ones of the ChrCopyNumber objects: the .bed file is not read again
+    CaptureRegions const& capture = CaptureRegions::getInstance(captureFile);
+    for (size_t c = 0; c < capture.getChromosomes().size(); c++) {
+        string const& chr = capture.getChromosomes()[c];
+        int index = findIndex(chr);
+        if (index == NA) {
+            cout <<  "skipping chromosome " << chr << "\n";
+            continue;
+        }
+        const ChrCaptureRegions* targets = capture.getRegions(chr);
+        //check if the file is sorted:
+        if (targets->blocks > 1) {
+            cerr << "Your .bed file should be sorted. \n..Unable to proceed..\n";
+            exit(-1);
+        }
+        cout << "..Reading capture for chromosome " << chr << "\n";
+        //check is notNprofile_ exists, and create it if it does not exists:
+        chrCopyNumber_[index].checkOrCreateNotNprofileWithZeros();
 
-			string chr = strs[0];
-            processChrName(chr);
-            int positionS = atoi(strs[1].c_str())-averageReadLength; if (positionS<=0) positionS=1;
-            int positionE = atoi(strs[2].c_str())-1; //because it is 1-based
+        for (size_t r = 0; r < targets->starts.size(); r++) {
+            int positionS = targets->starts[r]-averageReadLength; if (positionS<=0) positionS=1;
+            int positionE = targets->ends[r]-1; //because it is 1-based
 
             if (positionS >= positionE || positionS<0) continue;
 
-			if ( currentChr.compare(chr)!=0 ){ //start reading a new chromosome
-                cout << "..Reading capture for chromosome " << chr << "\n";
-                index = findIndex(chr);
-                if (index == NA) {
-				    cout <<  "skipping chromosome " << chr << "\n";
-				    continue;
-                }
-                //restore all variables for a new chromosome
-                currentChr = chr;
-                //check if the file is sorted:
-                itMapChr=chrRead.find(index);
-                if (itMapChr != chrRead.end()  ) {
-                    cerr << "Your .bed file should be sorted. \n..Unable to proceed..\n";
-                    exit(-1);
-                }
-                chrRead[index]=1;
-
-                //check is notNprofile_ exists, and create it if it does not exists:
-                chrCopyNumber_[index].checkOrCreateNotNprofileWithZeros();
-                //cout <<  "..Index for chromosome " << currentChr << ": "<< index << "\n";
-			}
-            count ++;
-
             int leftWindow = positionS/step_;
             int rightWindow = positionE/step_ + endShift;
             if (rightWindow<leftWindow)
@@ -4244,13 +4727,8 @@ int GenomeCopyNumber::focusOnCapture (std::string const& captureFile) {
                 ratio = float(mapCount)/windowSize_;
                 chrCopyNumber_[index].setNotNprofileAt(i, ratio);
             }
-		}
-		file.close();
-		cout << "file " << captureFile << " is read\n";
-	} else{
-        cerr << "Error: Unable to open file "+captureFile+"\n";
-        exit(-1);
-	}
+        }
+    }
     //EXCLUDE all windows that are not in capture
     cout << "..Setting read counts to Zero for all windows outside of capture\n";
     vector<ChrCopyNumber>::iterator it=chrCopyNumber_.begin();
@@ -4287,6 +4765,13 @@ void GenomeCopyNumber::setIfLogged(bool isRatioLogged) {
     isRatioLogged_=isRatioLogged;
 }
 
+void GenomeCopyNumber::setAlleleCounting(BAFpileup const* bafpileup, SNPinGenome* snpingenome, int minimalTotalLetterCountPerPosition, int minimalQualityPerPosition) {
+    alleleCountingPileup_ = bafpileup;
+    alleleCountingSNPs_ = snpingenome;
+    minimalTotalLetterCountPerPosition_ = minimalTotalLetterCountPerPosition;
+    minimalQualityPerPosition_ = minimalQualityPerPosition;
+}
+
 void GenomeCopyNumber::setmakingPileup(bool makingPileup_given)
 {
 makingPileup = makingPileup_given;
@@ -4312,6 +4797,27 @@ void* GenomeCopyNumber_readMateFile_wrapper(void *arg)
   return NULL;
 }
 
+void* GenomeCopyNumber_readCopyNumber_wrapper(void *arg)
+{
+  GenomeCopyNumberReadCopyNumberArgWrapper* warg = (GenomeCopyNumberReadCopyNumberArgWrapper*)arg;
+  if (!warg->copyNumberFile.empty()) {
+	warg->genomeCopyNumber.readCopyNumber(warg->copyNumberFile);
+  } else if (!warg->mateFile.empty()) {
+	warg->genomeCopyNumber.readCopyNumber(warg->mateFile, warg->inputFormat, warg->matesOrientation, warg->chrLenFileName, warg->windowSize, warg->step, warg->targetBed);
+  }
+  if (!warg->outputFile.empty()) {
+	warg->genomeCopyNumber.printCopyNumber(warg->outputFile);
+  }
+  return NULL;
+}
+
+void* GenomeCopyNumber_readIndexedBam_wrapper(void *arg)
+{
+  GenomeCopyNumberReadIndexedBamArgWrapper* warg = (GenomeCopyNumberReadIndexedBamArgWrapper*)arg;
+  warg->normalCount = warg->genomeCopyNumber.readIndexedBamReferences(warg->mateFileName, warg->bamIndex, warg->refIDs, warg->matesOrientation, warg->refIndex, warg->refNames, warg->filter, warg->count);
+  return NULL;
+}
+
 void* GenomeCopyNumber_calculateBreakpoint_wrapper(void *arg)
 {
   GenomeCopyNumberCalculateBreakpointArgWrapper* warg = (GenomeCopyNumberCalculateBreakpointArgWrapper*)arg;
@@ -20,6 +20,20 @@
 #include "chisquaredistr.h" //to calculate chisquare distribution
 #include "EntryCNV.h"
 #include "SNPinGenome.h"
+#include "BamReader.h"
+#include "BamIndex.h"
+#include "LineReader.h"
+#include "ContigDictionary.h"
+#include "ReadCountCache.h"
+#include "BinaryProfile.h"
+
+//windows used to count reads from a stream when the window size depends on the number of reads (coefficientOfVariation)
+#define FINE_WINDOW_SIZE 500
+//WES: default maxFragmentLength; with an indexed BAM file, reads starting at most max(maxFragmentLength, TARGET_FLANK) from a target are read
+#define TARGET_FLANK 1000
+
+class BAFpileup;
+class SNPAlleleCounter;
 
 class GenomeCopyNumber
 {
@@ -95,14 +109,20 @@ public:
 
 
 	int findIndex (std::string const& chr);
+	int findIndex (const char* chr, int length); //same for a chromosome name as it is spelled in the input (processChrName() is applied)
 	void fillCGprofile(std::string const& chrFolder);
 
-	ChrCopyNumber getChrCopyNumber(std::string const& chr);
+	ChrCopyNumber& getChrCopyNumber(std::string const& chr);
 	float getMedianCopyNumber();
 	long getTotalNumberOfPairs();
 	float getMedianRatio();
 	int getWindowSize(void);
 	long getNormalNumberOfPairs();
+	void setReadFilter(int minMappingQuality, int excludedFlags); //SAM and BAM reads
+	void setCopyNumberFormat(bool text, bool binary) {isCopyNumberPrintedAsText_ = text; isCopyNumberPrintedAsBinary_ = binary;} //for printCopyNumber(outFile): .cpn text file and/or binary .cpnb file
+	void setReadCountCache(bool readCountCache, std::string const& cacheDir) {readCountCache_ = readCountCache; readCountCacheDir_ = cacheDir;} //WGS: keep the read counts of each file in fine windows in cacheDir, see ReadCountCache
+	void setMaxFragmentLength(int maxFragmentLength) {maxFragmentLength_ = maxFragmentLength;} //WES: longer pairs and reads are not assigned to targets; 0 for no limit
+	ReadFilter const& getReadFilter() const {return readFilter_;}
 	std::vector <EntryCNV> getCNVs ();
     int getPloidy();
 	ChrCopyNumber& getChrCopyNumberAt(int index) {return chrCopyNumber_[index];}
@@ -127,8 +147,12 @@ public:
     int findWinNumber(int position, std::string myName, std::string const& matefile);
     void setWESanalysis(bool WESgiven);
     void setmakingPileup(bool makingPileup_given);
+    void setAlleleCounting(BAFpileup const* bafpileup, SNPinGenome* snpingenome, int minimalTotalLetterCountPerPosition, int minimalQualityPerPosition); //the next pass over a BAM file will also calculate BAF values of snpingenome
     void setIfLogged(bool);
 
+    long readIndexedBamReferences(std::string const& mateFileName, BamIndex const& bamIndex, std::vector<int> const& refIDs, MateOrientation matesOrientation, std::vector<int> const& refIndex, std::vector<std::string> const& refNames, ReadFilter& filter, long& count); //to be called by one thread per chromosome
+
+    void printMemoryUsage(std::string const& stage); //memory of each profile, summed over chromosomes, with the PROFILING messages
     double Percentage_GenomeExplained(int &);
     long double calculateRSS(int ploidy);
     bool isMappUsed();
@@ -143,7 +167,20 @@ private:
     bool isMappUsed_;
     bool isRatioLogged_;
 
-	void fillMyHash(std::string const& mateFileName , std::string const& inputFormat, std::string const& matesOrientation, int windowSize, int step, std::string targetBed = "");
+	long fillMyHash(std::string const& mateFileName , std::string const& inputFormat, std::string const& matesOrientation, int windowSize, int step, std::string targetBed = ""); //returns the number of lines or records read
+	int processPairedRead(MateOrientation matesOrientation, int index, char orient1, char orient2, int left, int right, int insert_size, int& prevInd);
+	int processSingleEndRead(int index, int left, int read_Size, int& prevInd);
+	int processSAMRead(MateOrientation matesOrientation, const char* line, int length, int& prevInd); //a SAM line without its '\n'
+	int processBamRecord(BamRecord const& record, MateOrientation matesOrientation, std::vector<int> const& refIndex, std::vector<std::string> const& refNames, int& prevInd);
+	//read counting loops, also reporting their throughput with PROFILE_TRACE
+	long countSAMReads(LineReader& reader, MateOrientation matesOrientation, long& count, int& prevInd);
+	long countBamReads(BamReader& bamReader, MateOrientation matesOrientation, std::vector<int> const& refIndex, std::vector<std::string> const& refNames, int refID, SNPAlleleCounter* counter, ReadFilter& filter, long& count, int& prevInd); //refID: stop after the reads of this reference, or NA
+	long countTargetedBamReads(BamReader& bamReader, BamIndex const& bamIndex, MateOrientation matesOrientation, std::vector<int> const& refIndex, std::vector<std::string> const& refNames, int refID, std::vector<std::pair<int, int> > const& regions, ReadFilter& filter, long& count, int& prevInd); //WES: reads of refID starting in the regions only
+	void readBinaryCopyNumber(std::string const& inFile);
+	void printBinaryCopyNumber(std::string const& outFile);
+	long fillMyHashWithCountCache(std::string const& mateFileName, std::string const& inputFormat, std::string const& matesOrientation, int windowSize, int step); //NA if mateFileName cannot have a cache
+	long fillMyHashFromIndexedBam(std::string const& mateFileName, BamIndex const& bamIndex, MateOrientation matesOrientation, std::vector<int> const& refIndex, std::vector<std::string> const& refNames, long& count);
+	void getTargetedRegions(int index, std::vector<std::pair<int, int> >& regions); //0-based [start, end) intervals covering the targets of a chromosome and their flanks
 	int windowSize_;
 	int step_;
 	long totalNumberOfPairs_;
@@ -163,6 +200,19 @@ private:
 	std::string pathToSamtools_;
 	std::string pathToSambamba_;
 	std::string SambambaThreads_;
+	BAFpileup const* alleleCountingPileup_;
+	SNPinGenome* alleleCountingSNPs_; //NULL unless SNPs are genotyped while counting reads
+	int minimalTotalLetterCountPerPosition_;
+	int minimalQualityPerPosition_;
+	ReadFilter readFilter_; //options and rejection counts of the last file read
+	bool readCountCache_;
+	std::string readCountCacheDir_;
+	int maxFragmentLength_;
+	bool isCopyNumberPrintedAsText_;
+	bool isCopyNumberPrintedAsBinary_;
+
+	ContigDictionary contigs_; //chromosomesInd_ for findIndex(const char*, int), see indexChromosomeNames()
+	void indexChromosomeNames(); //to be called before reading a file, once chromosomesInd_ is complete
 };
 #endif
 
@@ -199,6 +249,42 @@ struct GenomeCopyNumberReadMateFileArgWrapper : public ThreadArg {
 
 extern void* GenomeCopyNumber_readMateFile_wrapper(void *arg);
 
+//reads a sample or a control: from a .cpn file (copyNumberFile) or from reads (mateFile), then prints the profile to outputFile
+//each step is skipped when the corresponding file name is empty
+struct GenomeCopyNumberReadCopyNumberArgWrapper : public ThreadArg {
+  GenomeCopyNumber& genomeCopyNumber;
+  std::string copyNumberFile;
+  std::string mateFile;
+  std::string inputFormat;
+  std::string matesOrientation;
+  std::string chrLenFileName;
+  int windowSize;
+  int step;
+  std::string targetBed;
+  std::string outputFile;
+
+  GenomeCopyNumberReadCopyNumberArgWrapper(GenomeCopyNumber& genomeCopyNumber, std::string const& copyNumberFile, std::string const& mateFile, std::string const& inputFormat, std::string const& matesOrientation, std::string const& chrLenFileName, int windowSize, int step, std::string const& targetBed, std::string const& outputFile) : genomeCopyNumber(genomeCopyNumber), copyNumberFile(copyNumberFile), mateFile(mateFile), inputFormat(inputFormat), matesOrientation(matesOrientation), chrLenFileName(chrLenFileName), windowSize(windowSize), step(step), targetBed(targetBed), outputFile(outputFile) { }
+};
+
+extern void* GenomeCopyNumber_readCopyNumber_wrapper(void *arg);
+
+struct GenomeCopyNumberReadIndexedBamArgWrapper : public ThreadArg {
+  GenomeCopyNumber& genomeCopyNumber;
+  std::string mateFileName;
+  BamIndex const& bamIndex;
+  std::vector<int> refIDs; //BAM references corresponding to one chromosome
+  MateOrientation matesOrientation;
+  std::vector<int> const& refIndex;
+  std::vector<std::string> const& refNames;
+  ReadFilter filter; //with the rejection counts of this task
+  long count;
+  long normalCount;
+
+  GenomeCopyNumberReadIndexedBamArgWrapper(GenomeCopyNumber& genomeCopyNumber, std::string const& mateFileName, BamIndex const& bamIndex, MateOrientation matesOrientation, std::vector<int> const& refIndex, std::vector<std::string> const& refNames, ReadFilter const& filter) : genomeCopyNumber(genomeCopyNumber), mateFileName(mateFileName), bamIndex(bamIndex), matesOrientation(matesOrientation), refIndex(refIndex), refNames(refNames), filter(filter), count(0), normalCount(0) { }
+};
+
+extern void* GenomeCopyNumber_readIndexedBam_wrapper(void *arg);
+
 #endif // header guard
 
 
@@ -0,0 +1,266 @@
+/*************************************************************************
+Copyright (c) 2010-2016, Valentina BOEVA.
+
+>>> SOURCE LICENSE >>>
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation (www.fsf.org); either version 2 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+A copy of the GNU General Public License is available at
+http://www.fsf.org/licensing/licenses
+
+>>> END OF LICENSE >>>
+*************************************************************************/
+
+#include "GzipReader.h"
+#include "ThreadPool.h"
+
+#include <iostream>
+#include <string.h>
+
+using namespace std;
+
+GzipReader::GzipReader() : isBGZF_(false), file_(NULL), memberStarted_(false), firstMember_(true), data_(NULL), chunkLength_(0), chunkOffset_(0),
+    eof_(false), error_(false), threaded_(false), filledChunks_(0), nextToFill_(0), nextToConsume_(0), holdingChunk_(false), stop_(false)
+{
+    memset(&zs_, 0, sizeof(zs_));
+    pthread_mutex_init(&mutex_, NULL);
+    pthread_cond_init(&chunkReady_, NULL);
+    pthread_cond_init(&chunkFree_, NULL);
+}
+
+GzipReader::~GzipReader()
+{
+    close();
+    pthread_cond_destroy(&chunkFree_);
+    pthread_cond_destroy(&chunkReady_);
+    pthread_mutex_destroy(&mutex_);
+}
+
+bool GzipReader::open(std::string const& fileName, bool multithreaded)
+{
+    close();
+    fileName_ = fileName;
+    isBGZF_ = BGZFReader::isBGZF(fileName);
+    if (isBGZF_) {
+        return bgzf_.open(fileName, multithreaded);
+    }
+
+    file_ = BGZFReader::openInput(fileName);
+    if (!file_) {
+        return false;
+    }
+    memset(&zs_, 0, sizeof(zs_));
+    //15+32: detect gzip or zlib header automatically
+    if (inflateInit2(&zs_, 15 + 32) != Z_OK) {
+        fclose(file_);
+        file_ = NULL;
+        return false;
+    }
+    memberStarted_ = false;
+    firstMember_ = true;
+    compressed_.resize(GZIP_BUFFER_SIZE);
+    data_ = NULL;
+    chunkLength_ = 0;
+    chunkOffset_ = 0;
+    eof_ = false;
+    error_ = false;
+    if (multithreaded) {
+        startThread();
+    }
+    if (!threaded_) {
+        uncompressed_.resize(GZIP_BUFFER_SIZE);
+    }
+    return true;
+}
+
+void GzipReader::close()
+{
+    if (isBGZF_) {
+        bgzf_.close();
+        isBGZF_ = false;
+    }
+    stopThread();
+    if (file_) {
+        inflateEnd(&zs_);
+        fclose(file_);
+        file_ = NULL;
+    }
+}
+
+void GzipReader::startThread()
+{
+    ThreadPoolManager* thrPoolManager = ThreadPoolManager::getInstance();
+    if (!thrPoolManager || !thrPoolManager->reserveOneThread()) {
+        return;
+    }
+    chunks_.resize(GZIP_CHUNKS);
+    for (size_t i = 0; i < chunks_.size(); i++) {
+        chunks_[i].data.resize(GZIP_BUFFER_SIZE);
+        chunks_[i].length = 0;
+    }
+    filledChunks_ = 0;
+    nextToFill_ = 0;
+    nextToConsume_ = 0;
+    holdingChunk_ = false;
+    stop_ = false;
+    if (pthread_create(&thread_, NULL, GzipReader::inflateThread, this) != 0) {
+        thrPoolManager->releaseOneThread();
+        chunks_.clear();
+        return;
+    }
+    threaded_ = true;
+}
+
+void GzipReader::stopThread()
+{
+    if (!threaded_) {
+        return;
+    }
+    pthread_mutex_lock(&mutex_);
+    stop_ = true;
+    pthread_cond_broadcast(&chunkFree_);
+    pthread_mutex_unlock(&mutex_);
+    pthread_join(thread_, NULL);
+    ThreadPoolManager::getInstance()->releaseOneThread();
+    threaded_ = false;
+    chunks_.clear();
+}
+
+void* GzipReader::inflateThread(void* arg)
+{
+    ((GzipReader*)arg)->inflateLoop();
+    return NULL;
+}
+
+void GzipReader::inflateLoop()
+{
+    pthread_mutex_lock(&mutex_);
+    for (;;) {
+        while (!stop_ && filledChunks_ == (int)chunks_.size()) {
+            pthread_cond_wait(&chunkFree_, &mutex_);
+        }
+        if (stop_) {
+            break;
+        }
+        Chunk& chunk = chunks_[nextToFill_ % chunks_.size()];
+        pthread_mutex_unlock(&mutex_);
+
+        //only this thread touches the zlib stream
+        int length = inflateChunk(&chunk.data[0], GZIP_BUFFER_SIZE);
+
+        pthread_mutex_lock(&mutex_);
+        chunk.length = length;
+        nextToFill_++;
+        filledChunks_++;
+        pthread_cond_broadcast(&chunkReady_);
+        if (length <= 0) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mutex_);
+}
+
+int GzipReader::inflateChunk(char* output, int capacity)
+{
+    int produced = 0;
+    while (produced < capacity) {
+        if (zs_.avail_in == 0) {
+            size_t count = fread(&compressed_[0], 1, compressed_.size(), file_);
+            if (count == 0) {
+                if (ferror(file_) || memberStarted_) {
+                    return -1;
+                }
+                break;
+            }
+            zs_.next_in = (Bytef*)&compressed_[0];
+            zs_.avail_in = (uInt)count;
+        }
+        if (!memberStarted_) {
+            //a file may be a concatenation of gzip members; anything else after the first one is ignored, as gzip does
+            if (!firstMember_ && zs_.next_in[0] != 31) {
+                zs_.avail_in = 0;
+                fseek(file_, 0, SEEK_END);
+                break;
+            }
+            inflateReset(&zs_);
+            memberStarted_ = true;
+            firstMember_ = false;
+        }
+        zs_.next_out = (Bytef*)(output + produced);
+        zs_.avail_out = (uInt)(capacity - produced);
+        int status = inflate(&zs_, Z_NO_FLUSH);
+        produced = capacity - (int)zs_.avail_out;
+        if (status == Z_STREAM_END) {
+            memberStarted_ = false;
+        } else if (status != Z_OK && status != Z_BUF_ERROR) {
+            return -1;
+        }
+    }
+    return produced;
+}
+
+bool GzipReader::nextChunk()
+{
+    if (!threaded_) {
+        chunkLength_ = inflateChunk(&uncompressed_[0], GZIP_BUFFER_SIZE);
+        chunkOffset_ = 0;
+        data_ = &uncompressed_[0];
+    } else {
+        pthread_mutex_lock(&mutex_);
+        if (holdingChunk_) {
+            nextToConsume_++;
+            filledChunks_--;
+            holdingChunk_ = false;
+            pthread_cond_broadcast(&chunkFree_);
+        }
+        while (filledChunks_ == 0) {
+            pthread_cond_wait(&chunkReady_, &mutex_);
+        }
+        Chunk& chunk = chunks_[nextToConsume_ % chunks_.size()];
+        chunkLength_ = chunk.length;
+        chunkOffset_ = 0;
+        data_ = &chunk.data[0];
+        //the last chunk (end of file or error) is never released: the thread has stopped after it
+        holdingChunk_ = chunk.length > 0;
+        pthread_mutex_unlock(&mutex_);
+    }
+    if (chunkLength_ < 0) {
+        cerr << "Error: " << fileName_ << " is truncated or is not a gzip file\n";
+        error_ = true;
+        chunkLength_ = 0;
+        return false;
+    }
+    if (chunkLength_ == 0) {
+        eof_ = true;
+        return false;
+    }
+    return true;
+}
+
+int GzipReader::read(void* data, int length)
+{
+    if (isBGZF_) {
+        return bgzf_.read(data, length);
+    }
+    char* output = (char*)data;
+    int bytesRead = 0;
+    while (bytesRead < length) {
+        if (chunkOffset_ >= chunkLength_) {
+            if (eof_ || error_ || !nextChunk()) {
+                return error_ ? -1 : bytesRead;
+            }
+        }
+        int toCopy = min(length - bytesRead, chunkLength_ - chunkOffset_);
+        memcpy(output + bytesRead, data_ + chunkOffset_, toCopy);
+        chunkOffset_ += toCopy;
+        bytesRead += toCopy;
+    }
+    return bytesRead;
+}
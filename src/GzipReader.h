@@ -0,0 +1,78 @@
+#ifndef GZIPREADER_H
+#define GZIPREADER_H
+
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <pthread.h>
+#include <zlib.h>
+
+#include "BGZFReader.h"
+
+// Reader for gzip compressed text files (.gz), used instead of piping them through "gzip -cd".
+// Files compressed with bgzip are handed to BGZFReader, which can inflate blocks on several threads.
+// Other gzip files are a single deflate stream (or a concatenation of them); in multithreaded mode,
+// one thread taken from the ThreadPoolManager budget inflates the stream ahead of the consumer.
+
+#define GZIP_BUFFER_SIZE 1048576
+#define GZIP_CHUNKS 4
+
+class GzipReader
+{
+    public:
+        GzipReader();
+        virtual ~GzipReader();
+
+        bool open(std::string const& fileName, bool multithreaded = false);
+        void close();
+        bool isOpen() const {return isBGZF_ ? bgzf_.isOpen() : file_ != NULL;}
+        const std::string& getFileName() const {return fileName_;}
+
+        int read(void* data, int length); //returns the number of bytes read, 0 at the end of file, -1 in case of error
+        bool isError() const {return isBGZF_ ? bgzf_.isError() : error_;}
+
+    protected:
+    private:
+        struct Chunk {
+            std::vector<char> data;
+            int length; //0 at the end of file, -1 in case of error
+        };
+
+        bool nextChunk();
+        int inflateChunk(char* output, int capacity);
+        void startThread();
+        void stopThread();
+        void inflateLoop();
+        static void* inflateThread(void* arg);
+
+        std::string fileName_;
+        BGZFReader bgzf_;
+        bool isBGZF_;
+
+        FILE* file_;
+        z_stream zs_;
+        bool memberStarted_; //true while inside a gzip member
+        bool firstMember_;
+        std::vector<char> compressed_;
+        std::vector<char> uncompressed_;
+        const char* data_; //current chunk of uncompressed data
+        int chunkLength_;
+        int chunkOffset_;
+        bool eof_;
+        bool error_;
+
+        //multithreaded mode: chunks_ is a ring buffer filled by the inflating thread
+        bool threaded_;
+        pthread_t thread_;
+        std::vector<Chunk> chunks_;
+        pthread_mutex_t mutex_;
+        pthread_cond_t chunkReady_;
+        pthread_cond_t chunkFree_;
+        int filledChunks_;
+        long nextToFill_;
+        long nextToConsume_;
+        bool holdingChunk_;
+        bool stop_;
+};
+
+#endif // GZIPREADER_H
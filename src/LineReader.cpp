@@ -0,0 +1,231 @@
+/*************************************************************************
+Copyright (c) 2010-2016, Valentina BOEVA.
+
+>>> SOURCE LICENSE >>>
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation (www.fsf.org); either version 2 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+A copy of the GNU General Public License is available at
+http://www.fsf.org/licensing/licenses
+
+>>> END OF LICENSE >>>
+*************************************************************************/
+
+#include "LineReader.h"
+
+#include <iostream>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+using namespace std;
+
+LineReader::LineReader() : isGzip_(false), fd_(-1), map_(NULL), mapLength_(0), position_(0), buffered_(false), begin_(0), end_(0), eof_(false), error_(false)
+{
+    //ctor
+}
+
+LineReader::~LineReader()
+{
+    close();
+}
+
+bool LineReader::open(std::string const& fileName, bool multithreaded)
+{
+    close();
+    fileName_ = fileName;
+    error_ = false;
+    eof_ = false;
+    begin_ = end_ = 0;
+    position_ = 0;
+
+    if (fileName.size() > 3 && fileName.substr(fileName.size()-3,3).compare(".gz")==0) {
+        if (!gzip_.open(fileName, multithreaded)) {
+            return false;
+        }
+        isGzip_ = true;
+        buffered_ = true;
+        buffer_.resize(LINE_READER_BUFFER_SIZE + 1); //+1 for the null character of the last line
+        return true;
+    }
+
+    if (fileName.compare("-")==0) {
+        fd_ = 0;
+    } else {
+        fd_ = ::open(fileName.c_str(), O_RDONLY);
+        if (fd_ < 0) {
+            return false;
+        }
+    }
+
+    struct stat info;
+    bool hasInfo = fstat(fd_, &info) == 0;
+    if (hasInfo && S_ISREG(info.st_mode)) {
+        mapLength_ = (size_t)info.st_size;
+#if !defined(_WIN32)
+        if (mapLength_ == 0) {
+            buffered_ = false;
+            return true;
+        }
+        void* map = mmap(NULL, mapLength_, PROT_READ, MAP_PRIVATE, fd_, 0);
+        if (map != MAP_FAILED) {
+            map_ = (char*)map;
+            madvise(map_, mapLength_, MADV_SEQUENTIAL);
+            buffered_ = false;
+            return true;
+        }
+#endif
+        mapLength_ = 0;
+    }
+
+    //pipe, FIFO, standard input or a file that could not be mapped
+#if defined(F_SETPIPE_SZ)
+    if (hasInfo && S_ISFIFO(info.st_mode)) {
+        fcntl(fd_, F_SETPIPE_SZ, LINE_READER_PIPE_SIZE); //fewer context switches with the writer; failure is harmless
+    }
+#endif
+    buffered_ = true;
+    buffer_.resize(LINE_READER_BUFFER_SIZE + 1);
+    return true;
+}
+
+bool LineReader::isStream(std::string const& fileName)
+{
+    if (fileName.compare("-")==0) {
+        return true;
+    }
+    struct stat info;
+    return stat(fileName.c_str(), &info) == 0 && (S_ISFIFO(info.st_mode) || S_ISCHR(info.st_mode) || S_ISSOCK(info.st_mode));
+}
+
+void LineReader::close()
+{
+#if !defined(_WIN32)
+    if (map_) {
+        munmap(map_, mapLength_);
+    }
+#endif
+    map_ = NULL;
+    mapLength_ = 0;
+    if (fd_ > 0) {
+        ::close(fd_);
+    }
+    fd_ = -1;
+    if (isGzip_) {
+        gzip_.close();
+        isGzip_ = false;
+    }
+    buffered_ = false;
+}
+
+int LineReader::readMore(char* buffer, int length)
+{
+    if (isGzip_) {
+        return gzip_.read(buffer, length);
+    }
+    for (;;) {
+        int count = (int)::read(fd_, buffer, length);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count < 0) {
+            cerr << "Error: unable to read " << fileName_ << "\n";
+        }
+        return count;
+    }
+}
+
+bool LineReader::next(const char*& line, int& length)
+{
+    if (!buffered_) {
+        if (position_ >= mapLength_) {
+            return false;
+        }
+        const char* start = map_ + position_;
+        const char* newline = (const char*)memchr(start, '\n', mapLength_ - position_);
+        length = newline ? int(newline - start) : int(mapLength_ - position_);
+        position_ += length + 1;
+        line = start;
+        return true;
+    }
+
+    for (;;) {
+        char* start = &buffer_[begin_];
+        char* newline = (char*)memchr(start, '\n', end_ - begin_);
+        if (newline) {
+            line = start;
+            length = int(newline - start);
+            begin_ += length + 1;
+            return true;
+        }
+        if (eof_) {
+            if (end_ > begin_) {
+                line = start;
+                length = int(end_ - begin_);
+                begin_ = end_;
+                return true;
+            }
+            return false;
+        }
+        //keep the beginning of the line and read ahead
+        if (begin_ > 0) {
+            memmove(&buffer_[0], start, end_ - begin_);
+            end_ -= begin_;
+            begin_ = 0;
+        }
+        size_t capacity = buffer_.size() - 1;
+        if (end_ == capacity) {
+            buffer_.resize(2 * capacity + 1); //a line longer than the buffer
+            capacity = buffer_.size() - 1;
+        }
+        int count = readMore(&buffer_[end_], int(min(capacity - end_, (size_t)LINE_READER_BUFFER_SIZE)));
+        if (count < 0) {
+            error_ = true;
+            eof_ = true;
+        } else if (count == 0) {
+            eof_ = true;
+        } else {
+            end_ += count;
+        }
+    }
+}
+
+char* LineReader::nextLine(int* length)
+{
+    const char* line;
+    int lineLength;
+    if (!next(line, lineLength)) {
+        return NULL;
+    }
+    if (length) {
+        *length = lineLength;
+    }
+    if (buffered_) {
+        //the line is in our own buffer: terminate it in place (over the '\n' or after the last character)
+        char* writable = (char*)line;
+        writable[lineLength] = 0;
+        return writable;
+    }
+    if ((int)scratch_.size() < lineLength + 1) {
+        scratch_.resize(lineLength + 1);
+    }
+    memcpy(&scratch_[0], line, lineLength);
+    scratch_[lineLength] = 0;
+    return &scratch_[0];
+}
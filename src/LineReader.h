@@ -0,0 +1,60 @@
+#ifndef LINEREADER_H
+#define LINEREADER_H
+
+#include <string>
+#include <vector>
+
+#include "GzipReader.h"
+
+// Line iterator over text inputs:
+// - regular files are memory-mapped and lines are returned as views into the mapping (no copy);
+// - pipes, FIFOs and standard input ("-") are read through a large read-ahead buffer;
+// - .gz files are inflated by GzipReader into the same buffer.
+// next() gives a read-only view of the line without its '\n'; nextLine() gives a writable
+// null-terminated line for the parsers which tokenize in place with split(char*, ...).
+
+#define LINE_READER_BUFFER_SIZE 4194304
+#define LINE_READER_PIPE_SIZE 1048576
+
+class LineReader
+{
+    public:
+        LineReader();
+        virtual ~LineReader();
+
+        bool open(std::string const& fileName, bool multithreaded = false); //multithreaded: see GzipReader
+        void close();
+        const std::string& getFileName() const {return fileName_;}
+
+        bool next(const char*& line, int& length); //view valid until the next call; false at the end of file
+        char* nextLine(int* length = NULL); //null-terminated line that can be modified; NULL at the end of file
+        bool isError() const {return error_ || (isGzip_ && gzip_.isError());}
+
+        static bool isStream(std::string const& fileName); //standard input ("-"), a pipe or a FIFO: can be read only once, from the beginning
+
+    protected:
+    private:
+        int readMore(char* buffer, int length);
+
+        std::string fileName_;
+        bool isGzip_;
+        GzipReader gzip_;
+        int fd_;
+
+        //memory-mapped mode
+        char* map_;
+        size_t mapLength_;
+        size_t position_;
+        std::vector<char> scratch_;
+
+        //buffered mode (pipes and compressed files)
+        bool buffered_;
+        std::vector<char> buffer_;
+        size_t begin_;
+        size_t end_;
+        bool eof_;
+
+        bool error_;
+};
+
+#endif // LINEREADER_H
@@ -0,0 +1,220 @@
+/*************************************************************************
+Copyright (c) 2010-2016, Valentina BOEVA.
+
+>>> SOURCE LICENSE >>>
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation (www.fsf.org); either version 2 of the
+License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+A copy of the GNU General Public License is available at
+http://www.fsf.org/licensing/licenses
+
+>>> END OF LICENSE >>>
+*************************************************************************/
+
+#include "ReadCountCache.h"
+#include "LineReader.h"
+
+#include <sstream>
+#include <iomanip>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
+using namespace std;
+
+//file layout (native byte order): magic, key length and key, totals, number of chromosomes,
+//then for each chromosome its number of windows, the length of its encoded counts and the counts
+static const char CACHE_MAGIC[4] = {'F', 'R', 'C', 1};
+
+static bool readUInt32(FILE* file, uint32_t& value)
+{
+    return fread(&value, sizeof(value), 1, file) == 1;
+}
+
+static bool readInt64(FILE* file, long& value)
+{
+    int64_t v;
+    if (fread(&v, sizeof(v), 1, file) != 1) {
+        return false;
+    }
+    value = (long)v;
+    return true;
+}
+
+static bool writeUInt32(FILE* file, uint32_t value)
+{
+    return fwrite(&value, sizeof(value), 1, file) == 1;
+}
+
+static bool writeInt64(FILE* file, long value)
+{
+    int64_t v = value;
+    return fwrite(&v, sizeof(v), 1, file) == 1;
+}
+
+ReadCountCache::ReadCountCache() : count_(0), normalCount_(0), rejectedByFlags_(0), rejectedByMappingQuality_(0)
+{
+}
+
+std::string ReadCountCache::getFileName(std::string const& mateFileName, std::string const& cacheDir)
+{
+    //files with the same name in different directories get different caches
+    char* path = realpath(mateFileName.c_str(), NULL);
+    string fullPath = path ? path : mateFileName;
+    free(path);
+    uint32_t h = 2166136261u; //FNV-1a
+    for (size_t i = 0; i < fullPath.size(); i++) {
+        h = (h ^ (unsigned char)fullPath[i]) * 16777619u;
+    }
+    size_t slash = mateFileName.find_last_of("/\\");
+    ostringstream fileName;
+    fileName << cacheDir;
+    if (!cacheDir.empty() && cacheDir[cacheDir.size()-1] != '/' && cacheDir[cacheDir.size()-1] != '\\') {
+        fileName << '/';
+    }
+    fileName << (slash == string::npos ? mateFileName : mateFileName.substr(slash+1));
+    fileName << "." << hex << setw(8) << setfill('0') << h << READ_COUNT_CACHE_EXTENSION;
+    return fileName.str();
+}
+
+std::string ReadCountCache::makeKey(std::string const& mateFileName, std::string const& inputFormat, std::string const& matesOrientation, ReadFilter const& filter, std::vector<std::string> const& names, std::vector<int> const& lengths)
+{
+    struct stat info;
+    if (LineReader::isStream(mateFileName) || stat(mateFileName.c_str(), &info) != 0) {
+        return "";
+    }
+    ostringstream key;
+    key << READ_COUNT_CACHE_RESOLUTION << "bp";
+    key << "\tsize=" << (long)info.st_size << "\tmtime=" << (long)info.st_mtime;
+    key << "\tinputFormat=" << inputFormat << "\tmateOrientation=" << matesOrientation;
+    key << "\tminMappingQuality=" << filter.minMappingQuality << "\texcludeFlags=" << filter.excludedFlags;
+    for (int i = 0; i < (int)names.size(); i++) {
+        key << "\t" << names[i] << ":" << lengths[i];
+    }
+    return key.str();
+}
+
+bool ReadCountCache::load(std::string const& fileName, std::string const& key)
+{
+    FILE* file = fopen(fileName.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    bool ok = false;
+    char magic[4];
+    uint32_t keyLength;
+    if (fread(magic, 1, 4, file) == 4 && memcmp(magic, CACHE_MAGIC, 4) == 0 && readUInt32(file, keyLength) && keyLength == key.size()) {
+        string fileKey(keyLength, '\0');
+        uint32_t numberOfChromosomes;
+        ok = fread(&fileKey[0], 1, keyLength, file) == keyLength && fileKey.compare(key) == 0
+            && readInt64(file, count_) && readInt64(file, normalCount_) && readInt64(file, rejectedByFlags_) && readInt64(file, rejectedByMappingQuality_)
+            && readUInt32(file, numberOfChromosomes);
+        if (ok) {
+            counts_.assign(numberOfChromosomes, vector<unsigned int>());
+        }
+        vector<unsigned char> buffer;
+        for (uint32_t i = 0; ok && i < numberOfChromosomes; i++) {
+            uint32_t numberOfWindows, byteLength;
+            ok = readUInt32(file, numberOfWindows) && readUInt32(file, byteLength) && numberOfWindows <= byteLength;
+            if (!ok) {
+                break;
+            }
+            buffer.resize(byteLength);
+            ok = byteLength == 0 || fread(&buffer[0], 1, byteLength, file) == byteLength;
+            vector<unsigned int>& counts = counts_[i];
+            counts.reserve(numberOfWindows);
+            unsigned int value = 0;
+            int shift = 0;
+            for (uint32_t j = 0; ok && j < byteLength; j++) {
+                value |= (unsigned int)(buffer[j] & 0x7F) << shift;
+                if (buffer[j] & 0x80) {
+                    shift += 7;
+                    ok = shift < 32;
+                } else {
+                    counts.push_back(value);
+                    value = 0;
+                    shift = 0;
+                }
+            }
+            ok = ok && shift == 0 && counts.size() == numberOfWindows;
+        }
+    }
+    fclose(file);
+    if (!ok) {
+        counts_.clear();
+    }
+    return ok;
+}
+
+bool ReadCountCache::save(std::string const& fileName, std::string const& key) const
+{
+    //the sample and the control can be the same file: each thread writes its own copy, then renames it
+    ostringstream tmpFileName;
+    tmpFileName << fileName << ".tmp" << pthread_self();
+    FILE* file = fopen(tmpFileName.str().c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = fwrite(CACHE_MAGIC, 1, 4, file) == 4 && writeUInt32(file, (uint32_t)key.size()) && fwrite(key.data(), 1, key.size(), file) == key.size()
+        && writeInt64(file, count_) && writeInt64(file, normalCount_) && writeInt64(file, rejectedByFlags_) && writeInt64(file, rejectedByMappingQuality_)
+        && writeUInt32(file, (uint32_t)counts_.size());
+    vector<unsigned char> buffer;
+    for (int i = 0; ok && i < (int)counts_.size(); i++) {
+        vector<unsigned int> const& counts = counts_[i];
+        buffer.clear();
+        for (int j = 0; j < (int)counts.size(); j++) {
+            unsigned int value = counts[j];
+            while (value >= 0x80) {
+                buffer.push_back((unsigned char)(value | 0x80));
+                value >>= 7;
+            }
+            buffer.push_back((unsigned char)value);
+        }
+        ok = writeUInt32(file, (uint32_t)counts.size()) && writeUInt32(file, (uint32_t)buffer.size())
+            && (buffer.empty() || fwrite(&buffer[0], 1, buffer.size(), file) == buffer.size());
+    }
+    ok = (fclose(file) == 0) && ok;
+    if (ok) {
+        ok = rename(tmpFileName.str().c_str(), fileName.c_str()) == 0;
+    }
+    if (!ok) {
+        remove(tmpFileName.str().c_str());
+    }
+    return ok;
+}
+
+void ReadCountCache::setCounts(int index, std::vector<float> const& counts)
+{
+    if (index >= (int)counts_.size()) {
+        counts_.resize(index+1);
+    }
+    vector<unsigned int>& fineCounts = counts_[index];
+    fineCounts.resize(counts.size());
+    for (int i = 0; i < (int)counts.size(); i++) {
+        fineCounts[i] = counts[i] > 0 ? (unsigned int)counts[i] : 0;
+    }
+}
+
+void ReadCountCache::setTotals(long count, long normalCount, ReadFilter const& filter)
+{
+    count_ = count;
+    normalCount_ = normalCount;
+    rejectedByFlags_ = filter.rejectedByFlags;
+    rejectedByMappingQuality_ = filter.rejectedByMappingQuality;
+}
+
+void ReadCountCache::getRejectedCounts(ReadFilter& filter) const
+{
+    filter.rejectedByFlags = rejectedByFlags_;
+    filter.rejectedByMappingQuality = rejectedByMappingQuality_;
+}
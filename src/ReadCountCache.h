@@ -0,0 +1,47 @@
+#ifndef READCOUNTCACHE_H
+#define READCOUNTCACHE_H
+
+#include <string>
+#include <vector>
+
+#include "myFunc.h"
+
+// Read counts of a mateFile in fine windows, saved in a cache directory (readCountCacheDir, by
+// default outputDir) the first time it is read, so that a later run with another window, step or
+// coefficientOfVariation sums the fine windows instead of reading the file again (option readCountCache=TRUE).
+// The cache is only used for the same file (size and modification time), input format, mate
+// orientation, read filters and chromosome lengths; it is written again otherwise.
+// Counts are stored as variable-length integers: one byte for the windows with less than 128 reads.
+
+#define READ_COUNT_CACHE_RESOLUTION 100
+#define READ_COUNT_CACHE_EXTENSION ".freec_counts"
+
+class ReadCountCache
+{
+    public:
+        ReadCountCache();
+
+        static std::string getFileName(std::string const& mateFileName, std::string const& cacheDir); //cacheDir/name.<hash of the full path>.freec_counts
+        //identifies what the counts depend on; empty if mateFileName cannot be used with a cache (e.g. standard input)
+        static std::string makeKey(std::string const& mateFileName, std::string const& inputFormat, std::string const& matesOrientation, ReadFilter const& filter, std::vector<std::string> const& names, std::vector<int> const& lengths);
+
+        bool load(std::string const& fileName, std::string const& key); //false if there is no cache or if it was made with another key
+        bool save(std::string const& fileName, std::string const& key) const;
+
+        void setCounts(int index, std::vector<float> const& counts); //fine windows of the chromosome at index
+        const std::vector<unsigned int>& getCounts(int index) const {return counts_[index];}
+        void setTotals(long count, long normalCount, ReadFilter const& filter);
+        long getCount() const {return count_;} //lines or records read
+        long getNormalCount() const {return normalCount_;} //reads counted
+        void getRejectedCounts(ReadFilter& filter) const;
+
+    protected:
+    private:
+        std::vector<std::vector<unsigned int> > counts_;
+        long count_;
+        long normalCount_;
+        long rejectedByFlags_;
+        long rejectedByMappingQuality_;
+};
+
+#endif // READCOUNTCACHE_H
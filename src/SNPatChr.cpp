@@ -56,6 +56,10 @@ char SNPatChr::getNucleotideAt(int index) {
     return SNPpositionArray_[index].getNucleotide();
 }
 
+char SNPatChr::getReferenceAt(int index) {
+    return SNPpositionArray_[index].getReference();
+}
+
 void SNPatChr::setValueAt(int index,float value) {
     SNPpositionArray_[index].setFrequency(value);
 }
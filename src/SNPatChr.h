@@ -17,6 +17,7 @@ class SNPatChr
         const std::string& getChromosome ();
         int getPositionAt (int index);
         char getNucleotideAt(int index);
+        char getReferenceAt(int index);
         float getValueAt(int index);
         float getStatusAt(int index);
         void setValueAt(int positionCount,float value);
@@ -31,6 +31,9 @@ SNPinGenome::SNPinGenome() : SNP_atChr_(NULL)
 void SNPinGenome::setSNPChr(std::vector<SNPatChr>* SNP_atChr_)
 {
   this->SNP_atChr_ = new std::vector<SNPatChr>(*SNP_atChr_);
+  contigs_.clear();
+  for (int i = 0; i < (int)this->SNP_atChr_->size(); i++)
+    contigs_.add((*this->SNP_atChr_)[i].getChromosome(), i);
 }
 
 int SNPinGenome::processSNPLine(bool isVCF, char * line, string & myChr, int & index,int &previousPos) {
@@ -50,6 +53,7 @@ int SNPinGenome::processSNPLine(bool isVCF, char * line, string & myChr, int & i
         if (chr.compare(myChr)!=0) {
             index++;
             SNP_atChr_->push_back(SNPatChr(chr));
+            contigs_.add(chr, index);
             myChr = chr;
         }
         int position = atoi(strs[1]);
@@ -63,7 +67,7 @@ int SNPinGenome::processSNPLine(bool isVCF, char * line, string & myChr, int & i
                     }
                     return 0;
                 } else if (strlen(strs[3])==1 && strlen(strs[4])<10) {
-                        (*SNP_atChr_)[index].push_SNP(SNPposition(position,strs[4])); //if VCF
+                        (*SNP_atChr_)[index].push_SNP(SNPposition(position,strs[4],strs[3])); //if VCF
                         return 1;
                 } else {return 0;}
             } else {
@@ -95,6 +99,8 @@ void SNPinGenome::readSNPs(std::string const& inFile)
     int index = 0;
     string myChr = "1";
     SNP_atChr_->push_back(SNPatChr("1"));
+    contigs_.clear();
+    contigs_.add("1", 0);
 
     int previousPos = NA;
 
@@ -104,40 +110,26 @@ void SNPinGenome::readSNPs(std::string const& inFile)
 
 	/*if (makingpileup != true)*/
 	{
-        //check whether the file is compressed:
-        bool ifGZ = 0;
-        if (inFile.substr(inFile.size()-3,3).compare(".gz")==0){ifGZ=1;}
         //check whether the file is in VCF format:
         bool ifVCF = 0;
         std::size_t found = inFile.find(".vcf");
         if (found!=std::string::npos) {ifVCF=1;}
 
-        if (ifGZ) {
-            fileSNP.close();
-            FILE *stream;
-            char buffer[MAX_BUFFER];
-            string command = "gzip -cd "+inFile;
-            stream =
-            #if defined(_WIN32)
-                      _popen(command.c_str(), "r");
-            #else
-                    popen(command.c_str(), "r");
-            #endif
-            char *line_buffer;
-            while ((line_buffer = getLine(buffer, MAX_BUFFER, stream, line)) != NULL) {
-              if (line_buffer[0] == '#') continue;
-              count+=processSNPLine(ifVCF,line_buffer,myChr,index,previousPos);
-            }
-            #if defined(_WIN32)
-                    _pclose(stream);
-            #else
-                    pclose(stream);
-            #endif
-        } else {
-            while (std::getline(fileSNP,line)) {
-                if ((!line.length()) || (line[0] == '#')) continue;
-                count+=processSNPLine(ifVCF,(char*)line.c_str(),myChr,index,previousPos);
-            }
+        fileSNP.close();
+        LineReader reader;
+        if (!reader.open(inFile, true)) {
+            cerr << "Error: unable to open "+inFile+"\n" ;
+            exit(-1);
+        }
+        char *line_buffer;
+        int length;
+        while ((line_buffer = reader.nextLine(&length)) != NULL) {
+            if ((!length) || (line_buffer[0] == '#')) continue;
+            count+=processSNPLine(ifVCF,line_buffer,myChr,index,previousPos);
+        }
+        if (reader.isError()) {
+            cerr << "Error: FREEC was not able to read "<< inFile << " until the end\n";
+            exit(-1);
         }
     } /*else
     {
@@ -233,7 +225,7 @@ void SNPinGenome::perform(std::string const& mateFile, const std::string& inputF
 	cout << "..Done" << std::endl;
 }
 
-long SNPinGenome::processPileUPLine(int & positionCount, char* line, string & oldChr, int & sNPpositionToProceed,int minimalTotalLetterCountPerPosition,int & index, int minimalQualityPerPosition, GenomeCopyNumber* p_genomeCopyNumber) {
+long SNPinGenome::processPileUPLine(int & positionCount, char* line, string & oldChr, int & sNPpositionToProceed,int minimalTotalLetterCountPerPosition,int & index, int minimalQualityPerPosition, GenomeCopyNumber* p_genomeCopyNumber, int & exonCursor) {
 
     if (*line == 0) return 0;
     if (line[0] == '#') return 0;
@@ -271,9 +263,7 @@ long SNPinGenome::processPileUPLine(int & positionCount, char* line, string & ol
     if (CopyNumberFromPileup_ == true)     {
         if (WESanalysis_ == false)     {
             if (p_genomeCopyNumber) {
-                string chr = strs[0];
-                processChrName(chr);
-                int lindex = p_genomeCopyNumber->findIndex(chr);
+                int lindex = p_genomeCopyNumber->findIndex(strs[0], strlen(strs[0]));
                 if (lindex != NA) {
                     if (valueToReturn = strccnt(strs[4], '^')) {
                         ChrCopyNumber& chrCopyNumber = p_genomeCopyNumber->getChrCopyNumberAt(lindex);
@@ -285,27 +275,12 @@ long SNPinGenome::processPileUPLine(int & positionCount, char* line, string & ol
             }
         } else {
             if (p_genomeCopyNumber) {
-                string chr = strs[0];
-                 processChrName(chr);
-                int lindex = p_genomeCopyNumber->findIndex(chr);
+                int lindex = p_genomeCopyNumber->findIndex(strs[0], strlen(strs[0]));
                 if (lindex != NA) {
                     if (valueToReturn = strccnt(strs[4], '^')) {
                         ChrCopyNumber& chrCopyNumber = p_genomeCopyNumber->getChrCopyNumberAt(lindex);
-                        int l = 0;
-                        bool leftIsInTheWindow = false;
-                        if ((currentPosition - 1 < chrCopyNumber.getEndAtBin(l) && (currentPosition > (chrCopyNumber.getCoordinateAtBin(l)  ))))   {
-                            leftIsInTheWindow = true;
-                        }  else    {
-                            while ((!((currentPosition - 1 < chrCopyNumber.getEndAtBin(l)) &&
-                                (currentPosition > (chrCopyNumber.getCoordinateAtBin(l) ))))  &&
-                                (l <  chrCopyNumber.getExons_Countchr()))    {
-                                leftIsInTheWindow = false;
-                                l++;
-                            }   if (l < chrCopyNumber.getExons_Countchr() -1 )    {
-                                leftIsInTheWindow = true;
-                            }
-                        }
-                        if (leftIsInTheWindow == true)  {
+                        int l = chrCopyNumber.findExon(currentPosition, 0, exonCursor);
+                        if (l != NA)  {
                             int step = p_genomeCopyNumber->getStep();
                             for (int i=0; i<valueToReturn; i++)
                                 chrCopyNumber.mappedPlusOneAtI(currentPosition,step, l);
@@ -356,21 +331,24 @@ long SNPinGenome::processPileUPLine(int & positionCount, char* line, string & ol
 	return valueToReturn;
 }
 
-void SNPinGenome::readPileUP(FILE* stream, int minimalTotalLetterCountPerPosition, int minimalQualityPerPosition, GenomeCopyNumber* p_genomeCopyNumber) {
+void SNPinGenome::readPileUP(LineReader& reader, int minimalTotalLetterCountPerPosition, int minimalQualityPerPosition, GenomeCopyNumber* p_genomeCopyNumber) {
     string oldChr = "azeaze";
     int sNPpositionToProceed;
     int positionCount = 0;
-    string line;
     int index=NA;
+    int exonCursor = 0;
 	char* line_buffer = NULL;
-	char buffer[MAX_BUFFER];
 	long normalCount = 0;
 	long count = 0;
 
-	while ((line_buffer = getLine(buffer, MAX_BUFFER, stream, line)) != NULL) {
-	  normalCount += processPileUPLine(positionCount, line_buffer, oldChr, sNPpositionToProceed,minimalTotalLetterCountPerPosition,index,minimalQualityPerPosition, p_genomeCopyNumber);
+	while ((line_buffer = reader.nextLine()) != NULL) {
+	  normalCount += processPileUPLine(positionCount, line_buffer, oldChr, sNPpositionToProceed,minimalTotalLetterCountPerPosition,index,minimalQualityPerPosition, p_genomeCopyNumber, exonCursor);
 	  count++;
 	}
+	if (reader.isError()) {
+	  cerr << "Error: FREEC was not able to read "<< reader.getFileName() << " until the end\n";
+	  exit(-1);
+	}
 
 	if (p_genomeCopyNumber) {
 	  p_genomeCopyNumber->finishCopyNumber(normalCount);
@@ -392,31 +370,12 @@ void SNPinGenome::assignValues(std::string const& inFile, string inputFormat, in
 		time_t t0 = time(NULL);
 #endif
 
-        if (inFile.substr(inFile.size()-3,3).compare(".gz")==0) {
-		  string command = "gzip -cd "+inFile;
-		  FILE* stream =
-            #if defined(_WIN32)
-				_popen(command.c_str(), "r");
-			#else
-				popen(command.c_str(), "r");
-			#endif
-				readPileUP(stream, minimalTotalLetterCountPerPosition, minimalQualityPerPosition, p_genomeCopyNumber);
-
-            #if defined(_WIN32)
-                    _pclose(stream);
-            #else
-                    pclose(stream);
-            #endif
-
-        } else {
-		    FILE *stream = fopen(inFile.c_str(), "r");
-			if (!stream) {
-			  cerr << "Error: unable to open " + inFile + "\n" ;
-			  exit(-1);
-			}
-			readPileUP(stream, minimalTotalLetterCountPerPosition, minimalQualityPerPosition,  p_genomeCopyNumber);
-			fclose(stream);
+        LineReader reader;
+        if (!reader.open(inFile, true)) {
+            cerr << "Error: unable to open " + inFile + "\n" ;
+            exit(-1);
         }
+        readPileUP(reader, minimalTotalLetterCountPerPosition, minimalQualityPerPosition, p_genomeCopyNumber);
 
 #ifdef PROFILE_TRACE
 		std::cout << "PROFILING [tid=" << pthread_self() << "]: " << inFile << " read in " << (time(NULL)-t0) << " seconds [assignValues]\n" << std::flush;
@@ -457,12 +416,8 @@ void SNPinGenome::assignValues(std::string const& inFile, string inputFormat, in
 }
 
 int SNPinGenome::findIndex (string chromosome) const {
-    for (int unsigned i = 0; i < SNP_atChr_->size(); i++) {
-        if (chromosome.compare((*SNP_atChr_)[i].getChromosome())==0) {
-            return i;
-        }
-    }
-    return NA;
+    //the first chromosome with this name, as SNP_atChr_ can have several if the SNP file is not sorted
+    return contigs_.find(chromosome);
 }
 
 const SNPatChr& SNPinGenome::SNP_atChr(int index) const {
@@ -473,6 +428,40 @@ SNPatChr& SNPinGenome::SNP_atChr(int index) {
     return (*SNP_atChr_)[index];
 }
 
+static float calculateBAF(int totalLetterCount, int refCount, int countForOverLetter, int minimalTotalLetterCountPerPosition, float& status) {
+    float value=NA;
+    if (refCount+countForOverLetter>=minimalTotalLetterCountPerPosition) {
+        if (countForOverLetter+refCount>totalLetterCount) {
+                countForOverLetter=totalLetterCount-refCount;
+                if (countForOverLetter<0)
+                    countForOverLetter=0;
+        }
+        value = countForOverLetter*1./(refCount+countForOverLetter);
+
+        //value = fabs(countForOverLetter*1./totalLetterCount-0.5);
+        double prob = binomialcdistribution(countForOverLetter-1, totalLetterCount, ERROR_PER_POS); //probability that there > k Beta Allel bases if the SNP is HomoZ.
+        status = 0;
+        if (prob<0.05) { //0.01
+
+            if (binomialcdistribution(totalLetterCount-countForOverLetter-1, totalLetterCount, ERROR_PER_POS)<0.01)
+                //decide that SNP is not homoZ.
+                status = 0.5; //at this point, to indicate possible AB
+        }
+    }
+    return value;
+}
+
+void SNPinGenome::setAlleleCountsAt(int index, int positionCount, int totalLetterCount, int refCount, int countForOverLetter, bool hasIndel, int minimalTotalLetterCountPerPosition) {
+    //same decision as addInfoFromAPileUp() but from allele counts obtained without a pileup file
+    float value=NA;
+    float status = NA;
+    if (!hasIndel && totalLetterCount>=minimalTotalLetterCountPerPosition) {
+        value = calculateBAF(totalLetterCount, refCount, countForOverLetter, minimalTotalLetterCountPerPosition, status);
+    }
+    (*SNP_atChr_)[index].setValueAt(positionCount,value);
+    (*SNP_atChr_)[index].setStatusAt(positionCount,status);
+}
+
 float SNPinGenome::addInfoFromAPileUp (int totalLetterCount, int minimalTotalLetterCountPerPosition,char whatToLook, int index,int &positionCount, int &sNPpositionToProceed, const char * pileup,int minimalQualityPerPosition, const char * quality){
     float value=NA;
     float status = NA;
@@ -512,26 +501,7 @@ float SNPinGenome::addInfoFromAPileUp (int totalLetterCount, int minimalTotalLet
                 //value = countForOverLetter*1./totalLetterCount;
 
 
-                if (refCount+countForOverLetter>=minimalTotalLetterCountPerPosition) {
-                    if (countForOverLetter+refCount>totalLetterCount) {
-                            countForOverLetter=totalLetterCount-refCount;
-                            if (countForOverLetter<0)
-                                countForOverLetter=0;
-                    }
-                    value = countForOverLetter*1./(refCount+countForOverLetter);
-
-                    //value = fabs(countForOverLetter*1./totalLetterCount-0.5);
-                  //  cout << "pileup: "<< pileup << " ; whatToLook: "<< whatToLook<< "\n";
-                   // cout << "countForOverLetter-1: "<< countForOverLetter-1 << "; totalLetterCount: "<< totalLetterCount << "; ERROR_PER_POS: "<< ERROR_PER_POS << "\n";
-                    double prob = binomialcdistribution(countForOverLetter-1, totalLetterCount, ERROR_PER_POS); //probability that there > k Beta Allel bases if the SNP is HomoZ.
-                    status = 0;
-                    if (prob<0.05) { //0.01
-
-                        if (binomialcdistribution(totalLetterCount-countForOverLetter-1, totalLetterCount, ERROR_PER_POS)<0.01)
-                            //decide that SNP is not homoZ.
-                            status = 0.5; //at this point, to indicate possible AB
-                    }
-                }
+                value = calculateBAF(totalLetterCount, refCount, countForOverLetter, minimalTotalLetterCountPerPosition, status);
             }
         }
     }
@@ -8,6 +8,8 @@
 #include "SNPatChr.h"
 #include "binomialdistr.h"
 #include "ThreadPool.h"
+#include "LineReader.h"
+#include "ContigDictionary.h"
 
 #define ERROR_PER_POS 0.01
 
@@ -26,6 +28,8 @@ class SNPinGenome
         void setBinAt(int indexSNP,int SNPcount,int valueToSet);
         void setWESanalysis(bool WESanalysis);
         void setCopyNumberFromPileup(bool CopyNumberFromPileup);
+        void setAlleleCountsAt(int index, int positionCount, int totalLetterCount, int refCount, int countForOverLetter, bool hasIndel, int minimalTotalLetterCountPerPosition);
+        void setPileupRead(bool pileupRead) {pileup_read = pileupRead;} //BAF values were already assigned, e.g. by BAFpileup::countAlleles()
 
         int findIndex (std::string chromosome) const;
         const SNPatChr& SNP_atChr(int) const;
@@ -37,10 +41,11 @@ class SNPinGenome
     protected:
     private:
         std::vector <SNPatChr>* SNP_atChr_;
+        ContigDictionary contigs_; //index of each chromosome in SNP_atChr_
         float addInfoFromAPileUp (int totalLetterCount, int minimalTotalLetterCountPerPosition,char whatToLook,
                                   int index,int &positionCount, int &sNPpositionToProceed,const char * pileup,int minimalQualityPerPosition,const char * quality); //returns BAF in case on heterozygous SNP (NA otherwise)
-		void readPileUP(FILE* stream, int minimalTotalLetterCountPerPosition, int minimalQualityPerPosition, GenomeCopyNumber* p_genomeCopyNumber);
-        long processPileUPLine(int & positionCount, char* line, std::string & oldChr, int & sNPpositionToProceed,int minimalTotalLetterCountPerPosition, int & index, int minimalQualityPerPosition, GenomeCopyNumber* p_genomeCopyNumber);
+		void readPileUP(LineReader& reader, int minimalTotalLetterCountPerPosition, int minimalQualityPerPosition, GenomeCopyNumber* p_genomeCopyNumber);
+        long processPileUPLine(int & positionCount, char* line, std::string & oldChr, int & sNPpositionToProceed,int minimalTotalLetterCountPerPosition, int & index, int minimalQualityPerPosition, GenomeCopyNumber* p_genomeCopyNumber, int & exonCursor);
 		int processSNPLine(bool isVCF, char * line, std::string & myChr, int & index,int &previousPos) ;
 		bool pileup_read;
         bool WESanalysis_;
@@ -20,10 +20,12 @@ http://www.fsf.org/licensing/licenses
 
 #include "SNPposition.h"
 #include <assert.h>
+#include <ctype.h>
 
-SNPposition::SNPposition(int position, char* alt) //for a VCF line
+SNPposition::SNPposition(int position, char* alt, const char* ref) //for a VCF line
 {
     position_=position;
+    reference_ = toupper(ref[0]);
     if (strlen(alt) == 1)   {
         nucleotide_ = alt[0];
     }  else  {
@@ -40,6 +42,7 @@ SNPposition::SNPposition(int position, char* alt) //for a VCF line
 SNPposition::SNPposition(int position, char* letters, const char* strand, const char* ref) //for .txt line
 {
     position_=position;
+    reference_ = toupper(ref[0]);
     char* strs[4];
     bool reverse = strcmp(strand, "-") == 0;
     if (strlen(letters) == 1)    { //should not get here
@@ -80,6 +83,10 @@ char SNPposition::getNucleotide() {
     return nucleotide_;
 }
 
+char SNPposition::getReference() {
+    return reference_;
+}
+
 void SNPposition::setFrequency(float freq) {
         freq_ = freq;
 }
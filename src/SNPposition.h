@@ -10,10 +10,11 @@ class SNPposition
 {
     public:
 	    SNPposition(int position, char* letters, const char* strand, const char* ref); //from TXT
-        SNPposition(int position, char* alt); //for VCF
+        SNPposition(int position, char* alt, const char* ref); //for VCF
         virtual ~SNPposition();
         int getPosition();
         char getNucleotide();
+        char getReference();
         float getValue();
         float getStatus();
         void setFrequency(float freq);
@@ -24,6 +25,7 @@ class SNPposition
     private:
         unsigned int position_;
         char nucleotide_;
+        char reference_; //reference allele on the forward strand, used when counting alleles directly from BAM files
         float freq_;
         float status_; //0 - AA/BB, 0.5 - AB
         int bin_; //bin in the copy number array
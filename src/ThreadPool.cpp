@@ -75,6 +75,10 @@ void* ThreadPool::wrapper(void* arg)
 
 void ThreadPool::run()
 {
+  if (thread_list.empty()) {
+	return;
+  }
+
   std::vector<Thread*>::iterator begin = thread_list.begin();
   std::vector<Thread*>::iterator end = thread_list.end();
   std::map<Thread*, bool> thread_map;
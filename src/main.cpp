@@ -218,6 +218,18 @@ int main(int argc, char *argv[])
         step=window;
     }
 
+	//read counts of each input file in fine windows are saved in readCountCacheDir and reused by later runs with another window, step or coefficientOfVariation
+	bool readCountCache = (bool)cf.Value("general","readCountCache", "false");
+
+	//_sample.cpn and _control.cpn profiles: text, binary (.cpnb files, faster to read again as mateCopyNumberFile) or both
+	std::string copyNumberFormat = (std::string)cf.Value("general","copyNumberFormat", "text");
+	bool isCopyNumberPrintedAsText = copyNumberFormat.compare("text")==0 || copyNumberFormat.compare("both")==0;
+	bool isCopyNumberPrintedAsBinary = copyNumberFormat.compare("binary")==0 || copyNumberFormat.compare("both")==0;
+	if (!isCopyNumberPrintedAsText && !isCopyNumberPrintedAsBinary) {
+		cerr << "Error: copyNumberFormat should be \"text\", \"binary\" or \"both\"\n";
+		exit(-1);
+	}
+
 	string outputDir = (std::string)cf.Value("general","outputDir",".");
 	if ( access( outputDir.c_str(), 0 ) == 0 )    {
             struct stat status;
@@ -235,6 +247,17 @@ int main(int argc, char *argv[])
             exit(-1);
     }
 
+	//input directories can be read-only or shared: caches go to outputDir unless another directory is given
+	string readCountCacheDir = (std::string)cf.Value("general","readCountCacheDir",outputDir);
+	if (readCountCache) {
+		struct stat status;
+		if (stat(readCountCacheDir.c_str(), &status) != 0 || !(status.st_mode & S_IFDIR)) {
+			cerr << "Error: readCountCacheDir " << readCountCacheDir << " is not a directory\n";
+			exit(-1);
+		}
+		cout << "..read counts of sample and control files will be cached in " << READ_COUNT_CACHE_RESOLUTION << "bp windows in " << readCountCacheDir << " (files *" << READ_COUNT_CACHE_EXTENSION << ")\n";
+	}
+
 	bool has_dirWithFastaSeq = cf.hasValue("general","chrFiles");
     string dirWithFastaSeq = (std::string)cf.Value("general","chrFiles","");
     if (has_dirWithFastaSeq) {
@@ -290,13 +313,14 @@ int main(int argc, char *argv[])
         		cout << "..Sample input format:\t" << sample_inputFormat << "\n";
         }
 		if (sample_inputFormat.compare("BAM")==0 || sample_inputFormat.compare("bam")==0 || sample_inputFormat.compare("Bam")==0) {
+            cout << "..BAM files will be decoded by FREEC itself to count reads\n";
             if (pathToSambamba != "")
                 {
-                cout << "..will use this instance of sambamba: '"<< pathToSambamba<<"' to read BAM files\n";
+                cout << "..will use this instance of sambamba: '"<< pathToSambamba<<"' to create pileups from BAM files\n";
                 }
             else
                 {
-                cout << "..will use this instance of samtools: '"<< pathToSamtools<<"' to read BAM files\n";
+                cout << "..will use this instance of samtools: '"<< pathToSamtools<<"' to create pileups from BAM files\n";
                 }
 		}
     }
@@ -311,7 +335,7 @@ int main(int argc, char *argv[])
 
  	string myName = "";
     if (has_sample_MateFile) {
-        myName = sample_MateFile;
+        myName = sample_MateFile.compare("-")==0 ? "stdin" : sample_MateFile;
     } else {
         myName = sample_MateCopyNumberFile;
     }
@@ -340,11 +364,29 @@ int main(int argc, char *argv[])
         cout << "..Control file with precalculated copy numbers:\t" << control_MateCopyNumberFile << "\n";
     }
 
+	//reads of SAM and BAM files left out of the copy number profiles, e.g. "excludeFlags = 0xF04" for unmapped, secondary, QC-failed, duplicate and supplementary reads
+	int sample_minMappingQuality = (int)cf.Value("sample","minMappingQuality",0);
+	int sample_excludeFlags = (int)strtol(std::string(cf.Value("sample","excludeFlags","0")).c_str(), NULL, 0);
+	int control_minMappingQuality = (int)cf.Value("control","minMappingQuality",0);
+	int control_excludeFlags = (int)strtol(std::string(cf.Value("control","excludeFlags","0")).c_str(), NULL, 0);
+	if (sample_minMappingQuality > 0 || sample_excludeFlags != 0) {
+	    cout << "..Sample reads with a mapping quality below " << sample_minMappingQuality << " or any of the flags 0x" << std::hex << sample_excludeFlags << std::dec << " will not be counted\n";
+	}
+	if (control_minMappingQuality > 0 || control_excludeFlags != 0) {
+	    cout << "..Control reads with a mapping quality below " << control_minMappingQuality << " or any of the flags 0x" << std::hex << control_excludeFlags << std::dec << " will not be counted\n";
+	}
+	//WES: pairs (or single-end reads) longer than this are not assigned to targets, so that only the targeted regions of indexed BAM files are read; 0 for no limit
+	int maxFragmentLength = (int)cf.Value("target","maxFragmentLength",TARGET_FLANK);
+	if (maxFragmentLength < 0) {
+	    cerr << "Error: maxFragmentLength should be positive or 0\n";
+	    exit(-1);
+	}
+
 	bool isControlIsPresent = has_control_MateFile || has_control_mateCopyNumberFile;
 
 	string controlName = "";
     if (has_control_MateFile) {
-        controlName = control_MateFile;
+        controlName = control_MateFile.compare("-")==0 ? "stdin" : control_MateFile;
     } else if (has_control_mateCopyNumberFile){
         controlName = control_MateCopyNumberFile;
     }
@@ -363,7 +405,7 @@ int main(int argc, char *argv[])
 	bool isHasMiniPileUPsample = (miniPileupFileSample=="false")?0:1;
     bool isHasMiniPileUPcontrol = (miniPileupFileControl=="false")?0:1;
 
-    if (makePileup != "false" && fastaFile=="false" && (!isHasMiniPileUPsample || isControlIsPresent && !isHasMiniPileUPcontrol)) {
+    if (makePileup != "false" && fastaFile=="false" && ((!isHasMiniPileUPsample && !BAFpileup::canCountAlleles(sample_MateFile)) || (isControlIsPresent && !isHasMiniPileUPcontrol && !BAFpileup::canCountAlleles(control_MateFile)))) {
         cerr << "To create a usable .pileup file from .BAM you need to provide a fasta file for the whole genome with option \"fastaFile\""<<endl;
         cerr << "If you only want copy number profiles (no genotypes), then remove or comment all the lines in the group of parameters [BAF]"<<endl;
 
@@ -397,6 +439,31 @@ int main(int argc, char *argv[])
         cout << "..since you mateFile is not in SAMtools pileup format, the BAF values will not be calculated\n";
         has_BAF=false;
 	}
+
+    //mateFile=- (standard input), a pipe or a FIFO can be read only once, and only to count reads in windows
+    bool is_sample_stream = has_sample_MateFile && LineReader::isStream(sample_MateFile);
+    bool is_control_stream = has_control_MateFile && LineReader::isStream(control_MateFile);
+    if (is_sample_stream || is_control_stream) {
+        if (sample_MateFile.compare("-")==0 && control_MateFile.compare("-")==0) {
+            cerr << "Error: only one of the [sample] and [control] mateFiles can be read from the standard input\n";
+            exit(-1);
+        }
+        if ((is_sample_stream && is_sample_pileup) || (is_control_stream && is_control_pileup)) {
+            cerr << "Error: a mateFile in pileup format cannot be read from the standard input, a pipe or a FIFO\n";
+            exit(-1);
+        }
+        if (makePileup != "false" || has_BAF) {
+            cerr << "Error: BAF profiles cannot be calculated when a mateFile is read from the standard input, a pipe or a FIFO\n";
+            cerr << "Please use a regular file, or comment all the lines in the group of parameters [BAF]\n";
+            exit(-1);
+        }
+        if (is_sample_stream) {
+            cout << "..reads of the sample will be counted while they arrive from " << sample_MateFile << "\n";
+        }
+        if (is_control_stream) {
+            cout << "..reads of the control will be counted while they arrive from " << control_MateFile << "\n";
+        }
+    }
     string SNPinfoFile = std::string(cf.Value("BAF","SNPfile",""));
 
     if (makePileup != "false" && SNPinfoFile=="" || isHasMiniPileUPsample&& SNPinfoFile=="") {
@@ -668,6 +735,13 @@ int main(int argc, char *argv[])
         exit(0);
     }
 
+    if (WESanalysis == true) {
+        if (maxFragmentLength > 0)
+            cout << "..pairs with a fragment longer than " << maxFragmentLength << "bp will not be assigned to targets\n";
+        else
+            cout << "..all pairs will be assigned to targets: indexed BAM files will be read entirely\n";
+    }
+
     if (WESanalysis == true && isControlIsPresent == false)       {
         cerr << "Warning : You did not provide a control sample for WES data. No normalization will be applied to read counts! \n";
         normalization=false;
@@ -695,6 +769,10 @@ int main(int argc, char *argv[])
 	sampleCopyNumber.setSambamba(pathToSambamba, SambambaThreads);
 	sampleCopyNumber.setWESanalysis(WESanalysis);
 	sampleCopyNumber.setmakingPileup(makingPileup);
+	sampleCopyNumber.setReadFilter(sample_minMappingQuality, sample_excludeFlags);
+	sampleCopyNumber.setReadCountCache(readCountCache, readCountCacheDir);
+	sampleCopyNumber.setMaxFragmentLength(maxFragmentLength);
+	sampleCopyNumber.setCopyNumberFormat(isCopyNumberPrintedAsText, isCopyNumberPrintedAsBinary);
 
     sampleCopyNumber.setIfLogged(logLogNorm);
 
@@ -703,6 +781,10 @@ int main(int argc, char *argv[])
 	controlCopyNumber.setSambamba(pathToSambamba, SambambaThreads);
 	controlCopyNumber.setWESanalysis(WESanalysis);
 	controlCopyNumber.setmakingPileup(makingPileup);
+	controlCopyNumber.setReadFilter(control_minMappingQuality, control_excludeFlags);
+	controlCopyNumber.setReadCountCache(readCountCache, readCountCacheDir);
+	controlCopyNumber.setMaxFragmentLength(maxFragmentLength);
+	controlCopyNumber.setCopyNumberFormat(isCopyNumberPrintedAsText, isCopyNumberPrintedAsBinary);
     controlCopyNumber.setIfLogged(logLogNorm);
 
 	SNPinGenome snpingenome;
@@ -723,7 +805,16 @@ int main(int argc, char *argv[])
     string samplePileup;
 
     if (makePileup != "false" || isHasMiniPileUPcontrol || isHasMiniPileUPsample)  {
-            if (!isHasMiniPileUPsample || (isControlIsPresent && !isHasMiniPileUPcontrol)) {
+            //sorted BAM files are genotyped at SNP positions by FREEC itself; samtools and bedtools are used for other formats
+            bool sampleNeedsPileup = !isHasMiniPileUPsample;
+            bool controlNeedsPileup = isControlIsPresent && !isHasMiniPileUPcontrol;
+            bool countAllelesFromBam = (!sampleNeedsPileup || BAFpileup::canCountAlleles(sample_MateFile)) && (!controlNeedsPileup || BAFpileup::canCountAlleles(control_MateFile));
+
+            if (countAllelesFromBam && (sampleNeedsPileup || controlNeedsPileup)) {
+                cout << "..BAF profiles will be calculated from BAM files directly, without creating pileup files\n";
+                if (targetBed != "")
+                    minipileup.setRegionsOfInterest(targetBed, minipileup.calculateFlankLength(sample_MateFile, sample_inputFormat, sample_mateOrientation, pathToSamtools, pathToSambamba, SambambaThreads));
+            } else if (!isHasMiniPileUPsample || (isControlIsPresent && !isHasMiniPileUPcontrol)) {
                 cout << "Creating Pileup file to compute BAF profile...\n";
                 minipileup.makepileup(sampleCopyNumber, controlCopyNumber, sample_MateFile, control_MateFile, myName, makePileup, sample_MateFile,
                 sample_inputFormat, sample_mateOrientation, pathToSamtools, pathToSambamba, SambambaThreads, chrLenFile, controlName, targetBed, pathToBedtools, fastaFile, minimalQualityPerPosition);
@@ -747,7 +838,20 @@ int main(int argc, char *argv[])
                 controlPileup = miniPileupFileControl;
             }
 
-            if (is_sample_pileup && !has_sample_mateCopyNumberFile && has_window)
+            if (countAllelesFromBam && sampleNeedsPileup && !has_sample_mateCopyNumberFile)
+                {
+                //alleles will be counted in the same pass over the BAM file as reads in windows
+                samplePileup = sample_MateFile;
+                sampleCopyNumber.setAlleleCounting(&minipileup, &snpingenome, minimalTotalLetterCountPerPosition, minimalQualityPerPosition);
+                sample_copyNumber_pileup_read = false;
+                }
+            else if (countAllelesFromBam && sampleNeedsPileup)
+                {
+                samplePileup = sample_MateFile;
+                thrPool->addThread(BAFpileup_countAlleles_wrapper, new BAFpileupCountAllelesArgWrapper(minipileup, snpingenome, sample_MateFile, minimalTotalLetterCountPerPosition, minimalQualityPerPosition));
+                sample_copyNumber_pileup_read = false;
+                }
+            else if (is_sample_pileup && !has_sample_mateCopyNumberFile && has_window)
                 {
                 std::cout << "avoid double pileup read: reading sample matefile\n";
                 readMateFileArg = new GenomeCopyNumberReadMateFileArgWrapper(snpingenome, samplePileup, "pileup", minimalTotalLetterCountPerPosition, minimalQualityPerPosition, sampleCopyNumber, chrLenFile, window, step, targetBed);
@@ -763,7 +867,19 @@ int main(int argc, char *argv[])
             if (isControlIsPresent)
             {
                 snpingenomeControl.setSNPChr(snpingenome.getSNPChr());
-                if (is_control_pileup && !has_control_mateCopyNumberFile && has_window)
+                if (countAllelesFromBam && controlNeedsPileup && !has_control_mateCopyNumberFile)
+                    {
+                    controlPileup = control_MateFile;
+                    controlCopyNumber.setAlleleCounting(&minipileup, &snpingenomeControl, minimalTotalLetterCountPerPosition, minimalQualityPerPosition);
+                    control_copyNumber_pileup_read = false;
+                    }
+                else if (countAllelesFromBam && controlNeedsPileup)
+                    {
+                    controlPileup = control_MateFile;
+                    thrPool->addThread(BAFpileup_countAlleles_wrapper, new BAFpileupCountAllelesArgWrapper(minipileup, snpingenomeControl, control_MateFile, minimalTotalLetterCountPerPosition, minimalQualityPerPosition));
+                    control_copyNumber_pileup_read = false;
+                    }
+                else if (is_control_pileup && !has_control_mateCopyNumberFile && has_window)
                     {
                     std::cout << "avoid double pileup read: reading control matefile\n";
                     readMateFileArg = new GenomeCopyNumberReadMateFileArgWrapper(snpingenomeControl, controlPileup, "pileup", minimalTotalLetterCountPerPosition, minimalQualityPerPosition, controlCopyNumber, chrLenFile, window, step, targetBed);
@@ -817,6 +933,12 @@ int main(int argc, char *argv[])
 	}
 
 
+    //READ SAMPLE AND CONTROL DATA:
+    //the sample and the control are read (and their .cpn files printed) by concurrent tasks,
+    //unless the control needs the window size or the step found for the sample
+    bool isControlReadWithSample = isControlIsPresent && (WESanalysis == true || (has_window && !has_sample_mateCopyNumberFile));
+    thrPool = thrPoolManager->newThreadPool("GenomeCopyNumber_readCopyNumber");
+
     if (WESanalysis == false)    {
         if (has_sample_mateCopyNumberFile) {
             sampleCopyNumber.readCopyNumber(sample_MateCopyNumberFile);
@@ -833,28 +955,42 @@ int main(int argc, char *argv[])
                 sampleCopyNumber.setStep(step);
             }
             if (!sample_copyNumber_pileup_read && has_window) {
-                    sampleCopyNumber.readCopyNumber(sample_MateFile, sample_inputFormat, sample_mateOrientation,chrLenFile, window, step);
-            } else if (!sample_copyNumber_pileup_read && !has_window) {
-                sampleCopyNumber.readCopyNumber(sample_MateFile, sample_inputFormat, sample_mateOrientation,chrLenFile, coefficientOfVariation);
-                step = sampleCopyNumber.getWindowSize(); //in this case step=windowSize
+                thrPool->addThread(GenomeCopyNumber_readCopyNumber_wrapper, new GenomeCopyNumberReadCopyNumberArgWrapper(sampleCopyNumber, "", sample_MateFile, sample_inputFormat, sample_mateOrientation, chrLenFile, window, step, "", myName+"_sample.cpn"));
+            } else {
+                if (!sample_copyNumber_pileup_read && !has_window) {
+                    sampleCopyNumber.readCopyNumber(sample_MateFile, sample_inputFormat, sample_mateOrientation,chrLenFile, coefficientOfVariation);
+                    step = sampleCopyNumber.getWindowSize(); //in this case step=windowSize
+                }
+                sampleCopyNumber.printCopyNumber(myName+"_sample.cpn");
             }
-            sampleCopyNumber.printCopyNumber(myName+"_sample.cpn");
         }
+    } else   {
+        if (has_sample_mateCopyNumberFile) {
+            thrPool->addThread(GenomeCopyNumber_readCopyNumber_wrapper, new GenomeCopyNumberReadCopyNumberArgWrapper(sampleCopyNumber, sample_MateCopyNumberFile, "", "", "", "", 0, 0, "", ""));
+        } else {
+            thrPool->addThread(GenomeCopyNumber_readCopyNumber_wrapper, new GenomeCopyNumberReadCopyNumberArgWrapper(sampleCopyNumber, "", sample_copyNumber_pileup_read ? "" : sample_MateFile, sample_inputFormat, sample_mateOrientation, chrLenFile, window, step, targetBed, myName+"_sample.cpn"));
+        }
+    }
+
+    if (isControlReadWithSample) {
+        //for WGS data, step == NA is the same as step == window
+        if (has_control_mateCopyNumberFile) {
+            thrPool->addThread(GenomeCopyNumber_readCopyNumber_wrapper, new GenomeCopyNumberReadCopyNumberArgWrapper(controlCopyNumber, control_MateCopyNumberFile, "", "", "", "", 0, 0, "", ""));
+        } else {
+            thrPool->addThread(GenomeCopyNumber_readCopyNumber_wrapper, new GenomeCopyNumberReadCopyNumberArgWrapper(controlCopyNumber, "", control_copyNumber_pileup_read ? "" : control_MateFile, control_inputFormat, control_mateOrientation, chrLenFile, window, step, WESanalysis ? targetBed : "", controlName+"_control.cpn"));
+        }
+    }
+    thrPool->run();
+    delete thrPool;
+    thrPool = NULL;
+
+    if (WESanalysis == false)    {
         window = sampleCopyNumber.getWindowSize();
         cout << "..Window size:\t"<< window << "\n";
         if (step == NA) {
             step= window;
         }
         has_window = true; //now we know window size and even step!
-
-    } else   {
-        if (has_sample_mateCopyNumberFile) {
-            sampleCopyNumber.readCopyNumber(sample_MateCopyNumberFile);
-        } else {
-            if (!sample_copyNumber_pileup_read)
-                sampleCopyNumber.readCopyNumber(sample_MateFile, sample_inputFormat, sample_mateOrientation,chrLenFile, window, step, targetBed);
-            sampleCopyNumber.printCopyNumber(myName+"_sample.cpn");
-        }
     }
 
 	sampleCopyNumber.setSex(sex);
@@ -864,8 +1000,8 @@ int main(int argc, char *argv[])
         isLookingForSubclones=true;
     }
 
-    //READ CONTROL DATA:
-    if (isControlIsPresent) {
+    //READ CONTROL DATA (unless it was read together with the sample):
+    if (isControlIsPresent && !isControlReadWithSample) {
         if (has_control_mateCopyNumberFile) {
             controlCopyNumber.readCopyNumber(control_MateCopyNumberFile);
         } else {
@@ -876,6 +1012,8 @@ int main(int argc, char *argv[])
             }
           controlCopyNumber.printCopyNumber(controlName+"_control.cpn");
         }
+    }
+    if (isControlIsPresent) {
        controlCopyNumber.setSex(sex);
     }
 
@@ -892,6 +1030,11 @@ int main(int argc, char *argv[])
         }
         controlCopyNumber.focusOnCapture(targetBed);
 	}
+#ifdef PROFILE_TRACE
+	sampleCopyNumber.printMemoryUsage("of the sample after reading");
+	if (isControlIsPresent)
+		controlCopyNumber.printMemoryUsage("of the control after reading");
+#endif
 
     if (normalization==false) {
         float iqrLargeExon=1;
@@ -1084,6 +1227,11 @@ int main(int argc, char *argv[])
             }
         }
 
+#ifdef PROFILE_TRACE
+	sampleCopyNumber.printMemoryUsage("of the sample before printing");
+	if (isControlIsPresent)
+		controlCopyNumber.printMemoryUsage("of the control before printing");
+#endif
 	sampleCopyNumber.printRatio(myName+"_ratio.txt",0,printNA);
 	if (ifBedGraphOutPut) {
             sampleCopyNumber.printRatio(myName+"_ratio.BedGraph",1,printNA);
@@ -1106,6 +1254,14 @@ int main(int argc, char *argv[])
 	file << "Window\t"<<window<< endl;
 	file << "Number_Of_Reads|Pairs_In_Sample\t"<<sampleCopyNumber.getNormalNumberOfPairs()<< endl;
 	file << "Number_Of_Reads|Pairs_In_Control\t"<<controlCopyNumber.getNormalNumberOfPairs()<< endl;
+	if (sampleCopyNumber.getReadFilter().isActive()) {
+	    file << "Reads_Rejected_By_Flags_In_Sample\t"<<sampleCopyNumber.getReadFilter().rejectedByFlags<< endl;
+	    file << "Reads_Rejected_By_MAPQ_In_Sample\t"<<sampleCopyNumber.getReadFilter().rejectedByMappingQuality<< endl;
+	}
+	if (isControlIsPresent && controlCopyNumber.getReadFilter().isActive()) {
+	    file << "Reads_Rejected_By_Flags_In_Control\t"<<controlCopyNumber.getReadFilter().rejectedByFlags<< endl;
+	    file << "Reads_Rejected_By_MAPQ_In_Control\t"<<controlCopyNumber.getReadFilter().rejectedByMappingQuality<< endl;
+	}
     sampleCopyNumber.printInfo(file); //for ploidy & contamination
     file << "Good_Polynomial_Fit\t"<<stringFromBool(bool(isSuccessfulFit))<< endl;
 
@@ -33,6 +33,9 @@ http://www.fsf.org/licensing/licenses
 
 
 #include "ThreadPool.h"
+#include "BamReader.h"
+#include "BamIndex.h"
+#include "LineReader.h"
 
 using namespace std ;
 
@@ -44,14 +47,14 @@ myFunc::~myFunc(void)
 {
 }
 
-unsigned int split(char* str_ori, char delim, char* elems[])
+unsigned int split(char* str_ori, char delim, char* elems[], unsigned int maxElems)
 {
   const char* str = str_ori;
   unsigned int last_jj = 0;
   unsigned int jj = 0;
   unsigned int elem_cnt = 0;
   char c;
-  for (; c = *str++; ++jj) {
+  for (; (c = *str++) && elem_cnt+1 < maxElems; ++jj) {
 	if (c == delim) {
 	  str_ori[jj] = 0;
 	  elems[elem_cnt++] = &str_ori[last_jj];
@@ -353,66 +356,57 @@ unsigned long sum(const std::vector<int>& data) {
 }
 
 long getLineNumber(std::string const& fileName, const std::string& pathToSamtools, const std::string& pathToSambamba, const std::string& SambambaThreads) {
-	string line ;
 	long count = 0;
-	FILE *stream;
-    char buffer[MAX_BUFFER];
-
-    if (fileName.substr(fileName.size()-3,3).compare(".gz")==0) {
-        string command = "gzip -cd "+fileName;
-        stream =
-        #if defined(_WIN32)
-            _popen(command.c_str(), "r");
-        #else
-            popen(command.c_str(), "r");
-        #endif
-        while ( fgets(buffer, MAX_BUFFER, stream) != NULL ) {
+
+    if (fileName.substr(fileName.size()-4,4).compare(".bam")==0) {
+        BamReader bamReader;
+        if (!bamReader.open(fileName, true)) {
+            exit(-1);
+        }
+        BamRecord record;
+        while (bamReader.next(record)) {
             count++;
         }
-        #if defined(_WIN32)
-				_pclose(stream);
-		#else
-				pclose(stream);
-		#endif
-    } else if (fileName.substr(fileName.size()-4,4).compare(".bam")==0) {
-        string command = "";
-        if (pathToSambamba != "")
-            {
-            command = pathToSambamba + " view -t " + SambambaThreads + " " +fileName;
-            //myInputFormat="sam";       //will try to use existing samtools
-            cout << "..sambamba should be installed to be able to read BAM files\n";
-            }
-        else
-            {
-            command = pathToSamtools + " view "+fileName;
-            //myInputFormat="sam";       //will try to use existing samtools
-            cout << "..samtools should be installed to be able to read BAM files\n";
-            }
-        stream =
-            #if defined(_WIN32)
-				_popen(command.c_str(), "r");
-			#else
-				popen(command.c_str(), "r");
-			#endif
-
-        while ( fgets(buffer, MAX_BUFFER, stream) != NULL ) {
+        if (bamReader.isError()) {
+            exit(-1);
+        }
+    } else {
+        LineReader reader;
+        if (!reader.open(fileName, true)) {
+            cerr << "Error: unable to open "+fileName+"\n" ;
+            exit(-1);
+        }
+        const char* line;
+        int length;
+        while (reader.next(line, length)) {
             count++;
         }
-        #if defined(_WIN32)
-				_pclose(stream);
-		#else
-				pclose(stream);
-		#endif
-    }else {
-    	ifstream file(fileName.c_str()) ;
-        while( getline( file, line ) ) count++ ;
-        file.close();
+        if (reader.isError()) {
+            exit(-1);
+        }
     }
 
-
 	return count;
 }
 
+long getReadNumberFromBamIndex(std::string const& fileName) {
+    //.bai and .csi files store the number of mapped and unmapped reads for each reference and the number of reads without coordinates
+    BamIndex bamIndex;
+    if (!bamIndex.load(fileName) || bamIndex.getNumberOfUnplacedReads() < 0) {
+        return NA;
+    }
+    long count = bamIndex.getNumberOfUnplacedReads();
+    for (int i = 0; i < bamIndex.getNumberOfReferences(); i++) {
+        long long refCount = bamIndex.getNumberOfReads(i);
+        if (refCount < 0) {
+            return NA;
+        }
+        count += refCount;
+    }
+    cout << "..number of reads taken from "<< bamIndex.getFileName() << "\n";
+    return count;
+}
+
 void advance_to(const std::string& haystack, size_t& offset, char needle) {
 
 	// I think std::string should behave correctly in this case, but just to be sure...
@@ -425,62 +419,43 @@ void advance_to(const std::string& haystack, size_t& offset, char needle) {
 }
 
 long getReadNumberFromPileup(std::string const& fileName) {
-	string line ;
 	long count = 0;
-	std::vector<std::string> strs;
 	// we will simply count "^"
 #ifdef PROFILE_TRACE
 	time_t t0 = time(NULL);
 #endif
-    if (fileName.substr(fileName.size()-3,3).compare(".gz")==0) {
-        FILE *stream;
-        char buffer[MAX_BUFFER];
-        string command = "gzip -cd "+fileName;
-        stream =
-            #if defined(_WIN32)
-				_popen(command.c_str(), "r");
-			#else
-				popen(command.c_str(), "r");
-			#endif
-        while ( fgets(buffer, MAX_BUFFER, stream) != NULL ) {
-            line = buffer;
-            if (! line.length()) continue;
-            if (line[0] == '#') continue;
-            if ( line[0] == '@') continue;
-
-            strs = split(line, '\t');
-            if (strs.size() > 4) {
-                int toadd;
-                if (toadd=strccnt(strs[4].c_str(), '^')) {
-                        count += toadd;
-                }
-            }
-            strs.clear();
+    LineReader reader;
+    if (!reader.open(fileName, true)) {
+        cerr << "Error: unable to open "+fileName+"\n" ;
+        exit(-1);
+    }
+    const char* line;
+    int length;
+    while (reader.next(line, length)) {
+        if (! length) continue;
+        if (line[0] == '#') continue;
+        if ( line[0] == '@') continue;
+
+        //the read bases are in the fifth column
+        const char* field = line;
+        const char* end = line + length;
+        for (int column = 0; column < 4 && field; column++) {
+            field = (const char*)memchr(field, '\t', end - field);
+            if (field)
+                field++;
         }
-        #if defined(_WIN32)
-				_pclose(stream);
-		#else
-				pclose(stream);
-		#endif
-
-    } else {
-        ifstream fileMates(fileName.c_str()) ;
-        while (std::getline(fileMates,line)) {
-
-            if (! line.length()) continue;
-            if (line[0] == '#') continue;
-            if ( line[0] == '@') continue;
-
-            strs = split(line, '\t');
-            if (strs.size() > 4) {
-                int toadd;
-                if (toadd=strccnt(strs[4].c_str(), '^')) {
-                        count += toadd;
-                }
-            }
-            strs.clear();
+        if (!field)
+            continue;
+        const char* fieldEnd = (const char*)memchr(field, '\t', end - field);
+        if (!fieldEnd)
+            fieldEnd = end;
+        for (const char* c = field; c < fieldEnd; c++) {
+            if (*c == '^')
+                count++;
         }
-        fileMates.close();
+    }
+    if (reader.isError()) {
+        exit(-1);
     }
 
 #ifdef PROFILE_TRACE
@@ -1824,7 +1799,7 @@ char complement(char n) {
 vector<int> merge_no_dups(const vector<int>& v1, const vector<int>& v2);
 
 
-void getBAFinfo(std::string BAFValuesInTheSegment,float copyNumber,float &estimatedBAF,float &fittedBAF,std::string &medianBAFSym,
+void getBAFinfo(std::vector <float> const& BAFs,float copyNumber,float &estimatedBAF,float &fittedBAF,BAFgenotype &medianBAFSym,
 float & uncertainty, float normalContamination,int ploidy, bool noisyData, bool ifHomoz, bool CompleteGenomicsData) {
 
     bool fixedMu = true;
@@ -1833,7 +1808,7 @@ float & uncertainty, float normalContamination,int ploidy, bool noisyData, bool
     if (copyNumber==NA) {
         estimatedBAF = NA;
         fittedBAF=NA;
-        medianBAFSym = "-";
+        medianBAFSym = BAF_GENOTYPE_UNKNOWN;
         uncertainty = NA;
         return;
     }
@@ -1852,13 +1827,7 @@ float & uncertainty, float normalContamination,int ploidy, bool noisyData, bool
         uncertainty = NA;
         estimatedBAF = 0;
         fittedBAF=NA;
-        medianBAFSym="";
-        if (round_f(copyNumber)>=1) {
-            medianBAFSym="A";
-            for (int i = 1; i<round_f(copyNumber); i++) {
-                    medianBAFSym+="A";
-            }
-        }
+        medianBAFSym=makeBAFgenotype(max(round_f(copyNumber),0),0);
 
         copyNumbers.clear();
         return;
@@ -1866,33 +1835,22 @@ float & uncertainty, float normalContamination,int ploidy, bool noisyData, bool
 
     double maxLogLikelyHood = -INFINITY;
 
-    vector <float> BAFs;
-    vector<string>heteroValuesPerWindowStrings = split(BAFValuesInTheSegment, ';');
-    if (heteroValuesPerWindowStrings.size()>0) {
-            for (int unsigned j = 0; j < heteroValuesPerWindowStrings.size(); j++) {
-                stringstream ss;
-                float f;
-                ss << heteroValuesPerWindowStrings[j];
-                ss >> f;
-                BAFs.push_back(f);
-            }
-    } else {
+    if (BAFs.size()==0) {
         estimatedBAF = NA;
         fittedBAF = NA;
         uncertainty = NA;
-        medianBAFSym="";
-        if (round_f(copyNumber)==1){medianBAFSym="A";}
+        medianBAFSym=makeBAFgenotype(0,0);
+        if (round_f(copyNumber)==1){medianBAFSym=makeBAFgenotype(1,0);}
         if (round_f(copyNumber)>1) {
-            medianBAFSym="-";
+            medianBAFSym=BAF_GENOTYPE_UNKNOWN;
         }
         return;
     }
-    heteroValuesPerWindowStrings.clear();
 
     uncertainty = NA;
     vector <double> LogLikelyHoods;
     vector <int> testedCN;
-    vector <string> medianBAFSyms;
+    vector <BAFgenotype> medianBAFSyms;
     vector <float>estimatedBAFs;
     vector <float>fittedBAFs;
 
@@ -1900,12 +1858,12 @@ float & uncertainty, float normalContamination,int ploidy, bool noisyData, bool
     for (int unsigned i=0; i<copyNumbers.size(); i++) {
         int myCopyNumber = copyNumbers.at(i);
         if(myCopyNumber==0) {
-            medianBAFSym = "";
+            medianBAFSym = makeBAFgenotype(0,0);
             estimatedBAF = NA;
             fittedBAF = NA;
             uncertainty = NA;
         } else if (myCopyNumber==1) {
-            medianBAFSym = "A";
+            medianBAFSym = makeBAFgenotype(1,0);
             estimatedBAF = 0;
             fittedBAF = NA;
             uncertainty = NA;
@@ -1938,13 +1896,7 @@ float & uncertainty, float normalContamination,int ploidy, bool noisyData, bool
                 LogLikelyHoods.push_back(LogLikelyHood);
                 testedCN.push_back(myCopyNumber);
 
-                string medianBAFSymX = "A";
-                for (int i = 1; i<Acount; i++) {
-                    medianBAFSymX+="A";
-                }
-                for (int i = 0; i<Bcount; i++) {
-                    medianBAFSymX+="B";
-                }
+                BAFgenotype medianBAFSymX = makeBAFgenotype(myCopyNumber,Bcount);
                 medianBAFSyms.push_back(medianBAFSymX);
 
                 estimatedBAFs.push_back(Bcount*1./myCopyNumber);
@@ -1972,20 +1924,18 @@ float & uncertainty, float normalContamination,int ploidy, bool noisyData, bool
         uncertainty = 1./(LogLikelyHoods[LogLikelyHoods.size()-1]-LogLikelyHoods[LogLikelyHoods.size()-2]);
    //     uncertainty = exp(LogLikelyHoods[LogLikelyHoods.size()-2]-LogLikelyHoods[LogLikelyHoods.size()-1]);//since v9.4 : p(secondBest)/p(best)
         if (copyNumbers.size()>=1) {
-            if (copyNumbers[0]==1 && copyNumbers[1]==2 && copyNumber<1.5 && (medianBAFSym.compare("AA")==0 || (medianBAFSym.compare("AB")==0 && uncertainty >0.1))) {
-                medianBAFSym="A";
+            if (copyNumbers[0]==1 && copyNumbers[1]==2 && copyNumber<1.5 && (medianBAFSym==makeBAFgenotype(2,0) || (medianBAFSym==makeBAFgenotype(2,1) && uncertainty >0.1))) {
+                medianBAFSym=makeBAFgenotype(1,0);
                 estimatedBAF = 0;
                 fittedBAF=NA;
             }
             if (copyNumbers[0]>1 && LogLikelyHoods.size()>=3) { //should be always >=3, but just in case
-                if (medianBAFSym[medianBAFSym.size()-1] == 'A') { //means AAAAA
+                if (hasBAFgenotypeAlleles(medianBAFSym) && getBAFgenotypeBcount(medianBAFSym)==0) { //means AAAAA
                     //one should choose between AAAA and AAA
-                    medianBAFSym = "A";
-                    for (int i = 1; i<copyNumbers[0]; i++) {
-                        medianBAFSym+="A";
-                    }
                     if (copyNumber-copyNumbers[0]>=0.5)
-                        medianBAFSym+="A";
+                        medianBAFSym = makeBAFgenotype(copyNumbers[0]+1,0);
+                    else
+                        medianBAFSym = makeBAFgenotype(copyNumbers[0],0);
                     //end recalculate uncertainty:
                    // cout << LogLikelyHoods[LogLikelyHoods.size()-1]<< " " << LogLikelyHoods[LogLikelyHoods.size()-2] <<"\n";
                     uncertainty = 1./(LogLikelyHoods[LogLikelyHoods.size()-1]-LogLikelyHoods[LogLikelyHoods.size()-3]);
@@ -2017,7 +1967,6 @@ float & uncertainty, float normalContamination,int ploidy, bool noisyData, bool
         uncertainty *= 100;
 
     LogLikelyHoods.clear();
-    BAFs.clear();
     copyNumbers.clear();
     testedCN.clear();
     medianBAFSyms.clear();
@@ -2107,7 +2056,7 @@ void getCopyNumbers (float copyNumber, vector <int> & copyNumbers,int ploidy, bo
 
 }
 
-double calculateLogLikelyHoodNormalMixtureForBAFs(vector <float> X,vector <float> mu,float middleComponentMinW, bool isMuFixed, bool CompleteGenomicsData) {
+double calculateLogLikelyHoodNormalMixtureForBAFs(vector <float> const& X,vector <float> mu,float middleComponentMinW, bool isMuFixed, bool CompleteGenomicsData) {
     double LogLikelyHood_i = -INFINITY ;
     int numberOfStates = mu.size();
     int N = X.size();
@@ -2353,85 +2302,33 @@ double NormalDistributionDensity (double x, double mu, double sigma) {
     return result;
 }
 
-string findSmallestSuffix (string s1, string s2) {
-
-    if (s1 == "")
-        return  s2;
-
-   // cout <<"s1: "<<s1<< "\ns2: "<<s2 << "\n";
-
-    string suffix = "";
-    vector<string>values1 = split(s1, ';');
-    vector<string>values2 = split(s2, ';');
-
-    int size1 = values1.size();
-    int size2 = values2.size();
-
-    //cout <<"s1 size: "<<size1<< "; s2 size: "<<size2 << "\n";
-
-    int startSuffix = 0;
-
-    for (int i=max(0,size1-size2); i<size1; i++) {
-
-        if (values1[i].compare(values2[0])==0) {
-        //found possible overlap
-            int realOverlap = 1;
-
-            for (int j=i+1; j<size1; j++) {
-                if (values1[j].compare(values2[j-i])!=0) {
-                    j=size1;
-                    realOverlap=0;
-                }
-            }
-            if (realOverlap) {
-                startSuffix = size1 - i;
-                i=size1;
-            }
-        }
-    }
-    if (startSuffix == 0)
-        return s2;
-
-    if (startSuffix >= size2) //should never happen
-        return "";
-
-    suffix = values2[startSuffix];
-    for (int i=startSuffix+1; i<size2; i++) {
-        suffix += ";"+ values2[i];
-    }
-
-    return suffix;
-}
-
-std::string getNormalBAFforPloidy(int ploidy) {
+BAFgenotype getNormalBAFforPloidy(int ploidy) {
     if (ploidy>1) {
-        int Bcount = ploidy/2;
-        int Acount = ploidy-Bcount;
-        string BAF = "A";
-        for (int i = 1; i<Acount;i++)
-            BAF += "A";
-        for (int i = 0; i< Bcount;i++)
-            BAF += "B";
-        return BAF;
+        return makeBAFgenotype(ploidy,ploidy/2);
     } else {
         if (ploidy==1)
-            return "A";
+            return makeBAFgenotype(1,0);
     }
-    return "";
+    return makeBAFgenotype(0,0);
 }
 
-std::string getXYBAFforPloidy(int ploidy) {
+BAFgenotype getXYBAFforPloidy(int ploidy) {
     if (ploidy>1) {
-        int Acount = ploidy/2;
-        string BAF = "A";
-        for (int i = 1; i<Acount;i++)
-            BAF += "A";
-        return BAF;
+        return makeBAFgenotype(ploidy/2,0);
     } else {
         if (ploidy==1)
-            return "A";
+            return makeBAFgenotype(1,0);
     }
-    return "";
+    return makeBAFgenotype(0,0);
+}
+
+std::string getBAFgenotypeSymbol(BAFgenotype genotype) {
+    if (genotype == BAF_GENOTYPE_UNKNOWN)
+        return "-";
+    int Bcount = getBAFgenotypeBcount(genotype);
+    string symbol (getBAFgenotypeCopyNumber(genotype)-Bcount, 'A');
+    symbol.append(Bcount, 'B');
+    return symbol;
 }
 
 bool getELANDinfo(std::string line,std::string &chr1,std::string &chr2,std::string &orient1,std::string &orient2,int &left,int &right, int &insertSize) {
@@ -2514,6 +2411,52 @@ bool getSAMinfo(const char* line, std::string &chr1, std::string &chr2, char& or
 
 }
 
+static inline int parseSAMInt(const char* str, const char* end)
+{
+    bool isNegative = false;
+    if (str < end && (*str == '-' || *str == '+')) {
+        isNegative = (*str == '-');
+        str++;
+    }
+    int value = 0;
+    while (str < end && (unsigned char)(*str - '0') < 10) {
+        value = value*10 + (*str - '0');
+        str++;
+    }
+    return isNegative ? -value : value;
+}
+
+int parseSAMFields(const char* line, int length, SAMFields& fields)
+{
+    //tabs are found with memchr(), which is vectorized by the C library; nothing is copied or allocated
+    const char* starts[10];
+    const char* ends[10];
+    const char* end = line + length;
+    const char* str = line;
+    int count = 0;
+    while (count < 10) {
+        const char* tab = (const char*)memchr(str, '\t', end - str);
+        starts[count] = str;
+        ends[count] = tab ? tab : end;
+        count++;
+        if (!tab) {
+            break;
+        }
+        str = tab + 1;
+    }
+    fields.rname = count > 2 ? starts[2] : end;
+    fields.rnameLength = count > 2 ? int(ends[2] - starts[2]) : 0;
+    fields.flag = count > 1 ? parseSAMInt(starts[1], ends[1]) : 0;
+    fields.pos = count > 3 ? parseSAMInt(starts[3], ends[3]) : 0;
+    fields.mapq = count > 4 ? parseSAMInt(starts[4], ends[4]) : 0;
+    fields.rnext = count > 6 ? starts[6] : end;
+    fields.rnextLength = count > 6 ? int(ends[6] - starts[6]) : 0;
+    fields.pnext = count > 7 ? parseSAMInt(starts[7], ends[7]) : 0;
+    fields.tlen = count > 8 ? parseSAMInt(starts[8], ends[8]) : 0;
+    fields.seqLength = count > 9 ? int(ends[9] - starts[9]) : NA;
+    return count;
+}
+
 bool getSAMinfo(const std::string& line,std::string &chr1,std::string &chr2,std::string &orient1,std::string &orient2,int &left,int &right) {
     if (! line.length())
         return false;
@@ -2622,6 +2565,14 @@ MateOrientation getMateOrientation(std::string const& matesOrientation)
   return SINGLE_END_SORTED_SAM; // instead of UNKNOWN_MATE_ORIENTATION;
 }
 
+MateOrientation getMateOrientation(char orient1, char orient2)
+{
+  if (orient1 == orient2) {
+	return SOLID_MATE_PAIRS;
+  }
+  return orient1 == 'F' ? ILLUMNINA_PAIRED_END : ILLUMINA_MATE_PAIRS;
+}
+
 InputFormat getInputFormat(std::string const& inputFormat)
 {
   if (inputFormat.compare("sam")==0 || inputFormat.compare("SAM")==0) {
@@ -2659,29 +2610,6 @@ InputFormat getInputFormat(std::string const& inputFormat)
   return UNKNOWN_INPUT_FORMAT;
 }
 
-char* getLine(char* buffer, int buffer_size, FILE* stream, std::string& line)
-{
-  while (fgets(buffer, buffer_size, stream) != NULL) {
-	size_t len = strlen(buffer);
-	if (buffer[len-1] == '\n') {
-	  return buffer;
-	}
-	line = buffer;
-	for (;;) {
-	  if (line.at(line.length() - 1) == '\n') {
-		break;
-	  }
-	  if (fgets(buffer, MAX_BUFFER, stream) != NULL) {
-		line.append(buffer);
-	  } else {
-		break;
-	  }
-	}
-	return (char*)line.c_str();
-  }
-  return NULL;
-}
-
 
  std::vector<float> get_quartiles(vector<float> vect)
 {
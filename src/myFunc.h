@@ -60,6 +60,21 @@ enum MateOrientation {
   SOLID_MATE_PAIRS, // "FF"
 };
 
+//genotype of a segment: copy number (high byte) and number of B alleles (low byte), e.g. AAB is 3 copies with one B;
+//a copy number of 0 is printed as an empty symbol. Symbols are made only for the output (getBAFgenotypeSymbol)
+typedef unsigned short BAFgenotype;
+#define BAF_GENOTYPE_UNKNOWN ((BAFgenotype)0xFFFF) //"-": no estimation
+#define BAF_GENOTYPE_MAX_COPY_NUMBER 254
+
+inline BAFgenotype makeBAFgenotype(int copyNumber, int Bcount) { //BAF_GENOTYPE_UNKNOWN if the copy number is too high for the encoding
+  if (copyNumber < 0 || copyNumber > BAF_GENOTYPE_MAX_COPY_NUMBER)
+    return BAF_GENOTYPE_UNKNOWN;
+  return (BAFgenotype)((copyNumber << 8) | Bcount);
+}
+inline int getBAFgenotypeCopyNumber(BAFgenotype genotype) {return genotype >> 8;} //length of the symbol
+inline int getBAFgenotypeBcount(BAFgenotype genotype) {return genotype & 0xFF;}
+inline bool hasBAFgenotypeAlleles(BAFgenotype genotype) {return genotype != BAF_GENOTYPE_UNKNOWN && getBAFgenotypeCopyNumber(genotype) > 0;} //neither "-" nor ""
+
 class myFunc
 {
 public:
@@ -69,10 +84,11 @@ public:
 
 std::vector<std::string> &split(const std::string &s, char delim, std::vector<std::string> &elems);
 std::vector<std::string> split(const std::string &s, char delim);
-unsigned int split(char* str_ori, char delim, char* elems[]);
+unsigned int split(char* str_ori, char delim, char* elems[], unsigned int maxElems); //the last of maxElems fields keeps the rest of the line
+template <unsigned int N> inline unsigned int split(char* str_ori, char delim, char* (&elems)[N]) {return split(str_ori, delim, elems, N);}
 MateOrientation getMateOrientation(std::string const& matesOrientation);
+MateOrientation getMateOrientation(char orient1, char orient2); //from the strands ('F' or 'R') of the two reads of a pair
 InputFormat getInputFormat(std::string const& inputFormat);
-char* getLine(char* buffer, int buffer_size, FILE* stream, std::string& line);
 
 float get_sd (const std::vector<float>& data, float mean);
 float get_median(const std::vector<float>& data) ;
@@ -87,6 +103,7 @@ void readChrNamesInBed(const std::string &targetBed, std::vector<std::string>&na
 unsigned long sum(const std::vector<int>& data);
 long getLineNumber(std::string const& file, const std::string& pathToSamtools, const std::string& pathToSambamba, const std::string& SambambaThreads);
 long getReadNumberFromPileup(std::string const& file);
+long getReadNumberFromBamIndex(std::string const& file); //NA if the BAM file has no index with read statistics
 int factorial (int num);
 int get_max_index(const std::vector<float>& data);
 int get_min_index(const std::vector<float>& data);
@@ -125,24 +142,63 @@ void chomp (char* s);
 void chomp (std::string & s) ;
 std::string stringFromBool (bool value) ;
 
-void getBAFinfo(std::string BAFValuesInTheSegment,float copyNumber,float &estimatedBAF,float &fittedBAF,
-    std::string &medianBAFSym,float &uncertainty, float normalContamination,int ploidy, bool noisyData, bool ifHomoz, bool CompleteGenomicsData);
+void getBAFinfo(std::vector <float> const& BAFValuesInTheSegment,float copyNumber,float &estimatedBAF,float &fittedBAF,
+    BAFgenotype &medianBAFSym,float &uncertainty, float normalContamination,int ploidy, bool noisyData, bool ifHomoz, bool CompleteGenomicsData);
 void getCopyNumbers (float copyNumber, std::vector <int> & copyNumbers);
 void getCopyNumbers (float copyNumber, std::vector <int> & copyNumbers,int ploidy, bool noisyData) ;
-double calculateLogLikelyHoodNormalMixtureForBAFs(std::vector <float> BAFs,std::vector <float> mu,float middleComponentMinW, bool isMuFixed, bool CompleteGenomicsData);
+double calculateLogLikelyHoodNormalMixtureForBAFs(std::vector <float> const& BAFs,std::vector <float> mu,float middleComponentMinW, bool isMuFixed, bool CompleteGenomicsData);
 
 double NormalDistributionDensity (double x, double mu, double sigma) ;
 
 char complement(char nucleotide);
 void myReplace(std::string& str, const std::string& oldStr, const std::string& newStr);
 
-std::string findSmallestSuffix (std::string s1, std::string s2);
-std::string getNormalBAFforPloidy(int ploidy);
-std::string getXYBAFforPloidy(int ploidy);
+BAFgenotype getNormalBAFforPloidy(int ploidy);
+BAFgenotype getXYBAFforPloidy(int ploidy);
+std::string getBAFgenotypeSymbol(BAFgenotype genotype); //"AAB", "-" or ""
 
 static int foo = 0;
 bool getSAMinfo(const std::string& line,std::string &chr1,std::string &chr2,std::string &orient1,std::string &orient2,int &left,int &right);
 bool getSAMinfo(const char* line, std::string &chr1, std::string &chr2, char& orient1, char& orient2, int &left,int &right, int &insert_size = foo);
+//columns of a SAM line used to count reads: names are views into the line (not null-terminated), numbers are parsed as atoi() would do
+struct SAMFields {
+    const char* rname;
+    int rnameLength;
+    int flag;
+    int pos;
+    int mapq;
+    const char* rnext;
+    int rnextLength;
+    int pnext;
+    int tlen;
+    int seqLength; //NA if the line has no SEQ column
+};
+int parseSAMFields(const char* line, int length, SAMFields& fields); //returns the number of columns found, at most 10 (QNAME to SEQ)
+
+//reads left out of copy number profiles by the options "minMappingQuality" and "excludeFlags" of [sample] and [control]
+struct ReadFilter {
+    int minMappingQuality;
+    int excludedFlags;
+    long rejectedByFlags;
+    long rejectedByMappingQuality;
+
+    ReadFilter() : minMappingQuality(0), excludedFlags(0), rejectedByFlags(0), rejectedByMappingQuality(0) { }
+    bool isActive() const {return minMappingQuality > 0 || excludedFlags != 0;}
+    //flags are tested first: a read is counted by one filter only
+    bool isRejected(int flag, int mappingQuality) {
+        if (flag & excludedFlags) {
+            rejectedByFlags++;
+            return true;
+        }
+        if (mappingQuality < minMappingQuality) {
+            rejectedByMappingQuality++;
+            return true;
+        }
+        return false;
+    }
+    void clearCounts() {rejectedByFlags = rejectedByMappingQuality = 0;}
+    void addCounts(ReadFilter const& other) {rejectedByFlags += other.rejectedByFlags; rejectedByMappingQuality += other.rejectedByMappingQuality;}
+};
 bool getELANDinfo(std::string line,std::string &chr1,std::string &chr2,std::string &orient1,std::string &orient2,int &left,int &right,int &insertSize);
 
 void advance_to(const std::string& haystack, size_t& offset, char needle) ;